@@ -10,6 +10,7 @@ WINDOWS_KIT         = r'C:/Program Files (x86)/Windows Kits/8.0'
 
 XSISDK_ROOT         = r'C:/Program Files/Autodesk/Softimage 2015/XSISDK'
 ARNOLD_HOME         = r'C:/SolidAngle/Arnold-5.4.0.1/win64'
+# ZLIB_HOME         = r'C:/zlib' # optional, to compress the .ass files in the background
 
 TARGET_WORKGROUP_PATH  = r'./Softimage_2015/Addons/SItoA'
 
@@ -70,7 +70,7 @@ CStatus LoadLightParameters(AtNode* in_lightNode, const Light &in_xsiLight, cons
       for (int ikey=0; ikey<nkeys; ikey++)
       {
          AtMatrix nodeMatrix;
-         CMatrix4 lightMatrix = in_xsiLight.GetKinematics().GetGlobal().GetTransform(keyFramesTransform[ikey]).GetMatrix4();
+         CMatrix4 lightMatrix = GetRenderInstance()->TransformCache().GetGlobalTransform(in_xsiLight, keyFramesTransform[ikey]).GetMatrix4();
 
          if (AiNodeIs(in_lightNode, ATSTRING::photometric_light))
          {
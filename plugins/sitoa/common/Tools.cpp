@@ -39,6 +39,11 @@ See the License for the specific language governing permissions and limitations
 // #include <pthread.h>
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SITOA_USE_SSE2
+#endif
+
 
 // Convert a CMatrix4 to a AtMatrix
 //
@@ -119,6 +124,81 @@ void CUtilities::S2A(const CRotationf &in_rotf, AtMatrix &out_matrix)
 }
 
 
+// Convert doubles into floats, by blocks of 4 values if SSE2 is available
+//
+// @param in_src       The input doubles
+// @param out_dst      The output floats
+// @param in_count     The number of values to convert
+//
+void CUtilities::ConvertDoublesToFloats(const double *in_src, float *out_dst, size_t in_count)
+{
+   size_t i = 0;
+#ifdef SITOA_USE_SSE2
+   for (; i + 4 <= in_count; i+= 4)
+   {
+      __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(in_src + i));
+      __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(in_src + i + 2));
+      _mm_storeu_ps(out_dst + i, _mm_movelh_ps(lo, hi));
+   }
+#endif
+   for (; i < in_count; i++)
+      out_dst[i] = (float)in_src[i];
+}
+
+
+// Expand RGB pixels into RGBA ones with alpha = 1.
+// With SSE2, each pixel is loaded as 4 floats (so reading the next pixel's r), and the 4th lane replaced by 1.
+// The last pixel is done by hand, so to not read past the end of in_src.
+//
+// @param in_src       The input pixels
+// @param out_dst      The output pixels
+// @param in_count     The number of pixels
+//
+void CUtilities::ExpandRGBToRGBA(const AtRGB *in_src, AtRGBA *out_dst, size_t in_count)
+{
+   size_t i = 0;
+#ifdef SITOA_USE_SSE2
+   const __m128 rgbMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+   const __m128 alpha   = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+   for (; i + 1 < in_count; i++)
+   {
+      __m128 pixel = _mm_loadu_ps(&in_src[i].r);
+      _mm_storeu_ps(&out_dst[i].r, _mm_or_ps(_mm_and_ps(pixel, rgbMask), alpha));
+   }
+#endif
+   for (; i < in_count; i++)
+   {
+      out_dst[i].r = in_src[i].r;
+      out_dst[i].g = in_src[i].g;
+      out_dst[i].b = in_src[i].b;
+      out_dst[i].a = 1.0f;
+   }
+}
+
+
+// Expand FLOAT pixels into grey RGBA ones with alpha = 1
+//
+// @param in_src       The input pixels
+// @param out_dst      The output pixels
+// @param in_count     The number of pixels
+//
+void CUtilities::ExpandFloatToRGBA(const float *in_src, AtRGBA *out_dst, size_t in_count)
+{
+   size_t i = 0;
+#ifdef SITOA_USE_SSE2
+   const __m128 rgbMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+   const __m128 alpha   = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+   for (; i < in_count; i++)
+      _mm_storeu_ps(&out_dst[i].r, _mm_or_ps(_mm_and_ps(_mm_set1_ps(in_src[i]), rgbMask), alpha));
+#endif
+   for (; i < in_count; i++)
+   {
+      out_dst[i].r = out_dst[i].g = out_dst[i].b = in_src[i];
+      out_dst[i].a = 1.0f;
+   }
+}
+
+
 // Destroy an array of nodes. Be VERY careful when calling
 //
 // @param in_array      The input array
@@ -1655,3 +1735,75 @@ const AtSessionMode GetSessionMode()
    else
       return AI_SESSION_BATCH;
 }
+
+
+// Get the value of a parameter of an item at a given frame.
+// If the snapshot is enabled, the SDK is called only the first time the value is asked
+//
+// @param in_item     The item owning the parameter (property, primitive, shader, etc.)
+// @param in_name     The parameter name
+// @param in_frame    The frame time
+//
+// @return the parameter value
+//
+CValue CParameterCache::GetValue(const ProjectItem &in_item, const CString &in_name, double in_frame)
+{
+   if (!m_enabled || !in_item.IsValid())
+      return in_item.GetParameterValue(in_name, in_frame);
+
+   m_nbReads++;
+   CParameterValues &values = m_map[pair <ULONG, double>(CObjectUtilities().GetId(in_item), in_frame)];
+   CParameterValues::iterator it = values.find(in_name.GetWideString());
+   if (it != values.end())
+      return it->second;
+
+   m_nbSdkReads++;
+   CValue value = in_item.GetParameterValue(in_name, in_frame);
+   values.insert(pair <wstring, CValue>(in_name.GetWideString(), value));
+   return value;
+}
+
+
+// Enable or disable the snapshot. In both cases, the stored values are discarded.
+// Enabling also resets the counters
+//
+// @param in_enable     true to enable
+//
+void CParameterCache::Enable(bool in_enable)
+{
+   Clear();
+   m_enabled = in_enable;
+   if (in_enable)
+      m_nbReads = m_nbSdkReads = 0;
+}
+
+
+// Discard the stored values
+//
+void CParameterCache::Clear()
+{
+   m_map.clear();
+}
+
+
+// Log the number of reads, and how many of them were served by the snapshot, at debug level
+//
+// @param in_caption     The log caption, for instance the frame being exported
+//
+void CParameterCache::LogCounters(const CString &in_caption)
+{
+   if (m_nbReads == 0)
+      return;
+
+   AiMsgDebug("[sitoa] %s: %u parameter reads, %u of them saved by the parameters snapshot", 
+              in_caption.GetAsciiString(), m_nbReads, m_nbReads - m_nbSdkReads);
+}
+
+
+// Return the global parameter snapshot
+//
+CParameterCache& GetParameterCache()
+{
+   static CParameterCache parameterCache;
+   return parameterCache;
+}
@@ -28,6 +28,10 @@ See the License for the specific language governing permissions and limitations
 
 #include <ai.h>
 
+#include <map>
+#include <string.h>
+#include <unordered_map>
+
 using namespace XSI;
 using namespace XSI::MATH;
 
@@ -110,9 +114,51 @@ namespace VERBOSITY
 };
 
 
+// Snapshot of the parameter values read during an export.
+// Many loaders read the same parameters (for instance Visibility.rendvis, or the arnold_parameters
+// of a shared property) over and over for every object. While enabled, each parameter of a
+// (project item, frame) pair is read from the SDK only once, and then served from the table.
+// Outside of the export and of the IPR updates the snapshot is disabled, and the values are
+// always read from the SDK, since the ppg logics and the commands must see the live values.
+// Like the SDK, it must only be used by the main thread.
+//
+class CParameterCache
+{
+private:
+   // the values read so far for an item at a frame, by parameter name
+   typedef unordered_map <wstring, CValue> CParameterValues;
+
+   map <pair <ULONG, double>, CParameterValues> m_map;
+   bool         m_enabled;
+   unsigned int m_nbReads;    // the number of values asked since the last enabling
+   unsigned int m_nbSdkReads; // how many of them were read from the SDK
+
+public:
+   CParameterCache() : m_enabled(false), m_nbReads(0), m_nbSdkReads(0)
+   {}
+
+   ~CParameterCache()
+   {
+      m_map.clear();
+   }
+
+   // Get the value of a parameter of an item at a given frame
+   CValue GetValue(const ProjectItem &in_item, const CString &in_name, double in_frame);
+   // Enable or disable the snapshot. In both cases, the stored values are discarded
+   void Enable(bool in_enable);
+   // Discard the stored values
+   void Clear();
+   // Log the number of reads, and how many of them were served by the snapshot
+   void LogCounters(const CString &in_caption);
+};
+
+// Return the global parameter snapshot
+CParameterCache& GetParameterCache();
+
+
 // macros for accessing parameters
 #define ParAcc_GetParameter(in_obj, in_name) in_obj.GetParameter(in_name)
-#define ParAcc_GetValue(in_obj, in_name, in_frame) in_obj.GetParameterValue(in_name, in_frame)
+#define ParAcc_GetValue(in_obj, in_name, in_frame) GetParameterCache().GetValue(in_obj, in_name, in_frame)
 #define ParAcc_Valid(in_obj, in_name) in_obj.GetParameter(in_name).IsValid()
 
 
@@ -275,12 +321,163 @@ public:
       return true;
    }
 
+   // Convert doubles into floats, by blocks
+   void ConvertDoublesToFloats(const double *in_src, float *out_dst, size_t in_count);
+   // Expand RGB pixels into RGBA ones with alpha = 1, by blocks
+   void ExpandRGBToRGBA(const AtRGB *in_src, AtRGBA *out_dst, size_t in_count);
+   // Expand FLOAT pixels into grey RGBA ones with alpha = 1, by blocks
+   void ExpandFloatToRGBA(const float *in_src, AtRGBA *out_dst, size_t in_count);
+
    // Destroy an array of nodes. Be VERY careful when calling
    bool DestroyNodesArray(AtArray *in_array);
 
 };
 
 
+// Bulk copy of raw Softimage buffers (CDoubleArray, CFloatArray, CLongArray, etc.) into AtArrays.
+// The AtArray is mapped once and the values are converted by block, instead of being set one by one 
+// by the AiArraySet* functions. The component type of the AtArray is deduced from the array type, so 
+// for instance a VECTOR array is filled by 3 floats per element, and a UINT array by 1 uint32_t per element.
+class CBulkCopy
+{
+public:
+   // Convert in_count values
+   template <typename TSrc, typename TDst>
+   static void Convert(const TSrc *in_src, TDst *out_dst, size_t in_count)
+   {
+      for (size_t i = 0; i < in_count; i++)
+         out_dst[i] = (TDst)in_src[i];
+   }
+
+   // Convert in_count doubles into floats, vectorized
+   static void Convert(const double *in_src, float *out_dst, size_t in_count)
+   {
+      CUtilities().ConvertDoublesToFloats(in_src, out_dst, in_count);
+   }
+
+   // Copy in_count floats
+   static void Convert(const float *in_src, float *out_dst, size_t in_count)
+   {
+      memcpy(out_dst, in_src, in_count * sizeof(float));
+   }
+
+   // Return the number of components (floats, ints, etc.) of one key of an array, and its component type
+   static size_t GetKeyComponents(const AtArray *in_a, uint8_t &out_componentType)
+   {
+      uint8_t type = AiArrayGetType(in_a);
+      size_t componentSize;
+      switch (type)
+      {
+         case AI_TYPE_FLOAT: case AI_TYPE_VECTOR: case AI_TYPE_VECTOR2: case AI_TYPE_RGB: case AI_TYPE_RGBA: case AI_TYPE_MATRIX:
+            out_componentType = AI_TYPE_FLOAT;
+            componentSize = sizeof(float);
+            break;
+         case AI_TYPE_INT: case AI_TYPE_UINT: case AI_TYPE_BYTE: case AI_TYPE_BOOLEAN:
+            out_componentType = type;
+            componentSize = AiParamGetTypeSize(type);
+            break;
+         default:
+            out_componentType = AI_TYPE_NONE;
+            return 0;
+      }
+      return (size_t)AiArrayGetNumElements(in_a) * (AiParamGetTypeSize(type) / componentSize);
+   }
+
+   // Set a whole key of an array.
+   // @param in_a       The array
+   // @param in_values  The input values
+   // @param in_count   The number of input values, that must match the number of components of one key (ie 3 * elements for a VECTOR array)
+   // @param in_key     The mb key
+   // @return false if in_count/in_key don't match the array size or type, else true 
+   template <typename TSrc>
+   static bool SetKey(AtArray *in_a, const TSrc *in_values, size_t in_count, const int in_key)
+   {
+      uint8_t componentType;
+      size_t nbComponents = GetKeyComponents(in_a, componentType);
+      if (componentType == AI_TYPE_NONE || in_count != nbComponents || in_key >= (int)AiArrayGetNumKeys(in_a))
+         return false;
+      if (nbComponents == 0) // empty array, nothing to copy
+         return true;
+
+      void* data = AiArrayMap(in_a);
+      size_t offset = (size_t)in_key * nbComponents;
+      switch (componentType)
+      {
+         case AI_TYPE_FLOAT:   Convert(in_values, (float*)data + offset, nbComponents); break;
+         case AI_TYPE_INT:     Convert(in_values, (int*)data + offset, nbComponents); break;
+         case AI_TYPE_UINT:    Convert(in_values, (uint32_t*)data + offset, nbComponents); break;
+         case AI_TYPE_BYTE:    Convert(in_values, (uint8_t*)data + offset, nbComponents); break;
+         case AI_TYPE_BOOLEAN: Convert(in_values, (bool*)data + offset, nbComponents); break;
+      }
+      AiArrayUnmap(in_a);
+      return true;
+   }
+
+   // Set a whole key of an array from values with a wider stride, for instance the u,v of 
+   // a CDoubleArray of u,v,w into a VECTOR2 array
+   // @param in_a       The array
+   // @param in_values  The input values
+   // @param in_count   The number of input elements, that must match the number of elements of the array
+   // @param in_stride  The number of input values per element. Only the first ones are copied
+   // @param in_key     The mb key
+   // @return false if in_count/in_key don't match the array size or type, else true 
+   template <typename TSrc>
+   static bool SetKeyStrided(AtArray *in_a, const TSrc *in_values, size_t in_count, size_t in_stride, const int in_key)
+   {
+      uint8_t componentType;
+      size_t nbComponents = GetKeyComponents(in_a, componentType);
+      uint32_t nbElements = AiArrayGetNumElements(in_a);
+      if (componentType != AI_TYPE_FLOAT || in_count != nbElements || in_key >= (int)AiArrayGetNumKeys(in_a))
+         return false;
+
+      size_t width = nbElements > 0 ? nbComponents / nbElements : 0;
+      if (width > in_stride)
+         return false;
+
+      float* data = (float*)AiArrayMap(in_a) + (size_t)in_key * nbComponents;
+      for (size_t i = 0; i < in_count; i++, data+= width, in_values+= in_stride)
+         Convert(in_values, data, width);
+      AiArrayUnmap(in_a);
+      return true;
+   }
+
+   // Copy a whole key of an array into another key of the same array
+   // @param in_a        The array
+   // @param in_srcKey   The key to copy
+   // @param in_dstKey   The key to overwrite
+   // @return false if the keys don't exist or the array type is not supported, else true 
+   static bool CopyKey(AtArray *in_a, const int in_srcKey, const int in_dstKey)
+   {
+      uint8_t componentType;
+      size_t nbComponents = GetKeyComponents(in_a, componentType);
+      int nbKeys = (int)AiArrayGetNumKeys(in_a);
+      if (componentType == AI_TYPE_NONE || in_srcKey >= nbKeys || in_dstKey >= nbKeys)
+         return false;
+      if (nbComponents == 0 || in_srcKey == in_dstKey)
+         return true;
+
+      size_t keySize = nbComponents * AiParamGetTypeSize(componentType);
+      uint8_t* data = (uint8_t*)AiArrayMap(in_a);
+      memcpy(data + (size_t)in_dstKey * keySize, data + (size_t)in_srcKey * keySize, keySize);
+      AiArrayUnmap(in_a);
+      return true;
+   }
+
+   // Allocate a single key array of type in_type, and fill it with in_count values
+   template <typename TSrc>
+   static AtArray* ToArray(const TSrc *in_values, uint32_t in_nbElements, size_t in_count, uint8_t in_type)
+   {
+      AtArray* a = AiArrayAllocate(in_nbElements, 1, in_type);
+      if (!SetKey(a, in_values, in_count, 0))
+      {
+         AiArrayDestroy(a);
+         return NULL;
+      }
+      return a;
+   }
+};
+
+
 class CNodeUtilities
 {
 public:
@@ -0,0 +1,359 @@
+/************************************************************************************************************************************
+Copyright 2017 Autodesk, Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance with the License. 
+You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is distributed on an "AS IS" BASIS, 
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+See the License for the specific language governing permissions and limitations under the License.
+************************************************************************************************************************************/
+
+#ifdef _WINDOWS
+#include <thread>
+#else
+#include <unistd.h>
+#endif
+
+#include "common/WorkerPool.h"
+
+#include <ai_threads.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+
+
+/////////////////////////////////////
+/////////////////////////////////////
+// CWorkerPool
+/////////////////////////////////////
+/////////////////////////////////////
+
+// The data shared by the threads running a parallel loop
+class CParallelForData
+{
+public:
+   CParallelForBody *m_body;
+   unsigned int      m_count;
+   unsigned int      m_chunkSize;
+   unsigned int      m_next;
+   AtCritSec         m_cs;
+
+   CParallelForData(CParallelForBody *in_body, unsigned int in_count, unsigned int in_chunkSize) : 
+      m_body(in_body), m_count(in_count), m_chunkSize(in_chunkSize), m_next(0)
+   {
+      AiCritSecInit(&m_cs);
+   }
+
+   ~CParallelForData()
+   {
+      AiCritSecClose(&m_cs);
+   }
+
+   // Get the next chunk to process. Return false if the loop is over
+   bool GetNextChunk(unsigned int &out_begin, unsigned int &out_end)
+   {
+      AiCritSecEnter(&m_cs);
+      out_begin = m_next;
+      if (m_next < m_count)
+         m_next = m_count - m_next > m_chunkSize ? m_next + m_chunkSize : m_count;
+      out_end = m_next;
+      AiCritSecLeave(&m_cs);
+      return out_begin < out_end;
+   }
+};
+
+
+// Keep on processing the chunks of a loop until it is over
+//
+// @param in_data      the CParallelForData shared by the threads
+//
+static void RunChunks(CParallelForData *in_data)
+{
+   unsigned int begin, end;
+   while (in_data->GetNextChunk(begin, end))
+      in_data->m_body->Run(begin, end);
+}
+
+
+// true for the threads of the pool, so that the nested loops run inline
+static thread_local bool s_isPoolWorker = false;
+
+
+// The persistent threads of the pool.
+// The threads are created by the first ParallelFor, then wait for the next loop to be posted.
+class CWorkerThreads
+{
+public:
+   vector <void*>     m_threads;
+   mutex              m_mutex;
+   condition_variable m_wakeUp;     // signaled when a loop is posted, or when quitting
+   condition_variable m_done;       // signaled when the last worker leaves the loop
+   CParallelForData  *m_loop;       // the loop being run
+   unsigned int       m_generation; // incremented at each posted loop
+   unsigned int       m_nbBusy;     // the workers still running the loop
+   bool               m_quit;
+   mutex              m_postMutex;  // serializes the loops posted by different threads
+
+   CWorkerThreads() : m_loop(NULL), m_generation(0), m_nbBusy(0), m_quit(false)
+   {}
+
+   ~CWorkerThreads()
+   {
+      {
+         lock_guard <mutex> lock(m_mutex);
+         m_quit = true;
+      }
+      m_wakeUp.notify_all();
+
+      for (vector <void*>::iterator it = m_threads.begin(); it != m_threads.end(); it++)
+      {
+         AiThreadWait(*it);
+         AiThreadClose(*it);
+      }
+   }
+
+   // Run a loop on all the threads, the calling one included
+   void Run(CParallelForData *in_loop)
+   {
+      lock_guard <mutex> postLock(m_postMutex);
+      {
+         lock_guard <mutex> lock(m_mutex);
+         m_loop = in_loop;
+         m_nbBusy = (unsigned int)m_threads.size();
+         m_generation++;
+      }
+      m_wakeUp.notify_all();
+
+      RunChunks(in_loop);
+
+      unique_lock <mutex> lock(m_mutex);
+      while (m_nbBusy > 0)
+         m_done.wait(lock);
+      m_loop = NULL;
+   }
+};
+
+static CWorkerThreads *s_workerThreads = NULL;
+static mutex           s_workerThreadsMutex;
+
+
+// The thread function of the pool. Wait for a loop, and take part to it
+//
+// @param in_data      the CWorkerThreads
+//
+// @return 0
+//
+static unsigned int WorkerThread(void *in_data)
+{
+   CWorkerThreads *threads = (CWorkerThreads*)in_data;
+   s_isPoolWorker = true;
+
+   unsigned int generation = 0;
+   while (true)
+   {
+      CParallelForData *loop;
+      {
+         unique_lock <mutex> lock(threads->m_mutex);
+         while (!threads->m_quit && threads->m_generation == generation)
+            threads->m_wakeUp.wait(lock);
+         if (threads->m_quit)
+            break;
+         generation = threads->m_generation;
+         loop = threads->m_loop;
+      }
+
+      RunChunks(loop);
+
+      lock_guard <mutex> lock(threads->m_mutex);
+      if (--threads->m_nbBusy == 0)
+         threads->m_done.notify_one();
+   }
+   return 0;
+}
+
+
+// Return the threads of the pool, creating them the first time
+//
+static CWorkerThreads* GetWorkerThreads()
+{
+   lock_guard <mutex> lock(s_workerThreadsMutex);
+   if (!s_workerThreads)
+   {
+      s_workerThreads = new CWorkerThreads();
+      // the calling thread is one of the workers, so create one thread less
+      unsigned int nbThreads = CWorkerPool::GetNbThreads();
+      for (unsigned int i = 1; i < nbThreads; i++)
+      {
+         void *thread = AiThreadCreate(WorkerThread, s_workerThreads, AI_PRIORITY_NORMAL);
+         if (thread)
+            s_workerThreads->m_threads.push_back(thread);
+      }
+   }
+   return s_workerThreads;
+}
+
+
+// Return the number of threads to be used by the pool
+//
+// @return the number of logical cores
+//
+unsigned int CWorkerPool::GetNbThreads()
+{
+#ifdef _WINDOWS
+   int nbCores = (int)std::thread::hardware_concurrency();
+#else
+   int nbCores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+   return nbCores > 1 ? (unsigned int)nbCores : 1;
+}
+
+
+// Run in_body over [0, in_count), split into chunks.
+// If called by a thread of the pool (nested loop), the loop is run inline by the calling thread.
+//
+// @param in_count          the number of elements to process
+// @param in_body           the loop body
+// @param in_minChunkSize   the minimum number of elements processed by a single Run call
+//
+void CWorkerPool::ParallelFor(unsigned int in_count, CParallelForBody &in_body, unsigned int in_minChunkSize)
+{
+   if (in_count == 0)
+      return;
+
+   unsigned int nbThreads = GetNbThreads();
+   // a few chunks per thread, to balance the load when the elements have a different cost
+   unsigned int chunkSize = std::max(in_minChunkSize, in_count / (nbThreads * 4));
+   chunkSize = std::max(chunkSize, 1u);
+   unsigned int nbChunks = (in_count + chunkSize - 1) / chunkSize;
+
+   if (nbChunks < 2 || nbThreads < 2 || s_isPoolWorker) // not worth waking up the workers, or already on a worker
+   {
+      in_body.Run(0, in_count);
+      return;
+   }
+
+   CParallelForData data(&in_body, in_count, chunkSize);
+   GetWorkerThreads()->Run(&data);
+}
+
+
+// Stop and destroy the threads of the pool. Called when the plugin is unloaded
+//
+void CWorkerPool::Shutdown()
+{
+   lock_guard <mutex> lock(s_workerThreadsMutex);
+   delete s_workerThreads;
+   s_workerThreads = NULL;
+}
+
+
+/////////////////////////////////////
+/////////////////////////////////////
+// CExportJobQueue
+/////////////////////////////////////
+/////////////////////////////////////
+
+// The loop body running the jobs of the queue
+class CRunJobsBody : public CParallelForBody
+{
+private:
+   vector <CWorkerJob*> &m_jobs;
+public:
+   CRunJobsBody(vector <CWorkerJob*> &in_jobs) : m_jobs(in_jobs)
+   {}
+
+   void Run(unsigned int in_begin, unsigned int in_end)
+   {
+      for (unsigned int i = in_begin; i < in_end; i++)
+         m_jobs[i]->Run();
+   }
+};
+
+
+// Enable or disable the deferred mode. Disabling it flushes the pending jobs
+//
+// @param in_deferred      true to defer the jobs until Flush is called
+//
+void CExportJobQueue::SetDeferred(bool in_deferred)
+{
+   if (!in_deferred)
+      Flush();
+   m_deferred = in_deferred;
+}
+
+
+// Return true if the jobs are being deferred
+//
+bool CExportJobQueue::IsDeferred() const
+{
+   return m_deferred;
+}
+
+
+// Push a job. If the queue is not deferred, the job is run and committed right away
+//
+// @param in_job      the job. The queue takes ownership of it
+//
+void CExportJobQueue::Push(CWorkerJob *in_job)
+{
+   if (!m_deferred)
+   {
+      in_job->Run();
+      in_job->Commit();
+      delete in_job;
+      return;
+   }
+
+   AiCritSecEnter(&m_cs);
+   m_jobs.push_back(in_job);
+   AiCritSecLeave(&m_cs);
+}
+
+
+// Run all the pending jobs on the worker pool, then commit them in the order they were pushed, 
+// so that the resulting scene does not depend on the threads scheduling
+//
+void CExportJobQueue::Flush()
+{
+   AiCritSecEnter(&m_cs);
+   vector <CWorkerJob*> jobs;
+   jobs.swap(m_jobs);
+   AiCritSecLeave(&m_cs);
+
+   if (jobs.empty())
+      return;
+
+   CRunJobsBody body(jobs);
+   CWorkerPool::ParallelFor((unsigned int)jobs.size(), body);
+
+   for (vector <CWorkerJob*>::iterator it = jobs.begin(); it != jobs.end(); it++)
+   {
+      (*it)->Commit();
+      delete *it;
+   }
+}
+
+
+// Delete all the pending jobs without running them
+//
+void CExportJobQueue::Clear()
+{
+   AiCritSecEnter(&m_cs);
+   for (vector <CWorkerJob*>::iterator it = m_jobs.begin(); it != m_jobs.end(); it++)
+      delete *it;
+   m_jobs.clear();
+   AiCritSecLeave(&m_cs);
+}
+
+
+// Return the number of pending jobs
+//
+size_t CExportJobQueue::GetCount()
+{
+   AiCritSecEnter(&m_cs);
+   size_t count = m_jobs.size();
+   AiCritSecLeave(&m_cs);
+   return count;
+}
@@ -0,0 +1,102 @@
+/************************************************************************************************************************************
+Copyright 2017 Autodesk, Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance with the License. 
+You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is distributed on an "AS IS" BASIS, 
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+See the License for the specific language governing permissions and limitations under the License.
+************************************************************************************************************************************/
+
+#pragma once
+
+#include <ai_critsec.h>
+
+#include <vector>
+
+using namespace std;
+
+////////////////////////////////
+// The Softimage SDK can only be called by the main thread (see LockSceneData), so everything
+// that runs on the workers below must only deal with data that was already pulled from the scene,
+// and with Arnold arrays and nodes.
+////////////////////////////////
+
+// Body of a parallel loop. Run is called with non overlapping [in_begin, in_end) ranges
+class CParallelForBody
+{
+public:
+   virtual ~CParallelForBody()
+   {}
+   // Process the [in_begin, in_end) range
+   virtual void Run(unsigned int in_begin, unsigned int in_end) = 0;
+};
+
+
+// The pool of the worker threads.
+// The threads are created once, and kept waiting for the loops. A loop posted by a worker thread
+// (for instance by a job run by CExportJobQueue::Flush) is run inline, without waking up the other threads.
+class CWorkerPool
+{
+public:
+   // Return the number of threads to be used by the pool
+   static unsigned int GetNbThreads();
+   // Run in_body over [0, in_count), split into chunks of at least in_minChunkSize elements.
+   // The calling thread takes part to the loop, and the function returns when all the chunks are done
+   static void ParallelFor(unsigned int in_count, CParallelForBody &in_body, unsigned int in_minChunkSize = 1);
+   // Stop and destroy the threads
+   static void Shutdown();
+};
+
+
+// A unit of export work. Run is called by any thread, so it must not call the Softimage SDK.
+// Commit is called by the main thread, in the order the jobs were pushed into the queue
+class CWorkerJob
+{
+public:
+   virtual ~CWorkerJob()
+   {}
+   // The parallel part of the job
+   virtual void Run() = 0;
+   // The serial part of the job, for instance assigning the arrays built by Run to the node
+   virtual void Commit()
+   {}
+};
+
+
+// The queue of the export jobs.
+// If not deferred, the pushed jobs are run and committed right away, so the loaders don't have
+// to care about the export mode. If deferred, the jobs are stored until Flush is called.
+class CExportJobQueue
+{
+private:
+   vector <CWorkerJob*> m_jobs;
+   bool                 m_deferred;
+   AtCritSec            m_cs;
+
+public:
+   CExportJobQueue() : m_deferred(false)
+   {
+      AiCritSecInit(&m_cs);
+   }
+
+   ~CExportJobQueue()
+   {
+      Clear();
+      AiCritSecClose(&m_cs);
+   }
+
+   // Enable or disable the deferred mode. Disabling it flushes the pending jobs
+   void SetDeferred(bool in_deferred);
+   // Return true if the jobs are being deferred
+   bool IsDeferred() const;
+   // Push a job. The queue takes ownership of it
+   void Push(CWorkerJob *in_job);
+   // Run all the pending jobs on the worker pool, then commit them in order
+   void Flush();
+   // Delete all the pending jobs without running them (for instance when the export is aborted)
+   void Clear();
+   // Return the number of pending jobs
+   size_t GetCount();
+};
@@ -0,0 +1,195 @@
+/************************************************************************************************************************************
+Copyright 2017 Autodesk, Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance with the License. 
+You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is distributed on an "AS IS" BASIS, 
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+See the License for the specific language governing permissions and limitations under the License.
+************************************************************************************************************************************/
+
+#include "common/Tools.h"
+#include "loader/AsyncAssWriter.h"
+#include "renderer/Renderer.h"
+
+#include <ai_dotass.h>
+#include <ai_threads.h>
+
+#include <chrono>
+#include <cstdio>
+
+#ifdef SITOA_USE_ZLIB
+#include <zlib.h>
+#endif
+
+// the size of the chunks read from the uncompressed file
+#define ASS_COMPRESS_CHUNK_SIZE (1 << 20)
+
+
+#ifdef SITOA_USE_ZLIB
+// Gzip a file
+//
+// @param in_source      the file to compress
+// @param in_dest        the compressed file
+//
+// @return true if all went well
+//
+static bool GzipFile(const char *in_source, const char *in_dest)
+{
+   FILE *source = fopen(in_source, "rb");
+   if (!source)
+      return false;
+
+   gzFile dest = gzopen(in_dest, "wb");
+   if (!dest)
+   {
+      fclose(source);
+      return false;
+   }
+
+   vector <char> buffer(ASS_COMPRESS_CHUNK_SIZE);
+   bool success(true);
+   size_t nbRead;
+   while (success && (nbRead = fread(&buffer[0], 1, buffer.size(), source)) > 0)
+      success = gzwrite(dest, &buffer[0], (unsigned int)nbRead) == (int)nbRead;
+
+   success = success && !ferror(source);
+   fclose(source);
+   return gzclose(dest) == Z_OK && success;
+}
+
+
+// The thread function compressing a .ass file
+//
+// @param in_data      the CAssCompressJob
+//
+// @return 0
+//
+static unsigned int CompressThread(void *in_data)
+{
+   CAssCompressJob *job = (CAssCompressJob*)in_data;
+
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+   job->m_success = GzipFile(job->m_tempFilename.c_str(), job->m_filename.c_str());
+   // if it failed, leave the uncompressed file, so that the frame is not lost
+   if (job->m_success)
+      remove(job->m_tempFilename.c_str());
+   job->m_time = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+   job->m_done = true;
+   return 0;
+}
+#endif
+
+
+// Set the progress bar where the completed frames are shown
+//
+// @param in_progressBar    the export progress bar, or NULL
+//
+void CAsyncAssWriter::SetProgressBar(ProgressBar *in_progressBar)
+{
+   m_progressBar = in_progressBar;
+}
+
+
+// Write the current universe into a .ass file.
+// If the file is to be compressed, the compression is left to a background thread.
+//
+// @param in_filename    the .ass file name
+// @param in_mask        the types of the nodes to write
+// @param in_openProcs   expand the procedurals
+// @param in_binary      binary-encode the arrays
+// @param in_frame       the frame time, for the logging
+//
+// @return false if AiASSWrite failed, else true. The compression errors are only logged, by Report
+//
+bool CAsyncAssWriter::Write(const CPathString &in_filename, int in_mask, bool in_openProcs, bool in_binary, double in_frame)
+{
+#ifdef SITOA_USE_ZLIB
+   if (CStringUtilities().EndsWith(in_filename, L".gz"))
+   {
+      // don't pile up more uncompressed files than allowed
+      Report(m_maxPendingJobs - 1);
+
+      // AiASSWrite compresses only if the name ends by .gz
+      CPathString tempFilename = in_filename + L".tmp";
+      if (AiASSWrite(tempFilename.GetAsciiString(), in_mask, in_openProcs, in_binary) != AI_SUCCESS)
+      {
+         // don't leave a partial file, and don't compress it
+         remove(tempFilename.GetAsciiString());
+         return false;
+      }
+
+      CAssCompressJob *job = new CAssCompressJob(in_filename.GetAsciiString(), tempFilename.GetAsciiString(), in_frame);
+      job->m_thread = AiThreadCreate(CompressThread, job, AI_PRIORITY_LOW);
+      if (!job->m_thread) // compress it here then
+         CompressThread(job);
+
+      m_jobs.push_back(job);
+      return true;
+   }
+#endif
+
+   return AiASSWrite(in_filename.GetAsciiString(), in_mask, in_openProcs, in_binary) == AI_SUCCESS;
+}
+
+
+// Wait for the oldest jobs until no more than in_maxPendingJobs are left, and report the completed ones.
+// Completed jobs are only reported once all the previous ones are, so the frames are reported in order.
+//
+// @param in_maxPendingJobs   the max number of jobs that can be left running
+//
+void CAsyncAssWriter::Report(size_t in_maxPendingJobs)
+{
+   while (!m_jobs.empty())
+   {
+      CAssCompressJob *job = m_jobs.front();
+      if (!job->m_done && m_jobs.size() <= in_maxPendingJobs)
+         break;
+
+      if (job->m_thread)
+      {
+         AiThreadWait(job->m_thread);
+         AiThreadClose(job->m_thread);
+      }
+
+      if (job->m_success)
+         GetMessageQueue()->LogMsg(L"[sitoa] Frame " + CValue(job->m_frame).GetAsText() + L" compressed in the background (" + 
+                                   CValue(job->m_time).GetAsText() + L" sec.)");
+      else
+         GetMessageQueue()->LogMsg(L"[sitoa] Frame " + CValue(job->m_frame).GetAsText() + L": could not compress " + 
+                                   CString(job->m_filename.c_str()) + L", the uncompressed file was left as " + CString(job->m_tempFilename.c_str()), siErrorMsg);
+
+      if (m_progressBar)
+         m_progressBar->PutStatusText(L"Compressed ASS Frame " + CValue(job->m_frame).GetAsText());
+
+      delete job;
+      m_jobs.erase(m_jobs.begin());
+   }
+}
+
+
+// Log the frames whose compression is over, without waiting for the others
+//
+void CAsyncAssWriter::Poll()
+{
+   Report(m_jobs.size());
+}
+
+
+// Wait for all the pending compressions
+//
+void CAsyncAssWriter::Finish()
+{
+   Report(0);
+}
+
+
+// Return the number of frames still being compressed
+//
+size_t CAsyncAssWriter::GetPendingCount() const
+{
+   return m_jobs.size();
+}
+
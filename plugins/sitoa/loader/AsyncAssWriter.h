@@ -0,0 +1,80 @@
+/************************************************************************************************************************************
+Copyright 2017 Autodesk, Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance with the License. 
+You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is distributed on an "AS IS" BASIS, 
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+See the License for the specific language governing permissions and limitations under the License.
+************************************************************************************************************************************/
+
+#pragma once
+
+#include "loader/PathTranslator.h"
+
+#include <xsi_progressbar.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace XSI;
+
+// A .ass file being compressed by a background thread.
+// Only std types here, since the Softimage SDK can't be called by the thread
+class CAssCompressJob
+{
+public:
+   string       m_filename;      // the final .ass.gz file
+   string       m_tempFilename;  // the uncompressed .ass file written by AiASSWrite
+   double       m_frame;
+   void*        m_thread;
+   bool         m_success;
+   double       m_time;          // compression time, in seconds
+   atomic<bool> m_done;
+
+   CAssCompressJob(const string &in_filename, const string &in_tempFilename, double in_frame) : 
+      m_filename(in_filename), m_tempFilename(in_tempFilename), m_frame(in_frame), 
+      m_thread(NULL), m_success(false), m_time(0.0), m_done(false)
+   {}
+};
+
+
+// Writes the .ass files of an export.
+// The .ass.gz files are first written uncompressed by AiASSWrite, then gzipped by a background thread, 
+// so that the next frame can be loaded while the previous one is being compressed. 
+// At most m_maxPendingJobs files wait for their compression at any time, and the completed frames 
+// are logged and shown on the export progress bar by the main thread, in frame order.
+class CAsyncAssWriter
+{
+private:
+   vector <CAssCompressJob*> m_jobs;   // the pending jobs, in frame order
+   size_t m_maxPendingJobs;
+   ProgressBar* m_progressBar;         // the export progress bar, NULL if not shown
+
+   // Wait for the oldest jobs until no more than in_maxPendingJobs are left, and log the completed ones
+   void Report(size_t in_maxPendingJobs);
+
+public:
+   CAsyncAssWriter(size_t in_maxPendingJobs = 2) : m_maxPendingJobs(in_maxPendingJobs > 0 ? in_maxPendingJobs : 1), m_progressBar(NULL)
+   {}
+
+   ~CAsyncAssWriter()
+   {
+      Finish();
+   }
+
+   // Set the progress bar where the completed frames are shown
+   void SetProgressBar(ProgressBar *in_progressBar);
+   // Write the current universe into a .ass file
+   bool Write(const CPathString &in_filename, int in_mask, bool in_openProcs, bool in_binary, double in_frame);
+   // Log the frames whose compression is over, without waiting for the others
+   void Poll();
+   // Wait for all the pending compressions
+   void Finish();
+   // Return the number of frames still being compressed
+   size_t GetPendingCount() const;
+};
+
@@ -369,11 +369,12 @@ CStatus LoadSingleHair(const X3DObject &in_xsiObj, double in_frame)
                   LONG nbValues = uvValues.GetCount();
 
                   AtArray* uvs = AiArrayAllocate(nbValues/3, 1, AI_TYPE_VECTOR2);
-                  
-                  for (LONG i=0; i<nbValues; i+=3)
+                  // skip w
+                  if (!CBulkCopy::SetKeyStrided(uvs, uvValues.GetArray(), (size_t)(nbValues/3), 3, 0))
                   {
-                     AtVector2 uv = AtVector2(uvValues[i], uvValues[i+1]);
-                     AiArraySetVec2(uvs, i/3, uv);
+                     GetMessageQueue()->LogMsg(L"[sitoa] UV size mismatch for " + projectionName + L" of " + in_xsiObj.GetFullName() + L". Skipping.", siWarningMsg);
+                     AiArrayDestroy(uvs);
+                     continue;
                   }
 
                   if (!uvs_done)
@@ -400,12 +401,13 @@ CStatus LoadSingleHair(const X3DObject &in_xsiObj, double in_frame)
                   if (AiNodeDeclare(curvesNode, cavName.GetAsciiString(), "uniform RGBA"))
                   {
                      AtArray* rgba = AiArrayAllocate(nbValues/4, 1, AI_TYPE_RGBA);
-                     for (LONG i=0; i<nbValues; i+=4)
+                     if (CBulkCopy::SetKey(rgba, cavValues.GetArray(), (size_t)(nbValues/4) * 4, 0))
+                        AiNodeSetArray(curvesNode, cavName.GetAsciiString(), rgba);
+                     else
                      {
-                        AtRGBA color = AtRGBA(cavValues[i], cavValues[i+1], cavValues[i+2], cavValues[i+3]);
-                        AiArraySetRGBA(rgba, i/4, color);
+                        GetMessageQueue()->LogMsg(L"[sitoa] Vertex color size mismatch for " + cavName + L" of " + in_xsiObj.GetFullName() + L". Skipping.", siWarningMsg);
+                        AiArrayDestroy(rgba);
                      }
-                     AiNodeSetArray(curvesNode, cavName.GetAsciiString(), rgba);
                   }
                }
 
@@ -416,7 +418,7 @@ CStatus LoadSingleHair(const X3DObject &in_xsiObj, double in_frame)
                for (unsigned int ikey=0; ikey<nbTransfKeys; ikey++)
                {
                   AtMatrix matrix;
-                  CUtilities().S2A(in_xsiObj.GetKinematics().GetGlobal().GetTransform(transfKeys[ikey]).GetMatrix4(), matrix);
+                  GetRenderInstance()->TransformCache().GetGlobalMatrix(in_xsiObj, transfKeys[ikey], matrix);
                   AiArraySetMtx(matrices, ikey, matrix);
                }
 
@@ -428,52 +430,47 @@ CStatus LoadSingleHair(const X3DObject &in_xsiObj, double in_frame)
 
                // Allocating radius Array
                AtArray* radiusArray = AiArrayAllocate(nbRadii, 1, AI_TYPE_FLOAT);
-               
-               for (LONG i=0; i<nbRadii; i++)
-                  AiArraySetFlt(radiusArray, i, vertexRadius[i]);
-
-               AiNodeSetArray(curvesNode, "radius", radiusArray);
+               if (CBulkCopy::SetKey(radiusArray, vertexRadius.GetArray(), (size_t)nbRadii, 0))
+                  AiNodeSetArray(curvesNode, "radius", radiusArray);
+               else // leave the default radius
+               {
+                  GetMessageQueue()->LogMsg(L"[sitoa] Radius size mismatch for " + in_xsiObj.GetFullName() + L". Using the default radius.", siWarningMsg);
+                  AiArrayDestroy(radiusArray);
+               }
 
                // Allocating and assigning the points array once. Later we will get that array and set the keys
                AtArray* totalPoints = AiArrayAllocate(nbFloat, (uint8_t)nbDefKeys, AI_TYPE_FLOAT);
                AiNodeSetArray(curvesNode, "points", totalPoints);
             }
 
-            // points array for this key
-            AtArray* pointsArray = AiArrayAllocate(nbFloat, 1, AI_TYPE_FLOAT);
+            // write the points straight into this key of the points array
+            AtArray* totalPoints = AiNodeGetArray(curvesNode, "points");
+            float* points = (float*)AiArrayMap(totalPoints) + (size_t)ikey * nbFloat;
+            const float* positions = vertexPositions.GetArray();
 
             // For catmull-rom we need to repeat the first and last points for each curve
-            LONG iposition = 0;
             LONG posPerHair = (LONG)(nbPositions/chunkSize);
 
             for (LONG ihair=0; ihair<chunkSize; ihair++)
             {
-               unsigned int idx = ihair*posPerHair;
+               const float* hairPositions = positions + ihair*posPerHair;
                
                //Adding first coordinates for catmull-rom       
-               AiArraySetFlt(pointsArray, iposition++, vertexPositions[idx]);
-               AiArraySetFlt(pointsArray, iposition++, vertexPositions[idx+1]);
-               AiArraySetFlt(pointsArray, iposition++, vertexPositions[idx+2]);
-             
+               CBulkCopy::Convert(hairPositions, points, 3);
+               points+= 3;
                // Filling the points
-               for (LONG i=0; i<posPerHair; i++)
-                  AiArraySetFlt(pointsArray, iposition++, vertexPositions[idx+i]);
-               
+               CBulkCopy::Convert(hairPositions, points, posPerHair);
+               points+= posPerHair;
                // Adding last coordinates again for catmull-rom (need 1 vertex more)
-               AiArraySetFlt(pointsArray, iposition++, vertexPositions[idx+posPerHair-3]);
-               AiArraySetFlt(pointsArray, iposition++, vertexPositions[idx+posPerHair-2]);
-               AiArraySetFlt(pointsArray, iposition++, vertexPositions[idx+posPerHair-1]);
+               CBulkCopy::Convert(hairPositions + posPerHair - 3, points, 3);
+               points+= 3;
 
                // Adding Hair ID to list
                if (ikey==0) 
                   hairsIDVector.push_back(hairID++);
             }
 
-            // Setting Array to Node Points Array to its key
-            AtArray* totalPoints = AiNodeGetArray(curvesNode, "points");
-            AiArraySetKey(totalPoints, (uint8_t)ikey, AiArrayMap(pointsArray)); // direct access, deprecated
-            // destroy pointsArray once its data has been copied
-            AiArrayDestroy(pointsArray);
+            AiArrayUnmap(totalPoints);
          }
 
          // Adding Hair IDs to Chunk
@@ -876,6 +873,9 @@ CStatus LoadSingleHairInstance(const X3DObject &in_xsiObj, SIObject in_group, do
          hair.BuildFromXsiHairAccessor(hairAccessor, assignmentWeightMapName, tangentMapName, instanceOrientationSpread);
          // hair.Log();
 
+         // The instances to bend along the strands of this chunk
+         vector <CStrandBendTask> bendTasks;
+
          for (int strandIndex=0; strandIndex<hair.GetNbStrands(); strandIndex++)
          {
             // let's decide the group element to use
@@ -922,35 +922,35 @@ CStatus LoadSingleHairInstance(const X3DObject &in_xsiObj, SIObject in_group, do
                else // Retrieve the clone from the currentStrandIndex-th strand, so to store the extra mb points/vectors
                   cloneNode = clonedNodes[currentStrandIndex][j];
 
-               if (CNodeUtilities().GetEntryName(cloneNode) == L"curves")
-               {
-                  // allocate the points array for the curves node 
-                  vlist = AiArrayAllocate((int)strandInstance->m_points.size(), (uint8_t)nbDefKeys, AI_TYPE_VECTOR);
-                  nlist = NULL;
-               }
-               else
+               bool isCurves = CNodeUtilities().GetEntryName(cloneNode) == L"curves";
+               if (iDefKey == 0)
                {
-                  // Allocate as many vertices and normals as needed.
+                  // Allocate as many vertices and normals as needed, and give them to the cloned node.
                   // We need to allocate, instead of re-using the master vectors, since the number
                   // of mb keys could differ from the master ones.
                   vlist = AiArrayAllocate((int)strandInstance->m_points.size(), (uint8_t)nbDefKeys, AI_TYPE_VECTOR);
-                  nlist = AiArrayAllocate((int)strandInstance->m_normals.size(), (uint8_t)nbDefKeys, AI_TYPE_VECTOR);
+                  if (isCurves)
+                  {
+                     nlist = NULL;
+                     AiNodeSetArray(cloneNode, "points", vlist);
+                  }
+                  else
+                  {
+                     nlist = AiArrayAllocate((int)strandInstance->m_normals.size(), (uint8_t)nbDefKeys, AI_TYPE_VECTOR);
+                     AiNodeSetArray(cloneNode, "vlist", vlist);
+                     AiNodeSetArray(cloneNode, "nlist", nlist);
+                  }
                }
-
-               // Bend the instanced objects along the strand
-               strandInstance->BendOnStrand(hair.m_strands[strandIndex]);
-               // Assign the bended points/normals to the iDefKey-th array of vlist and nlist
-               strandInstance->Get(vlist, nlist, iDefKey);
-
-               // Give the arrays to the cloned node
-               if (CNodeUtilities().GetEntryName(cloneNode) == L"curves")
-                  AiNodeSetArray(cloneNode, "points", vlist);
-               else
+               else // the arrays were allocated for all the keys on the first mb loop
                {
-                  AiNodeSetArray(cloneNode, "vlist", vlist);
-                  AiNodeSetArray(cloneNode, "nlist", nlist);
+                  vlist = AiNodeGetArray(cloneNode, isCurves ? "points" : "vlist");
+                  nlist = isCurves ? NULL : AiNodeGetArray(cloneNode, "nlist");
                }
 
+               // Bend the instanced objects along the strand into the iDefKey-th key of vlist and nlist.
+               // This is done for all the strands of the chunk at once, see below
+               bendTasks.push_back(CStrandBendTask(strandInstance, &hair.m_strands[strandIndex], vlist, nlist, iDefKey));
+
                // Set the matrices on the clone. Let's do it only once, not for every deform step
                if (iDefKey == 0)
                {
@@ -959,7 +959,7 @@ CStatus LoadSingleHairInstance(const X3DObject &in_xsiObj, SIObject in_group, do
                   for (unsigned int iTransfKey=0; iTransfKey<nbTransfKeys; iTransfKey++)
                   {
                      // Get the transform matrices of the hair object and assign them to the clone
-                     CUtilities().S2A(in_xsiObj.GetKinematics().GetGlobal().GetTransform(transfKeys[iTransfKey]), matrix);
+                     GetRenderInstance()->TransformCache().GetGlobalMatrix(in_xsiObj, transfKeys[iTransfKey], matrix);
                      AiArraySetMtx(matrices, iTransfKey, matrix);
                   }
                   AiNodeSetArray(cloneNode, "matrix", matrices);
@@ -1010,6 +1010,9 @@ CStatus LoadSingleHairInstance(const X3DObject &in_xsiObj, SIObject in_group, do
             // Increment the current global strand index
             currentStrandIndex++;
          }
+
+         // Bend all the instances of the chunk in parallel
+         BendStrandInstances(bendTasks);
       }
    }
 
@@ -11,6 +11,7 @@ See the License for the specific language governing permissions and limitations
 
 #include "common/ParamsCommon.h"
 #include "common/Tools.h"
+#include "common/WorkerPool.h"
 #include "loader/ICE.h"
 #include "loader/Instances.h"
 #include "loader/Lights.h"
@@ -74,6 +75,100 @@ CStatus LoadPointClouds(double in_frame, CRefArray &in_selectedObjs, bool in_sel
 }
 
 
+// A sphere, point, rectangle, disc, box, cylinder or cone point, whose placing is computed by the worker pool.
+// The point data are read from the ice attributes by the main thread.
+class CIcePointTransformTask
+{
+public:
+   siICEShapeType       m_shapeType;
+   CIceObjectBaseShape *m_shape;         // the disc, box, cylinder or cone object getting the matrices
+   AtNode              *m_unitShapeNode; // if batched, the unit shape to be instanced by the instancer
+   int                  m_index;         // the index of the point into the points or rectangles arrays
+   LONG                 m_pointIndex;
+   CVector3f            m_pos, m_scale, m_vel;
+   CRotation            m_ori, m_angVel;
+   float                m_radius;
+
+   CIcePointTransformTask(siICEShapeType in_shapeType, CIceObjectBaseShape *in_shape, AtNode *in_unitShapeNode, int in_index, 
+                          LONG in_pointIndex, const CVector3f &in_pos, const CVector3f &in_scale, const CRotation &in_ori,
+                          const CVector3f &in_vel, const CRotation &in_angVel, float in_radius) :
+      m_shapeType(in_shapeType), m_shape(in_shape), m_unitShapeNode(in_unitShapeNode), m_index(in_index), 
+      m_pointIndex(in_pointIndex), m_pos(in_pos), m_scale(in_scale), m_vel(in_vel), m_ori(in_ori), m_angVel(in_angVel), 
+      m_radius(in_radius)
+   {}
+};
+
+
+// Parallel body placing the sphere, point, rectangle, disc, box, cylinder and cone points of a chunk.
+// Each task writes into its own index of the points and rectangles arrays, or into the matrices of its 
+// own object, so no locking is needed
+class CIcePointTransformBody : public CParallelForBody
+{
+private:
+   vector <CIcePointTransformTask> &m_tasks;
+   CIceObjects                     &m_iceObjects;
+   const CDoubleArray              &m_keysTime;
+   float                            m_secondsPerFrame;
+   bool                             m_exactMb;
+   const vector <CVector3f>        &m_mbPos;
+   const vector <CVector3f>        &m_mbScale;
+   const vector <float>            &m_mbSize;
+   const vector <CRotation>        &m_mbOri;
+
+public:
+   CIcePointTransformBody(vector <CIcePointTransformTask> &in_tasks, CIceObjects &in_iceObjects, const CDoubleArray &in_keysTime, 
+                          float in_secondsPerFrame, bool in_exactMb, const vector <CVector3f> &in_mbPos, 
+                          const vector <CVector3f> &in_mbScale, const vector <float> &in_mbSize, const vector <CRotation> &in_mbOri) :
+      m_tasks(in_tasks), m_iceObjects(in_iceObjects), m_keysTime(in_keysTime), m_secondsPerFrame(in_secondsPerFrame), 
+      m_exactMb(in_exactMb), m_mbPos(in_mbPos), m_mbScale(in_mbScale), m_mbSize(in_mbSize), m_mbOri(in_mbOri)
+   {}
+
+   void Run(unsigned int in_begin, unsigned int in_end)
+   {
+      for (unsigned int i = in_begin; i < in_end; i++)
+      {
+         CIcePointTransformTask &task = m_tasks[i];
+         switch (task.m_shapeType)
+         {
+            case siICEShapeSphere:
+            case siICEShapePoint:
+            {
+               CIceObjectPoints *points = task.m_shapeType == siICEShapeSphere ? 
+                                          (CIceObjectPoints*)&m_iceObjects.m_pointsSphere[0] : 
+                                          (CIceObjectPoints*)&m_iceObjects.m_pointsDisk[0];
+               // Set the point position and radius at the 0-th key. In case there is mb, the further keys will 
+               // be computed out of them (and the 0-th one will be overwritten correctly as well)
+               points->SetPoint(task.m_pos, task.m_index, 0);
+               points->SetRadius(task.m_radius, task.m_index, 0);
+               if (m_keysTime.GetCount() > 1)
+                  points->ComputeMotionBlur(m_keysTime, m_secondsPerFrame, task.m_vel, m_exactMb, m_mbPos, m_mbSize, task.m_index, task.m_pointIndex);
+               break;
+            }
+            case siICEShapeRectangle:
+            {
+               CIceObjectRectangle *rectangles = &m_iceObjects.m_rectangles[0];
+               rectangles->SetPoint(task.m_pos, task.m_index, 0);
+               rectangles->SetScale(task.m_scale, task.m_index, 0);
+               rectangles->SetRotation(task.m_ori, task.m_index, 0);
+               if (m_keysTime.GetCount() > 1)
+                  rectangles->ComputeMotionBlur(m_keysTime, m_secondsPerFrame, task.m_vel, m_exactMb, m_mbPos, m_mbScale, m_mbOri, task.m_index, task.m_pointIndex);
+               break;
+            }
+            default: // disc, box, cylinder, cone
+               // set the transform of the point out of this point pos, scale and orientation
+               task.m_shape->SetTransf(task.m_pos, task.m_scale, task.m_ori);
+               if (m_keysTime.GetCount() > 1) // mb enabled? write the node matrix for each key, based on the point vels
+                  task.m_shape->ComputeMotionBlur(m_keysTime, m_secondsPerFrame, task.m_vel, task.m_angVel, m_exactMb, 
+                                                  m_mbPos, m_mbScale, m_mbOri, task.m_pointIndex);
+               else // give the node matrix equal to the above transformation
+                  task.m_shape->SetMatrix(task.m_shape->m_transf, 0);
+               break;
+         }
+      }
+   }
+};
+
+
 // Load a pointcloud object
 //
 // @param in_xsiObj              The Softimage pc
@@ -297,7 +392,30 @@ CStatus LoadSinglePointCloud(const X3DObject &in_xsiObj, double in_frame,
       iceObjects.m_rectangles[0].CreateNode(objectID, name.GetAsciiString(), nbTransfKeys);
       iceObjects.m_rectangles[0].Resize(iceObjects.m_nbRectangles, nbTransfKeys, doExactTransformMb);
    }
-   if (iceObjects.m_nbDiscs > 0) // Softimage discs, exported as Arnold disc nodes
+   // the ginstances, discs, boxes, cylinders and cones get replaced by a single instancer node.
+   // For the shapes, a single unit shape per type is exported, and instanced on all the points of that type
+   if (GetRenderOptions()->m_ice_instancer && 
+       iceObjects.m_nbDiscs + iceObjects.m_nbBoxes + iceObjects.m_nbCylinders + iceObjects.m_nbCones + iceObjects.m_nbInstances > 0)
+   {
+      iceObjects.m_instancer.resize(1);
+      CString name = CStringUtilities().MakeSItoAName((SIObject)in_xsiObj, in_frame, L"Instancer", false);
+      iceObjects.m_instancer[0].CreateNode(objectID, name.GetAsciiString(), nbTransfKeys);
+      iceObjects.m_batchShapes = true;
+   }
+   // the placing of the batched shapes is computed here, and then given to the instancer.
+   // Reserve for the largest chunk, so that the tasks can point to the elements
+   vector <CIceObjectBaseShape> batchedShapes;
+   int batchedShapeIndex(0);
+   if (iceObjects.m_batchShapes)
+      batchedShapes.reserve(pointCount < ICE_CHUNK_SIZE ? pointCount : ICE_CHUNK_SIZE);
+
+   if (iceObjects.m_nbDiscs > 0 && iceObjects.m_batchShapes)
+   {
+      iceObjects.m_discs.resize(1);
+      CString name = CStringUtilities().MakeSItoAName((SIObject)in_xsiObj, in_frame, L"Disc", false);
+      iceObjects.m_discs[0].CreateNode(objectID, name.GetAsciiString(), nbTransfKeys);
+   }
+   else if (iceObjects.m_nbDiscs > 0) // Softimage discs, exported as Arnold disc nodes
    {
       iceObjects.m_discs.resize(iceObjects.m_nbDiscs); // one node per point
       CString baseName = CStringUtilities().MakeSItoAName((SIObject)in_xsiObj, in_frame, L"Disc", false) + L".";
@@ -311,7 +429,13 @@ CStatus LoadSinglePointCloud(const X3DObject &in_xsiObj, double in_frame,
          iceObjects.m_discs[i].CreateNode(objectID, name, nbTransfKeys);
       }
    }
-   if (iceObjects.m_nbBoxes > 0)
+   if (iceObjects.m_nbBoxes > 0 && iceObjects.m_batchShapes)
+   {
+      iceObjects.m_boxes.resize(1);
+      CString name = CStringUtilities().MakeSItoAName((SIObject)in_xsiObj, in_frame, L"Box", false);
+      iceObjects.m_boxes[0].CreateNode(objectID, name.GetAsciiString(), nbTransfKeys);
+   }
+   else if (iceObjects.m_nbBoxes > 0)
    {
       iceObjects.m_boxes.resize(iceObjects.m_nbBoxes);
       CString baseName = CStringUtilities().MakeSItoAName((SIObject)in_xsiObj, in_frame, L"Box", false) + L".";
@@ -325,7 +449,13 @@ CStatus LoadSinglePointCloud(const X3DObject &in_xsiObj, double in_frame,
          iceObjects.m_boxes[i].CreateNode(objectID, name, nbTransfKeys);
       }
    }
-   if (iceObjects.m_nbCylinders > 0)
+   if (iceObjects.m_nbCylinders > 0 && iceObjects.m_batchShapes)
+   {
+      iceObjects.m_cylinders.resize(1);
+      CString name = CStringUtilities().MakeSItoAName((SIObject)in_xsiObj, in_frame, L"Cylinder", false);
+      iceObjects.m_cylinders[0].CreateNode(objectID, name.GetAsciiString(), nbTransfKeys);
+   }
+   else if (iceObjects.m_nbCylinders > 0)
    {
       iceObjects.m_cylinders.resize(iceObjects.m_nbCylinders);
       CString baseName = CStringUtilities().MakeSItoAName((SIObject)in_xsiObj, in_frame, L"Cylinder", false) + L".";
@@ -339,7 +469,13 @@ CStatus LoadSinglePointCloud(const X3DObject &in_xsiObj, double in_frame,
          iceObjects.m_cylinders[i].CreateNode(objectID, name, nbTransfKeys);
       }
    }
-   if (iceObjects.m_nbCones > 0)
+   if (iceObjects.m_nbCones > 0 && iceObjects.m_batchShapes)
+   {
+      iceObjects.m_cones.resize(1);
+      CString name = CStringUtilities().MakeSItoAName((SIObject)in_xsiObj, in_frame, L"Cone", false);
+      iceObjects.m_cones[0].CreateNode(objectID, name.GetAsciiString(), nbTransfKeys);
+   }
+   else if (iceObjects.m_nbCones > 0)
    {
       iceObjects.m_cones.resize(iceObjects.m_nbCones);
       CString baseName = CStringUtilities().MakeSItoAName((SIObject)in_xsiObj, in_frame, L"Cone", false) + L".";
@@ -401,6 +537,8 @@ CStatus LoadSinglePointCloud(const X3DObject &in_xsiObj, double in_frame,
    double     shapeFrame(in_frame);
    int        index;
    X3DObject  masterShapeObj;
+   // the sphere, point, rectangle, disc, box, cylinder and cone points of the current chunk
+   vector <CIcePointTransformTask> pointTasks;
 
    // the attributes at the mb frame time
    vector <CVector3f> mbPos, mbScale;
@@ -619,23 +757,13 @@ CStatus LoadSinglePointCloud(const X3DObject &in_xsiObj, double in_frame,
             case siICEShapeSphere:
                if (!isStrandInstance)
                {
-                  // Set the point position. We use the 0-th key to store it.
-                  // In case there is no mb, that's it. Else, the further mb position will be computed out of the 0-th
-                  // position stored here (and the 0-th one will be overwritten correctly as well)
-                  iceObjects.m_pointsSphere[0].SetPoint(pos, pointsSphereIndex, 0); 
+                  // The points are placed by the worker pool at the end of the chunk, each into its own pointsSphereIndex slot.
                   // Note that we multiply size by scale.x. We cannot match the exact look of Soft, that can have
                   // spheres and points scaled along x,y,z. The Arnold point primitive has a unique matrix, and
                   // for each point we can set only a unique radius (not 3). So, let's us the scale x, to give
                   // at least the chance to use the scale on points objects
-                  iceObjects.m_pointsSphere[0].SetRadius(size*scale.GetX(), pointsSphereIndex, 0);
-                  if (nbTransfKeys > 1)
-                  {
-                     // The mb for the points node is achieved with the arrays of points and radii, so we must set them all here
-                     // since to do this we need the point's velocity
-                     vel = iceAttributes.GetPointVelocity(pointIndex);
-                     iceObjects.m_pointsSphere[0].ComputeMotionBlur(keyTransformAtTimeZero, secondsPerFrame, vel, doExactTransformMb, 
-                                                                    mbPos, mbSize, pointsSphereIndex, pointIndex);
-                  }
+                  pointTasks.push_back(CIcePointTransformTask(shapeType, NULL, NULL, pointsSphereIndex, pointIndex, 
+                                                              pos, scale, ori, vel, angVel, size*scale.GetX()));
                   // write the pointIndex-th attribute into the pointsSphereIndex-th user data array
                   if (doAttributes)
                      iceObjects.m_pointsSphere[0].DeclareAttributes(&iceAttributes, in_frame, pointIndex, pointsSphereIndex, iceObjects.m_pointsSphereNbPoints);
@@ -646,33 +774,22 @@ CStatus LoadSinglePointCloud(const X3DObject &in_xsiObj, double in_frame,
             case siICEShapePoint: // points are exported as flat disks. We do the same as before, except we use the pointsDisk[0] class
                if (!isStrandInstance)
                {
-                  iceObjects.m_pointsDisk[0].SetPoint(pos, pointsDiskIndex, 0);
-                  iceObjects.m_pointsDisk[0].SetRadius(size*scale.GetX(), pointsDiskIndex, 0);
-                  if (nbTransfKeys > 1)
-                  {
-                     vel = iceAttributes.GetPointVelocity(pointIndex);
-                     iceObjects.m_pointsDisk[0].ComputeMotionBlur(keyTransformAtTimeZero, secondsPerFrame, vel, doExactTransformMb, mbPos, mbSize, pointsDiskIndex, pointIndex);
-                  }
+                  pointTasks.push_back(CIcePointTransformTask(shapeType, NULL, NULL, pointsDiskIndex, pointIndex, 
+                                                              pos, scale, ori, vel, angVel, size*scale.GetX()));
                   if (doAttributes)
                      iceObjects.m_pointsDisk[0].DeclareAttributes(&iceAttributes, in_frame, pointIndex, pointsDiskIndex, iceObjects.m_pointsDiskNbPoints);
                   pointsDiskIndex++;
                }
                break;
 
-            case siICEShapeRectangle: // points are exported as flat disks. We do the same as before, except we use the pointsDisk[0] class
+            case siICEShapeRectangle: // rectangles are exported as a single polymesh, placed by the worker pool like the points
                if (!isStrandInstance)
                {
-                  iceObjects.m_rectangles[0].SetPoint(pos, rectanglesIndex, 0);
                   CVector3f scaledScale = scale;
                   scaledScale.ScaleInPlace(size);
-                  iceObjects.m_rectangles[0].SetScale(scaledScale, rectanglesIndex, 0);
                   ori = iceAttributes.GetOrientation(pointIndex);
-                  iceObjects.m_rectangles[0].SetRotation(ori, rectanglesIndex, 0);
-                  if (nbTransfKeys > 1)
-                  {
-                     vel = iceAttributes.GetPointVelocity(pointIndex);
-                     iceObjects.m_rectangles[0].ComputeMotionBlur(keyTransformAtTimeZero, secondsPerFrame, vel, doExactTransformMb, mbPos, mbScale, mbOri, rectanglesIndex, pointIndex);
-                  }
+                  pointTasks.push_back(CIcePointTransformTask(shapeType, NULL, NULL, rectanglesIndex, pointIndex, 
+                                                              pos, scaledScale, ori, vel, angVel, size));
                   if (doAttributes)
                      iceObjects.m_rectangles[0].DeclareAttributes(&iceAttributes, in_frame, pointIndex, rectanglesIndex, iceObjects.m_nbRectangles);
                   rectanglesIndex++;
@@ -680,62 +797,60 @@ CStatus LoadSinglePointCloud(const X3DObject &in_xsiObj, double in_frame,
                break;
 
             // single-point objects. They all derive from CIceObjectBaseShape, and are unit primitives (their position == 0).
-            // So, all their placing is defined only by their matrix
+            // So, all their placing is defined only by their matrix.
+            // The matrices are computed by the worker pool at the end of the chunk, here we just collect the point data
             case siICEShapeDisc:
-               if (!isStrandInstance)
-               {
-                  // set the transform of the point out of this point pos, scale and orientation
-                  iceObjects.m_discs[discIndex].SetTransf(pos, scale, ori);
-                  if (nbTransfKeys > 1) // mb enabled? write the node matrix for this key, based on the point vels
-                     iceObjects.m_discs[discIndex].ComputeMotionBlur(keyTransformAtTimeZero, secondsPerFrame, vel, angVel, doExactTransformMb, mbPos, mbScale, mbOri, pointIndex);
-                  else // give the node matrix equal to the above transformation
-                     iceObjects.m_discs[discIndex].SetMatrix(iceObjects.m_discs[discIndex].m_transf, 0);
-                  if (doAttributes) // export the attributes
-                     iceObjects.m_discs[discIndex].DeclareAttributes(&iceAttributes, in_frame, pointIndex);
-                  discIndex++;
-               }
-               break;
-
-            // same as before, just different types of nodes
             case siICEShapeBox:
-               if (!isStrandInstance)
-               {
-                  iceObjects.m_boxes[boxIndex].SetTransf(pos, scale, ori);
-                  if (nbTransfKeys > 1)
-                     iceObjects.m_boxes[boxIndex].ComputeMotionBlur(keyTransformAtTimeZero, secondsPerFrame, vel, angVel, doExactTransformMb, mbPos, mbScale, mbOri, pointIndex);
-                  else
-                     iceObjects.m_boxes[boxIndex].SetMatrix(iceObjects.m_boxes[boxIndex].m_transf, 0);
-                  if (doAttributes)
-                     iceObjects.m_boxes[boxIndex].DeclareAttributes(&iceAttributes, in_frame, pointIndex);
-                  boxIndex++;
-               }
-               break;
-
             case siICEShapeCylinder:
-               if (!isStrandInstance)
-               {
-                  iceObjects.m_cylinders[cylinderIndex].SetTransf(pos, scale, ori);
-                  if (nbTransfKeys > 1)
-                     iceObjects.m_cylinders[cylinderIndex].ComputeMotionBlur(keyTransformAtTimeZero, secondsPerFrame, vel, angVel, doExactTransformMb, mbPos, mbScale, mbOri, pointIndex);
-                  else
-                     iceObjects.m_cylinders[cylinderIndex].SetMatrix(iceObjects.m_cylinders[cylinderIndex].m_transf, 0);
-                  if (doAttributes)
-                     iceObjects.m_cylinders[cylinderIndex].DeclareAttributes(&iceAttributes, in_frame, pointIndex);
-                  cylinderIndex++;
-               }
-               break;
-
             case siICEShapeCone:
                if (!isStrandInstance)
                {
-                  iceObjects.m_cones[coneIndex].SetTransf(pos, scale, ori);
-                  if (nbTransfKeys > 1)
-                     iceObjects.m_cones[coneIndex].ComputeMotionBlur(keyTransformAtTimeZero, secondsPerFrame, vel, angVel, doExactTransformMb, mbPos, mbScale, mbOri, pointIndex);
+                  CIceObjectBaseShape *shapeObject(NULL);
+                  AtNode *unitShapeNode(NULL);
+                  if (shapeType == siICEShapeDisc)
+                  {
+                     if (iceObjects.m_batchShapes)
+                        unitShapeNode = iceObjects.m_discs[0].GetNode();
+                     else
+                        shapeObject = &iceObjects.m_discs[discIndex++];
+                  }
+                  else if (shapeType == siICEShapeBox)
+                  {
+                     if (iceObjects.m_batchShapes)
+                        unitShapeNode = iceObjects.m_boxes[0].GetNode();
+                     else
+                        shapeObject = &iceObjects.m_boxes[boxIndex++];
+                  }
+                  else if (shapeType == siICEShapeCylinder)
+                  {
+                     if (iceObjects.m_batchShapes)
+                        unitShapeNode = iceObjects.m_cylinders[0].GetNode();
+                     else
+                        shapeObject = &iceObjects.m_cylinders[cylinderIndex++];
+                  }
                   else
-                     iceObjects.m_cones[coneIndex].SetMatrix(iceObjects.m_cones[coneIndex].m_transf, 0);
-                  if (doAttributes)
-                     iceObjects.m_cones[coneIndex].DeclareAttributes(&iceAttributes, in_frame, pointIndex);
-                  coneIndex++;
+                  {
+                     if (iceObjects.m_batchShapes)
+                        unitShapeNode = iceObjects.m_cones[0].GetNode();
+                     else
+                        shapeObject = &iceObjects.m_cones[coneIndex++];
+                  }
+
+                  if (iceObjects.m_batchShapes)
+                  {
+                     // if batched, the matrices are computed into a scratch shape, and given to an instance of the unit shape
+                     if (batchedShapeIndex == (int)batchedShapes.size())
+                     {
+                        batchedShapes.push_back(CIceObjectBaseShape());
+                        batchedShapes.back().AllocMatrixArray(nbTransfKeys);
+                     }
+                     shapeObject = &batchedShapes[batchedShapeIndex++];
+                  }
+                  else if (doAttributes) // export the attributes
+                     shapeObject->DeclareAttributes(&iceAttributes, in_frame, pointIndex);
+
+                  pointTasks.push_back(CIcePointTransformTask(shapeType, shapeObject, unitShapeNode, 0, pointIndex, 
+                                                              pos, scale, ori, vel, angVel, size));
                }
                break;
 
@@ -758,10 +873,19 @@ CStatus LoadSinglePointCloud(const X3DObject &in_xsiObj, double in_frame,
                   // add all the shapes (so, the ginstances) for this point
                   objInstance->AddShapes(keyTransformAtFrame, shapeFrame, iceAttributes.HasShapeTime(), shapeHierarchyMap, 
                                          in_selectedObjs, in_selectionOnly, &iceObjects, instanceIndex, out_postLoadedNodesToHide);
+                  // move the members that can be instanced into the instancer
+                  if (iceObjects.m_instancer.size() > 0)
+                     iceObjects.m_instancer[0].AddInstances(objInstance, &iceAttributes, pointIndex, doAttributes);
                   // now we have the members (ginstances), and we can push the attributes
                   if (doAttributes)
                      for (int i=0; i<(int)objInstance->m_members.size(); i++)
-                        objInstance->m_members[i].DeclareAttributes(&iceAttributes, in_frame, pointIndex);
+                     {
+                        CIceObjectBaseShape *member = &objInstance->m_members[i];
+                        // the instancer has its own per instance attributes
+                        if (iceObjects.m_instancer.size() > 0 && iceObjects.m_instancer[0].IsInstanceable(*member))
+                           continue;
+                        member->DeclareAttributes(&iceAttributes, in_frame, pointIndex);
+                     }
 
                   instanceIndex++;
                }
@@ -856,6 +980,23 @@ CStatus LoadSinglePointCloud(const X3DObject &in_xsiObj, double in_frame,
                break;
          }
       } // end of the current chunk
+
+      // place the sphere, point and rectangle points, and compute the matrices of the disc, box, cylinder and cone points of this chunk
+      CIcePointTransformBody pointTransformBody(pointTasks, iceObjects, keyTransformAtTimeZero, secondsPerFrame, doExactTransformMb, 
+                                                mbPos, mbScale, mbSize, mbOri);
+      CWorkerPool::ParallelFor((unsigned int)pointTasks.size(), pointTransformBody, 256);
+      // give the batched shapes to the instancer, in the points order
+      if (iceObjects.m_batchShapes)
+      {
+         for (size_t i=0; i<pointTasks.size(); i++)
+         {
+            if (pointTasks[i].m_shape) // skip the sphere, point and rectangle points
+               iceObjects.m_instancer[0].AddShapeInstance(pointTasks[i].m_unitShapeNode, pointTasks[i].m_shape->m_matrix, 
+                                                          &iceAttributes, pointTasks[i].m_pointIndex, doAttributes);
+         }
+      }
+      pointTasks.clear();
+      batchedShapeIndex = 0;
    } // end of the chunks loop
 
    // do the light association only once (#1721) if the pointcloud originated clones of lights
@@ -916,7 +1057,7 @@ CStatus LoadSinglePointCloud(const X3DObject &in_xsiObj, double in_frame,
    // set the matrices for the multi-point node
    for (int iKey=0; iKey<nbTransfKeys; iKey++)
    {
-      CTransformation transform = in_xsiObj.GetKinematics().GetGlobal().GetTransform(keyTransformAtFrame[iKey]);
+      CTransformation transform = GetRenderInstance()->TransformCache().GetGlobalTransform(in_xsiObj, keyTransformAtFrame[iKey]);
       // CVector3 s = transform.GetScaling();
       // GetMessageQueue()->LogMessage(L"Scale = " + (CString)s.GetX() + L" " + (CString)s.GetY() + L" " + (CString)s.GetZ());
       if (iceObjects.m_pointsSphere.size() > 0)
@@ -927,8 +1068,13 @@ CStatus LoadSinglePointCloud(const X3DObject &in_xsiObj, double in_frame,
         iceObjects.m_rectangles[0].SetMatrix(transform, iKey);
       if (iceObjects.m_strands.size() > 0)
         iceObjects.m_strands[0].SetMatrix(transform, iKey);
+      if (iceObjects.m_instancer.size() > 0)
+        iceObjects.m_instancer[0].SetMatrix(transform, iKey);
    }
 
+   // drop the instance members replaced by the instancer
+   iceObjects.RemoveInstancerMembers();
+
    // Finally, we still have to multiply all the matrices of the non-multipoint objects
    // by the pointcloud matrices.
    // Create a matrix array to store the transforms of the pointcloud
@@ -936,7 +1082,7 @@ CStatus LoadSinglePointCloud(const X3DObject &in_xsiObj, double in_frame,
    AtArray* pointCloudMatrices = AiArrayAllocate(1, (uint8_t)nbTransfKeys, AI_TYPE_MATRIX);
    for (int iKey=0; iKey<nbTransfKeys; iKey++)
    {
-      CUtilities().S2A(in_xsiObj.GetKinematics().GetGlobal().GetTransform(keyTransformAtFrame[iKey]), matrix);
+      GetRenderInstance()->TransformCache().GetGlobalMatrix(in_xsiObj, keyTransformAtFrame[iKey], matrix);
       AiArraySetMtx(pointCloudMatrices, iKey, matrix);
    }
    // Go transform
@@ -1110,7 +1256,7 @@ CStatus LoadVolumePointCloud(const X3DObject &in_xsiObj, double in_frame)
 
    for (int iKey=0; iKey<nbTransfKeys; iKey++)
    {
-      CTransformation transform = in_xsiObj.GetKinematics().GetGlobal().GetTransform(keyTransformAtFrame[iKey]);
+      CTransformation transform = GetRenderInstance()->TransformCache().GetGlobalTransform(in_xsiObj, keyTransformAtFrame[iKey]);
       if (iceObjects.m_pointsSphere.size() > 0)
          iceObjects.m_pointsSphere[0].SetMatrix(transform, iKey);
    }
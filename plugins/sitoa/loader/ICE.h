@@ -73,6 +73,7 @@ private:
 // forward declaration
 class CIceAttribute;
 class CIceObjects;
+class CIceObjectInstancer;
 
 // Type of attributes to set
 enum eDeclICEAttr
@@ -93,6 +94,48 @@ const LONG ICE_CHUNK_SIZE = 100000;
 #endif 
 
 
+// A typed view of the data of a 1D CIceAttribute, as pulled by the last Update of the attribute.
+// The elements are read straight from the memory of the Softimage data array, so the loaders can
+// iterate it, or copy it into Arnold arrays in one go, instead of going through the per index getters.
+// The stride of a constant attribute is 0, so all the indices return the first (and only) element.
+class CIceAttributeView
+{
+public:
+   const uint8_t    *m_data;        // the first element, NULL if the view is empty
+   size_t            m_elementSize; // the size of one element, 0 if the attribute can't be viewed (bool, string, array)
+   size_t            m_stride;      // the bytes between two consecutive elements
+   LONG              m_count;       // the number of elements
+   siICENodeDataType m_eType;
+
+   CIceAttributeView() :
+      m_data(NULL), m_elementSize(0), m_stride(0), m_count(0), m_eType(siICENodeDataAny)
+   {}
+
+   CIceAttributeView(const void *in_data, size_t in_elementSize, LONG in_count, bool in_isConstant, siICENodeDataType in_eType) :
+      m_data((const uint8_t*)in_data), m_elementSize(in_elementSize), m_stride(in_isConstant ? 0 : in_elementSize),
+      m_count(in_count), m_eType(in_eType)
+   {}
+
+   // Return true if the view can be read
+   bool IsValid() const
+   {
+      return m_elementSize > 0;
+   }
+
+   // Return the in_index-th element. T must match m_eType (CVector3f for siICENodeDataVector3, etc.)
+   template <typename T>
+   const T& Get(LONG in_index) const
+   {
+      return *(const T*)(m_data + (size_t)in_index * m_stride);
+   }
+
+   // Return the Arnold type the data can be converted to, or AI_TYPE_NONE
+   uint8_t GetArnoldType() const;
+   // Allocate an Arnold array of the matching type, and fill it with all the elements
+   AtArray* ToArray() const;
+};
+
+
 // small extension of the base ICEAttribute
 class CIceAttribute : public ICEAttribute
 {
@@ -172,6 +215,8 @@ public:
    CColor4f     GetColor4f(LONG in_index);
    CRotationf   GetRotationf(LONG in_index);
    CShape       GetShape(LONG in_index);
+   // Get a view of the data pulled by the last Update, for the non array attributes
+   CIceAttributeView GetView();
 
    // Get the attributes for the in_Count points, starting from in_Offset
    bool Update(LONG in_Offset, LONG in_Count);
@@ -215,6 +260,13 @@ private:
    CIceAttribute *m_strandVelocity;
    CIceAttribute *m_strandSize;
    CIceAttribute *m_strandOrientation;
+   // views of the most used attributes, refreshed by UpdateChunk
+   CIceAttributeView m_pointPositionView;
+   CIceAttributeView m_orientationView;
+   CIceAttributeView m_scaleView;
+   CIceAttributeView m_sizeView;
+   CIceAttributeView m_colorView;
+   CIceAttributeView m_pointVelocityView;
 
 public:
    // plain set of required attributes
@@ -611,22 +663,24 @@ class CIceObjectBaseShape : public CIceObjectBase
 {
 public:
    CTransformation m_transf; // the point transformation (not yet the node matrix)
+   AtNode*  m_instancedNode;  // for ginstances, the node to be instanced. Set also if the ginstance node is not created
 
    CIceObjectBaseShape() : CIceObjectBase()
    {
       m_transf.SetIdentity();
+      m_instancedNode = NULL;
    }
 
    ~CIceObjectBaseShape() {}
 
    CIceObjectBaseShape(const CIceObjectBaseShape &in_arg)
-   : CIceObjectBase(in_arg), m_transf(in_arg.m_transf)
+   : CIceObjectBase(in_arg), m_transf(in_arg.m_transf), m_instancedNode(in_arg.m_instancedNode)
    {}
 
    // Stuff all of the three components into a regular XSI transform
    void SetTransf(const CVector3f in_pos, const CVector3f in_scale, const CRotation in_rot);
    // Compute the motion blur matrices.
-   void ComputeMotionBlur(CDoubleArray in_keysTime, float in_secondsPerFrame, CVector3f in_velocity, CRotation in_angVel,
+   void ComputeMotionBlur(const CDoubleArray &in_keysTime, float in_secondsPerFrame, CVector3f in_velocity, CRotation in_angVel,
                           bool in_exactMb, const vector <CVector3f> &in_mbPos, const vector <CVector3f> &in_mbScale, 
                           const vector <CRotation> &in_mbOri, const int in_pointIndex);
    // Attach all the required attributes to this node
@@ -877,7 +931,8 @@ public:
    // Find the objects to be ginstanced on the point and push them into the members vector
    bool LoadInstance(Model in_modelMaster, X3DObject in_objMaster, CRefArray in_shapeArray, CDoubleArray in_keyFramesTransform, 
                      double in_frame, bool in_hasShapeTime, ShapeHierarchyModeMap &in_shapeHierarchyMap, 
-                     CRefArray &in_selectedObjs, bool in_selectionOnly, vector <AtNode*> &out_postLoadedNodes);
+                     CRefArray &in_selectedObjs, bool in_selectionOnly, vector <AtNode*> &out_postLoadedNodes,
+                     CIceObjectInstancer *in_instancer);
 
    CIceObjectBaseShape LoadProcedural(X3DObject &in_xsiObj, double in_frame, CString in_proceduralPath);
 };
@@ -923,6 +978,70 @@ public:
 };
 
 
+///////////////////////////////////////////////////////////////////////
+// Instancer class. A single instancer node replacing the ginstances of all the instanced points,
+// and the nodes of the disc, box, cylinder and cone points. Derives from CIceObjectBase
+///////////////////////////////////////////////////////////////////////
+
+// An ICE attribute stored for each instance, until the instancer node is built
+class CInstancerAttribute
+{
+public:
+   CIceAttribute   *m_attr;
+   uint8_t          m_type;        // the Arnold type
+   const char*      m_declaration; // the user data declaration on the instancer
+   vector <uint8_t> m_data;        // the raw values, one per instance
+
+   CInstancerAttribute(CIceAttribute *in_attr, uint8_t in_type, const char* in_declaration) : 
+      m_attr(in_attr), m_type(in_type), m_declaration(in_declaration)
+   {}
+
+   // Append the value of the attribute at the given index
+   void PushValue(LONG in_index);
+};
+
+
+class CIceObjectInstancer : public CIceObjectBase
+{
+private:
+   int                         m_nbTransfKeys;
+   vector <AtNode*>            m_nodes;              // the instanced nodes
+   map <AtNode*, unsigned int> m_nodesMap;           // the index of each instanced node into m_nodes
+   vector <unsigned int>       m_nodeIdxs;           // per instance, the index of its node into m_nodes
+   vector <AtMatrix>           m_instanceMatrix;     // per instance, the matrices at all the mb keys
+   vector <uint8_t>            m_instanceVisibility;
+   vector <bool>               m_instanceIsShape;    // per instance, true if it's a unit shape (disc, box, etc.)
+   vector <CInstancerAttribute> m_attributes;        // the attributes to be exported as instance_* user data
+   bool                        m_attributesCollected;
+
+   // Collect the attributes that can be exported per instance
+   void CollectAttributes(CIceAttributesSet *in_attributes);
+   // Add an instance
+   void AddInstance(AtNode* in_node, AtArray* in_matrix, uint8_t in_visibility, bool in_isShape, int in_pointIndex);
+
+public:
+   CIceObjectInstancer() : CIceObjectBase(), m_nbTransfKeys(1), m_attributesCollected(false)
+   {}
+
+   // Create the node
+   bool CreateNode(int in_id, const char* in_name, int in_nbTransfKeys);
+   // Return true if a member of an instance can be replaced by an instance of the instancer
+   bool IsInstanceable(const CIceObjectBaseShape &in_member) const;
+   // Add the instanceable members of a point's instance
+   void AddInstances(CIceObjectInstance *in_instance, CIceAttributesSet *in_attributes, int in_pointIndex, bool in_doAttributes);
+   // Add the instance of a unit shape (disc, box, cylinder, cone) for a point
+   void AddShapeInstance(AtNode* in_node, AtArray* in_matrix, CIceAttributesSet *in_attributes, int in_pointIndex, bool in_doAttributes);
+   // Return the number of instances
+   size_t GetNbInstances() const;
+   // Set the visibility of the instances
+   void SetInstancesVisibility(uint8_t in_viz, bool in_shapesOnly);
+   // Give the node the instances arrays
+   bool SetNodeData();
+   // Set the Arnold Parameters set 
+   void SetArnoldParameters(CustomProperty in_property, double in_frame);
+};
+
+
 ///////////////////////////////////////////////////////////////////////
 // CIceObjects class, the home of all the objects built for the ice tree
 ///////////////////////////////////////////////////////////////////////
@@ -985,18 +1104,26 @@ public:
    int    m_nbStrandInstances; // number of instanced strands
    vector <CIceObjectStrandInstance> m_strandInstances;
 
+   // the instancer node, if the instances are not exported as ginstances. Use a vector, although it should be a single element
+   vector <CIceObjectInstancer> m_instancer;
+   // true if the discs, boxes, cylinders and cones are instances of a single unit shape per type, so the
+   // m_discs, etc. vectors hold just the (hidden) unit shapes
+   bool   m_batchShapes;
+
    CIceObjects() 
    {
       m_pointsSphereNbPoints = m_pointsDiskNbPoints = m_nbRectangles =
       m_nbDiscs = m_nbBoxes = m_nbCylinders = m_nbCones = m_nbStrands = 
       m_nbInstances = m_nbStrandInstances = 0;
+      m_batchShapes = false;
    }
 
    CIceObjects(const CIceObjects &in_arg) : 
    	m_pointsSphereNbPoints(in_arg.m_pointsSphereNbPoints), m_pointsDiskNbPoints(in_arg.m_pointsDiskNbPoints),
       m_nbRectangles(in_arg.m_nbRectangles), m_nbDiscs(in_arg.m_nbDiscs), m_nbBoxes(in_arg.m_nbBoxes),
       m_nbCylinders(in_arg.m_nbCylinders), m_nbCones(in_arg.m_nbCones), m_nbStrands(in_arg.m_nbStrands),
-      m_nbInstances(in_arg.m_nbInstances), m_nbStrandInstances(in_arg.m_nbStrandInstances)
+      m_nbInstances(in_arg.m_nbInstances), m_nbStrandInstances(in_arg.m_nbStrandInstances),
+      m_batchShapes(in_arg.m_batchShapes)
    {
       // copy the vectors
       m_pointsSphere      = in_arg.m_pointsSphere;
@@ -1009,6 +1136,7 @@ public:
       m_strands           = in_arg.m_strands;
       m_instances         = in_arg.m_instances;
       m_strandInstances   = in_arg.m_strandInstances;
+      m_instancer         = in_arg.m_instancer;
       m_instanceMap       = in_arg.m_instanceMap;
       m_uncachebleIds     = in_arg.m_uncachebleIds;
       m_strandInstanceMap = in_arg.m_strandInstanceMap;
@@ -1026,6 +1154,7 @@ public:
       m_strands.clear();
       m_instances.clear();
       m_strandInstances.clear();
+      m_instancer.clear();
       m_instanceMap.clear();
       m_uncachebleIds.clear();
       m_strandInstanceMap.clear();
@@ -1057,6 +1186,8 @@ public:
    void SetLightGroup(AtArray* in_lightGroup);
    // return true if at least one of the instanced objects is a light
    bool HasAtLeastOneInstancedLight();
+   // Remove the members of the instances that were moved into the instancer, and destroy their ginstances
+   void RemoveInstancerMembers();
    // Log the number of objects for each type
    void Log();
 };
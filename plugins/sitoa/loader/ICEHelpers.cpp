@@ -596,6 +596,134 @@ CShape CIceAttribute::GetShape(LONG in_index)
    return m_sData[in_index];
 }
 
+
+// Build the view of a data array
+//
+// @param in_dataArray   The data array
+// @param in_isConstant  True if the attribute is constant
+// @param in_eType       The attribute data type
+// @return the view
+//
+template <typename T>
+static CIceAttributeView GetDataArrayView(CICEAttributeDataArray<T> &in_dataArray, bool in_isConstant, siICENodeDataType in_eType)
+{
+   LONG count = (LONG)in_dataArray.GetCount();
+   // the [] operator is called only once, to get the address of the first element
+   return CIceAttributeView(count > 0 ? &in_dataArray[0] : NULL, sizeof(T), count, in_isConstant, in_eType);
+}
+
+
+// Get a view of the data pulled by the last Update.
+// Bool arrays are a bitset, and strings are not stored by value, so they can't be viewed,
+// as well as the array (2D) attributes.
+//
+// @return the view, invalid if the attribute type is not supported
+//
+CIceAttributeView CIceAttribute::GetView()
+{
+   if (!m_isDefined || m_isArray)
+      return CIceAttributeView();
+
+   switch (m_eType)
+   {
+      case siICENodeDataFloat:
+         return GetDataArrayView(m_fData, m_isConstant, m_eType);
+      case siICENodeDataLong:
+         return GetDataArrayView(m_lData, m_isConstant, m_eType);
+      case siICENodeDataVector2:
+         return GetDataArrayView(m_v2Data, m_isConstant, m_eType);
+      case siICENodeDataVector3:
+         return GetDataArrayView(m_v3Data, m_isConstant, m_eType);
+      case siICENodeDataVector4:
+         return GetDataArrayView(m_v4Data, m_isConstant, m_eType);
+      case siICENodeDataColor4:
+         return GetDataArrayView(m_cData, m_isConstant, m_eType);
+      case siICENodeDataQuaternion:
+         return GetDataArrayView(m_qData, m_isConstant, m_eType);
+      case siICENodeDataMatrix33:
+         return GetDataArrayView(m_m3Data, m_isConstant, m_eType);
+      case siICENodeDataMatrix44:
+         return GetDataArrayView(m_m4Data, m_isConstant, m_eType);
+      case siICENodeDataRotation:
+         return GetDataArrayView(m_rData, m_isConstant, m_eType);
+      case siICENodeDataShape:
+         return GetDataArrayView(m_sData, m_isConstant, m_eType);
+      default:
+         return CIceAttributeView();
+   }
+}
+
+
+///////////////////////////////////////////////////////////////////////
+// CIceAttributeView class
+///////////////////////////////////////////////////////////////////////
+
+// the float based types are copied as they are into the Arnold arrays
+static_assert(sizeof(CVector3f) == sizeof(AtVector), "CVector3f and AtVector must share the same layout");
+static_assert(sizeof(CColor4f) == sizeof(AtRGBA), "CColor4f and AtRGBA must share the same layout");
+
+// Return the Arnold type the data can be converted to
+//
+// @return the Arnold type, or AI_TYPE_NONE if the view can't be converted
+//
+uint8_t CIceAttributeView::GetArnoldType() const
+{
+   if (!IsValid())
+      return AI_TYPE_NONE;
+
+   switch (m_eType)
+   {
+      case siICENodeDataFloat:
+         return AI_TYPE_FLOAT;
+      case siICENodeDataLong:
+         return AI_TYPE_INT;
+      case siICENodeDataVector3:
+         return AI_TYPE_VECTOR;
+      case siICENodeDataColor4:
+         return AI_TYPE_RGBA;
+      default:
+         return AI_TYPE_NONE;
+   }
+}
+
+
+// Allocate an Arnold array of the matching type, and fill it with all the elements
+//
+// @return the array, or NULL if the type can't be converted
+//
+AtArray* CIceAttributeView::ToArray() const
+{
+   uint8_t type = GetArnoldType();
+   if (type == AI_TYPE_NONE)
+      return NULL;
+   if (m_count == 0 || !m_data)
+      return AiArrayAllocate(0, 1, type);
+
+   AtArray* result;
+   if (type == AI_TYPE_INT) // LONG is not an int on all the platforms, so go through the conversion
+   {
+      if (m_stride > 0)
+         return CBulkCopy::ToArray((const LONG*)m_data, (uint32_t)m_count, (size_t)m_count, type);
+
+      result = AiArrayAllocate((uint32_t)m_count, 1, type);
+      int value = (int)Get<LONG>(0);
+      for (LONG i = 0; i < m_count; i++)
+         AiArraySetInt(result, i, value);
+      return result;
+   }
+
+   if (m_stride > 0)
+      return AiArrayConvert((uint32_t)m_count, 1, type, m_data);
+
+   // constant attribute, replicate the only element
+   result = AiArrayAllocate((uint32_t)m_count, 1, type);
+   uint8_t* data = (uint8_t*)AiArrayMap(result);
+   for (LONG i = 0; i < m_count; i++, data+= m_elementSize)
+      memcpy(data, m_data, m_elementSize);
+   AiArrayUnmap(result);
+   return result;
+}
+
 ///////////////////////////////////////////////////////////////////////
 // CIceAttributesSet class
 ///////////////////////////////////////////////////////////////////////
@@ -1009,6 +1137,20 @@ void CIceAttributesSet::ConnectAttributeHandlers()
 }
 
 
+// Get the view of an attribute handler, if the attribute is defined and of the expected type
+//
+// @param in_attr   The attribute
+// @param in_eType  The expected data type
+// @return the view, invalid if the attribute can't be read as in_eType
+//
+static CIceAttributeView GetHandlerView(CIceAttribute *in_attr, siICENodeDataType in_eType)
+{
+   if (in_attr && in_attr->m_isDefined && in_attr->m_eType == in_eType)
+      return in_attr->GetView();
+   return CIceAttributeView();
+}
+
+
 // Read all the attribute
 //
 // @param in_pointOffset The chunk offset
@@ -1044,6 +1186,14 @@ void CIceAttributesSet::UpdateChunk(const LONG in_pointOffset, const LONG in_nbP
    if (m_strandOrientation)
       m_strandOrientation->Update(in_pointOffset, in_nbPoints);
 
+   // refresh the views read by the getters
+   m_pointPositionView = GetHandlerView(m_pointPosition, siICENodeDataVector3);
+   m_orientationView   = GetHandlerView(m_orientation,   siICENodeDataRotation);
+   m_scaleView         = GetHandlerView(m_scale,         siICENodeDataVector3);
+   m_sizeView          = GetHandlerView(m_size,          siICENodeDataFloat);
+   m_colorView         = GetHandlerView(m_color,         siICENodeDataColor4);
+   m_pointVelocityView = GetHandlerView(m_pointVelocity, siICENodeDataVector3);
+
    // update the required attributes
    AttrMap::iterator attribIt;
    for (attribIt = m_requiredAttributesMap.begin(); attribIt != m_requiredAttributesMap.end(); attribIt++)
@@ -1142,6 +1292,8 @@ bool CIceAttributesSet::HasShapeTime()
 //
 CVector3f CIceAttributesSet::GetPointPosition(LONG in_pointIndex)
 {
+   if (m_pointPositionView.IsValid())
+      return m_pointPositionView.Get<CVector3f>(in_pointIndex);
    if (HasPointPosition())
       return m_pointPosition->m_isConstant ? m_pointPosition->GetVector3f(0) : m_pointPosition->GetVector3f(in_pointIndex);
    return CVector3f(0.0f, 0.0f, 0.0f);
@@ -1156,7 +1308,9 @@ CVector3f CIceAttributesSet::GetPointPosition(LONG in_pointIndex)
 CRotationf CIceAttributesSet::GetOrientationf(LONG in_pointIndex)
 {
    CRotationf result;
-   if (HasOrientation())
+   if (m_orientationView.IsValid())
+      result = m_orientationView.Get<CRotationf>(in_pointIndex);
+   else if (HasOrientation())
       result = m_orientation->m_isConstant ? m_orientation->GetRotationf(0) : m_orientation->GetRotationf(in_pointIndex);
    else
       result.SetIdentity();
@@ -1192,6 +1346,8 @@ CRotation CIceAttributesSet::GetOrientation(LONG in_pointIndex)
 //
 CVector3f CIceAttributesSet::GetScale(LONG in_pointIndex)
 {
+   if (m_scaleView.IsValid())
+      return m_scaleView.Get<CVector3f>(in_pointIndex);
    if (HasScale())
       return m_scale->m_isConstant ? m_scale->GetVector3f(0) : m_scale->GetVector3f(in_pointIndex);
    return CVector3f(1.0f, 1.0f, 1.0f);
@@ -1206,6 +1362,8 @@ CVector3f CIceAttributesSet::GetScale(LONG in_pointIndex)
 //
 float CIceAttributesSet::GetSize(LONG in_pointIndex, float in_default)
 {
+   if (m_sizeView.IsValid())
+      return m_sizeView.Get<float>(in_pointIndex);
    if (HasSize())
       return m_size->m_isConstant ? m_size->GetFloat(0) : m_size->GetFloat(in_pointIndex);
    return in_default;
@@ -1232,6 +1390,8 @@ CShape CIceAttributesSet::GetShape(LONG in_pointIndex)
 //
 CColor4f CIceAttributesSet::GetColor(LONG in_pointIndex)
 {
+   if (m_colorView.IsValid())
+      return m_colorView.Get<CColor4f>(in_pointIndex);
    if (HasColor())
       return m_color->m_isConstant ? m_color->GetColor4f(0) : m_color->GetColor4f(in_pointIndex);
    return CColor4f(0.0f, 0.0f, 0.0f, 0.0f);
@@ -1245,6 +1405,8 @@ CColor4f CIceAttributesSet::GetColor(LONG in_pointIndex)
 //
 CVector3f CIceAttributesSet::GetPointVelocity(LONG in_pointIndex)
 {
+   if (m_pointVelocityView.IsValid())
+      return m_pointVelocityView.Get<CVector3f>(in_pointIndex);
    if (HasPointVelocity())
       return m_pointVelocity->m_isConstant ? m_pointVelocity->GetVector3f(0) : m_pointVelocity->GetVector3f(in_pointIndex);
    return CVector3f(0.0f, 0.0f, 0.0f);
@@ -2666,51 +2828,12 @@ void CIceObjectBase::DeclareICEAttributeOnMeshNode(CIceAttribute *in_attr, const
             break;
 
          case siICENodeDataLong:
-            if (AiNodeDeclare(m_node, in_attr->m_name.GetAsciiString(), declaration.c_str()))
-            {
-               count = in_attr->m_lData.GetCount();
-               dataArray = AiArrayAllocate(count, 1, AI_TYPE_INT);
-               for (ULONG i = 0; i < count; i++)
-                  AiArraySetInt(dataArray, i, in_attr->GetInt(i));
-            }
-            break;
-
          case siICENodeDataFloat:
-            if (AiNodeDeclare(m_node, in_attr->m_name.GetAsciiString(), declaration.c_str()))
-            {
-               count = in_attr->m_fData.GetCount();
-               dataArray = AiArrayAllocate(count, 1, AI_TYPE_FLOAT);
-               for (ULONG i = 0; i < count; i++)
-                  AiArraySetFlt(dataArray, i, in_attr->GetFloat(i));
-            }
-            break;
-
          case siICENodeDataVector3:
-            if (AiNodeDeclare(m_node, in_attr->m_name.GetAsciiString(), declaration.c_str()))
-            {
-               count = in_attr->m_v3Data.GetCount();
-               dataArray = AiArrayAllocate(count, 1, AI_TYPE_VECTOR);
-               AtVector vec;
-               for (ULONG i = 0; i < count; i++)
-               {
-                  CUtilities().S2A(in_attr->GetVector3f(i), vec);
-                  AiArraySetVec(dataArray, i, vec);
-               }
-            }
-            break;
-
          case siICENodeDataColor4:
+            // copy the whole data array in one go
             if (AiNodeDeclare(m_node, in_attr->m_name.GetAsciiString(), declaration.c_str()))
-            {
-               count = in_attr->m_cData.GetCount();
-               dataArray = AiArrayAllocate(count, 1, AI_TYPE_RGBA);
-               AtRGBA rgba;
-               for (ULONG i = 0; i < count; i++)
-               {
-                  CUtilities().S2A(in_attr->GetColor4f(i), rgba);
-                  AiArraySetRGBA(dataArray, i, rgba);
-               }
-            }
+               dataArray = in_attr->GetView().ToArray();
             break;
 
          case siICENodeDataMatrix44:
@@ -3589,7 +3712,7 @@ void CIceObjectBaseShape::SetTransf(const CVector3f in_pos, const CVector3f in_s
 // @param in_mbOri            Array of orientations at each mb key for exact mb
 // @param in_pointIndex       The particle index
 //
-void CIceObjectBaseShape::ComputeMotionBlur(CDoubleArray in_keysTime, float in_secondsPerFrame, CVector3f in_velocity, CRotation in_angVel,
+void CIceObjectBaseShape::ComputeMotionBlur(const CDoubleArray &in_keysTime, float in_secondsPerFrame, CVector3f in_velocity, CRotation in_angVel,
                                             bool in_exactMb, const vector <CVector3f> &in_mbPos, const vector <CVector3f> &in_mbScale, 
                                             const vector <CRotation> &in_mbOri, const int in_pointIndex)
 {
@@ -4169,6 +4292,9 @@ bool CIceObjectInstance::AddShapes(CDoubleArray in_keyFramesTransform, double in
       m_transf       = masterInstance->m_transf;
       m_type         = masterInstance->m_type;
       m_visibility   = masterInstance->m_visibility;
+
+      // if the instances are exported by an instancer, we don't need the ginstances that will go into the instancer
+      CIceObjectInstancer *instancer = in_iceObjects->m_instancer.size() > 0 ? &in_iceObjects->m_instancer[0] : NULL;
       
       // yet we must overwrite some stuff, so we cycle the members
       AtMatrix pointMatrix, masterPointMatrix, invMasterPointMatrix, masterShapeMatrix, pointToPointMatrix, resultMatrix;
@@ -4193,11 +4319,15 @@ bool CIceObjectInstance::AddShapes(CDoubleArray in_keyFramesTransform, double in
          sprintf(instanceName, "%s%s", name.c_str(), firstSpace);
          member->m_name = AtString(instanceName);
 
-         // Create the ginstance node
-         member->CreateNode();
-         AtNode* gNode = member->GetNode();
-         // set the "node" to the same "node" of the masterInstance
-         CNodeSetter::SetPointer(gNode, "node", (AtNode*)AiNodeGetPtr(masterShape->GetNode(), "node"));
+         // Create the ginstance node, unless the instancer will take care of it. In such case, the member
+         // keeps just the instanced node, copied from the master one
+         if (!(instancer && instancer->IsInstanceable(*member)))
+         {
+            member->CreateNode();
+            AtNode* gNode = member->GetNode();
+            // set the "node" to the same "node" of the masterInstance
+            CNodeSetter::SetPointer(gNode, "node", masterShape->m_instancedNode);
+         }
 
          int nbTransfKeys = AiArrayGetNumKeys(masterShape->m_matrix) < in_keyFramesTransform.GetCount() ? 
                             AiArrayGetNumKeys(masterShape->m_matrix) : in_keyFramesTransform.GetCount();
@@ -4268,7 +4398,8 @@ bool CIceObjectInstance::AddShapes(CDoubleArray in_keyFramesTransform, double in
       shapeArray.Add(obj.GetRef());
    // else, if model is a model, shapeArray stays void. It will be filled by LoadInstance
 
-   LoadInstance(model, obj, shapeArray, in_keyFramesTransform, in_frame, in_hasShapeTime, in_shapeHierarchyMap, in_selectedObjs, in_selectionOnly, out_postLoadedNodes);
+   LoadInstance(model, obj, shapeArray, in_keyFramesTransform, in_frame, in_hasShapeTime, in_shapeHierarchyMap, in_selectedObjs, in_selectionOnly, out_postLoadedNodes,
+                in_iceObjects->m_instancer.size() > 0 ? &in_iceObjects->m_instancer[0] : NULL);
 
    return true;
 }
@@ -4286,13 +4417,15 @@ bool CIceObjectInstance::AddShapes(CDoubleArray in_keyFramesTransform, double in
 // @param in_selectedObjs        Used in case of a PostLoadSingleObject
 // @param in_selectionOnly       Used in case of a PostLoadSingleObject
 // @param out_postLoadedNodes    Returned vector of nodes that must be later hidden
+// @param in_instancer           The instancer, if any. The ginstances it can take are not created
 //
 // @return true
 //
 bool CIceObjectInstance::LoadInstance(Model in_modelMaster, X3DObject in_objMaster, CRefArray in_shapeArray, 
                                       CDoubleArray in_keyFramesTransform, double in_frame, 
                                       bool in_hasShapeTime, ShapeHierarchyModeMap &in_shapeHierarchyMap, 
-                                      CRefArray &in_selectedObjs, bool in_selectionOnly, vector <AtNode*> &out_postLoadedNodes)
+                                      CRefArray &in_selectedObjs, bool in_selectionOnly, vector <AtNode*> &out_postLoadedNodes,
+                                      CIceObjectInstancer *in_instancer)
 {
    bool isHierarchy(false);
    Property visProperty;
@@ -4473,7 +4606,7 @@ bool CIceObjectInstance::LoadInstance(Model in_modelMaster, X3DObject in_objMast
             if (in_modelMaster.IsValid() || isGroup || isHierarchy)
             {
                // get the matrix of the master model or object
-               CUtilities().S2A(in_objMaster.GetKinematics().GetGlobal().GetTransform(in_keyFramesTransform[ikey]), matrixModel);
+               GetRenderInstance()->TransformCache().GetGlobalMatrix(in_objMaster, in_keyFramesTransform[ikey], matrixModel);
                // invert it
                matrixModelInv = AiM4Invert(matrixModel);
                // matrix of the master node
@@ -4542,35 +4675,38 @@ bool CIceObjectInstance::LoadInstance(Model in_modelMaster, X3DObject in_objMast
             int id = masterData->m_id;
 
             shape.SetNodeBaseAttributes(id, "ginstance", gName.GetAsciiString());
-            // create the ginstance node
-            if (shape.CreateNode())
+            // either copy the master node over or create a new instance
+            if (masterIsGInstance)
             {
-               AtNode* gNode = shape.GetNode();
-               // either copy the master node over or create a new instance
-               if (masterIsGInstance)
-               {
-                  CNodeSetter::SetPointer(gNode, "node", (AtNode*)AiNodeGetPtr(masterNode, "node"));
-                  // Override the id (trac#437). For coherence, power instances inherit the id of the base object.
-                  // If we comment this line, the ginstances that inherited the members from other
-                  // ginstances get the instanced model id, instead of the instanced polymesh id
-                  shape.m_id = AiNodeGetInt(masterNode, "id");
-                  // copy the visibility
-                  shape.SetVisibility(visibilities[vizCounter++]);
-               }
+               shape.m_instancedNode = (AtNode*)AiNodeGetPtr(masterNode, "node");
+               // Override the id (trac#437). For coherence, power instances inherit the id of the base object.
+               // If we comment this line, the ginstances that inherited the members from other
+               // ginstances get the instanced model id, instead of the instanced polymesh id
+               shape.m_id = AiNodeGetInt(masterNode, "id");
+               // copy the visibility
+               shape.SetVisibility(visibilities[vizCounter++]);
+            }
+            else
+            {
+               shape.m_instancedNode = masterNode;
+
+               if (masterData->m_hideMaster) // the master was hidden, but we are not. So we need to retrieve the object visibility
+                  shape.SetVisibility(masterData->m_visibility);
                else
-               {
-                  CNodeSetter::SetPointer(gNode, "node", masterNode);
+                  shape.SetVisibility(visibilities[vizCounter++]);
+            }
 
-                  if (masterData->m_hideMaster) // the master was hidden, but we are not. So we need to retrieve the object visibility
-                     shape.SetVisibility(masterData->m_visibility);
-                  else
-                     shape.SetVisibility(visibilities[vizCounter++]);
-               }
+            // copy the sidedness
+            shape.SetSidedness(AiNodeGetByte(masterNode, "sidedness"));
+            // copy the matrices
+            shape.m_matrix = AiArrayCopy(matrices);
 
-               // copy the sidedness
-               shape.SetSidedness(AiNodeGetByte(masterNode, "sidedness"));
-               // copy the matrices
-               shape.m_matrix = AiArrayCopy(matrices);
+            // create the ginstance node, unless the instancer will take care of it
+            if (in_instancer && in_instancer->IsInstanceable(shape))
+               m_members.push_back(shape);
+            else if (shape.CreateNode())
+            {
+               CNodeSetter::SetPointer(shape.GetNode(), "node", shape.m_instancedNode);
                // push the shape into the members
                m_members.push_back(shape); 
             }
@@ -4841,10 +4977,9 @@ bool CIceObjectStrandInstance::LoadStrandInstance(Model in_modelMaster, CRefArra
 
       if (nbDefKeys == 1)
       {
-         // Bend the instanced objects along the strand
-         strandInstance->BendOnStrand(m_strand);
-         // Assign the bended points/normals to the iDefKey-th array of vlist and nlist
-         strandInstance->Get(vlist, nlist, 0);
+         // Bend the instanced objects along the strand, into vlist and nlist
+         vector <CStrandBendTask> bendTasks(1, CStrandBendTask(strandInstance, &m_strand, vlist, nlist, 0));
+         BendStrandInstances(bendTasks);
       }
       else // we have def mb, and so we must compute the actual position of the strand, before bending on it
       {
@@ -4872,10 +5007,9 @@ bool CIceObjectStrandInstance::LoadStrandInstance(Model in_modelMaster, CRefArra
             // recompute length and main axis of the motion displaced strand
             m_mbStrand.ComputeLength();
             m_mbStrand.ComputeBendedX(false, 0.0f);
-            // Bend the instanced objects along the motion displaced strand
-            strandInstance->BendOnStrand(m_mbStrand);
-            // Assign the bended points/normals to the iDefKey-th array of vlist and nlist
-            strandInstance->Get(vlist, nlist, iDefKey);
+            // Bend the instanced objects along the motion displaced strand, into the iDefKey-th key of vlist and nlist
+            vector <CStrandBendTask> bendTasks(1, CStrandBendTask(strandInstance, &m_mbStrand, vlist, nlist, iDefKey));
+            BendStrandInstances(bendTasks);
          }
       }
 
@@ -4899,6 +5033,317 @@ bool CIceObjectStrandInstance::LoadStrandInstance(Model in_modelMaster, CRefArra
 }
 
 
+///////////////////////////////////////////////////////////////////////
+// Instancer class. Derives from CIceObjectBase
+///////////////////////////////////////////////////////////////////////
+
+// Append the value of the attribute at the given index
+//
+// @param in_index   The index of the ice point
+//
+void CInstancerAttribute::PushValue(LONG in_index)
+{
+   LONG index = m_attr->m_isConstant ? 0 : in_index;
+   const uint8_t* value;
+   size_t size;
+
+   bool b;
+   int i;
+   float f;
+   AtVector v;
+   AtRGBA rgba;
+   AtMatrix m;
+
+   switch (m_type)
+   {
+      case AI_TYPE_BOOLEAN:
+         b = m_attr->GetBool(index);
+         value = (const uint8_t*)&b;
+         size = sizeof(bool);
+         break;
+      case AI_TYPE_INT:
+         i = m_attr->GetInt(index);
+         value = (const uint8_t*)&i;
+         size = sizeof(int);
+         break;
+      case AI_TYPE_FLOAT:
+         f = m_attr->GetFloat(index);
+         value = (const uint8_t*)&f;
+         size = sizeof(float);
+         break;
+      case AI_TYPE_VECTOR:
+         CUtilities().S2A(m_attr->GetVector3f(index), v);
+         value = (const uint8_t*)&v;
+         size = sizeof(AtVector);
+         break;
+      case AI_TYPE_RGBA:
+         CUtilities().S2A(m_attr->GetColor4f(index), rgba);
+         value = (const uint8_t*)&rgba;
+         size = sizeof(AtRGBA);
+         break;
+      case AI_TYPE_MATRIX:
+         CUtilities().S2A(m_attr->GetMatrix4f(index), m);
+         value = (const uint8_t*)&m;
+         size = sizeof(AtMatrix);
+         break;
+      default:
+         return;
+   }
+
+   m_data.insert(m_data.end(), value, value + size);
+}
+
+
+// Create the node
+// 
+// @param in_id                The input id
+// @param in_name              The input name
+// @param in_nbTransfKeys      The number of mb keys
+//
+bool CIceObjectInstancer::CreateNode(int in_id, const char* in_name, int in_nbTransfKeys)
+{
+   m_nbTransfKeys = in_nbTransfKeys;
+   SetNodeBaseAttributes(in_id, "instancer", in_name);
+   // the instancer matrices will be the pointcloud ones
+   AllocMatrixArray(in_nbTransfKeys);
+   return CIceObjectBase::CreateNode();
+}
+
+
+// Return true if a member of an instance can be replaced by an instance of the instancer.
+// Lights and procedurals are duplicated, so they keep being exported as their own nodes,
+// and so do the ginstances with less mb keys than the pointcloud.
+// The instancer shades each instance with the shader of the instanced node, so a member with its own
+// shader stays a ginstance.
+// The member is checked before its ginstance node gets created, so only its instanced node is required.
+//
+// @param in_member     The instance member
+//
+// @return true if the member can be instanced by the instancer
+//
+bool CIceObjectInstancer::IsInstanceable(const CIceObjectBaseShape &in_member) const
+{
+   if (!m_node || !in_member.m_instancedNode || !in_member.m_matrix)
+      return false;
+   if (in_member.m_isLight || in_member.m_isProcedural)
+      return false;
+   if (in_member.m_type != ATSTRING::ginstance || in_member.m_shader)
+      return false;
+
+   return AiArrayGetNumKeys(in_member.m_matrix) == m_nbTransfKeys;
+}
+
+
+// Collect the attributes that can be exported per instance, so the non array ones of types
+// supported by the instancer's user data. The "private" attributes are skipped, as in DeclareICEAttributeOnNode
+//
+// @param in_attributes     The ice attributes
+//
+void CIceObjectInstancer::CollectAttributes(CIceAttributesSet *in_attributes)
+{
+   m_attributesCollected = true;
+
+   AttrMap::iterator attribIt;
+   for (attribIt = in_attributes->m_requiredAttributesMap.begin(); attribIt != in_attributes->m_requiredAttributesMap.end(); attribIt++)
+   {
+      CIceAttribute *attr = attribIt->second;
+      if (attr == NULL || !attr->m_isDefined || attr->m_isArray)
+         continue;
+      if (attr->m_name.Length() > 1)
+         if (attr->m_name[0] == '_' && attr->m_name[1] == '_')
+            continue;
+
+      uint8_t type;
+      const char* declaration;
+      switch (attr->m_eType)
+      {
+         case siICENodeDataBool:
+            type = AI_TYPE_BOOLEAN;
+            declaration = "constant ARRAY BOOL";
+            break;
+         case siICENodeDataLong:
+            type = AI_TYPE_INT;
+            declaration = "constant ARRAY INT";
+            break;
+         case siICENodeDataFloat:
+            type = AI_TYPE_FLOAT;
+            declaration = "constant ARRAY FLOAT";
+            break;
+         case siICENodeDataVector3:
+            type = AI_TYPE_VECTOR;
+            declaration = "constant ARRAY VECTOR";
+            break;
+         case siICENodeDataColor4:
+            type = AI_TYPE_RGBA;
+            declaration = "constant ARRAY RGBA";
+            break;
+         case siICENodeDataMatrix44:
+            type = AI_TYPE_MATRIX;
+            declaration = "constant ARRAY MATRIX";
+            break;
+         default: // strings are exported only for procedurals, that are not instanced by the instancer
+            continue;
+      }
+
+      m_attributes.push_back(CInstancerAttribute(attr, type, declaration));
+   }
+}
+
+
+// Add the instanceable members of a point's instance. 
+// Their matrices are in the pointcloud space, and the instancer gets the pointcloud matrices,
+// so they must be added before the members get multiplied by the pointcloud matrices
+//
+// @param in_instance       The instance of the point
+// @param in_attributes     The ice attributes
+// @param in_pointIndex     The index of the ice point
+// @param in_doAttributes   true if the attributes must be exported
+//
+void CIceObjectInstancer::AddInstances(CIceObjectInstance *in_instance, CIceAttributesSet *in_attributes, int in_pointIndex, bool in_doAttributes)
+{
+   if (in_doAttributes && !m_attributesCollected)
+      CollectAttributes(in_attributes);
+
+   for (int i=0; i<(int)in_instance->m_members.size(); i++)
+   {
+      CIceObjectBaseShape *member = &in_instance->m_members[i];
+      if (!IsInstanceable(*member))
+         continue;
+
+      AddInstance(member->m_instancedNode, member->m_matrix, member->m_visibility, false, in_pointIndex);
+   }
+}
+
+
+// Add the instance of a unit shape (disc, box, cylinder, cone) for a point
+//
+// @param in_node           The unit shape node
+// @param in_matrix         The matrices of the point, in the pointcloud space
+// @param in_attributes     The ice attributes
+// @param in_pointIndex     The index of the ice point
+// @param in_doAttributes   true if the attributes must be exported
+//
+void CIceObjectInstancer::AddShapeInstance(AtNode* in_node, AtArray* in_matrix, CIceAttributesSet *in_attributes, int in_pointIndex, bool in_doAttributes)
+{
+   if (in_doAttributes && !m_attributesCollected)
+      CollectAttributes(in_attributes);
+
+   if (in_node && in_matrix)
+      AddInstance(in_node, in_matrix, AI_RAY_ALL, true, in_pointIndex);
+}
+
+
+// Add an instance
+//
+// @param in_node           The instanced node
+// @param in_matrix         The matrices of the instance
+// @param in_visibility     The visibility of the instance
+// @param in_isShape        true if the instance is a unit shape, so it gets the pointcloud visibility
+// @param in_pointIndex     The index of the ice point
+//
+void CIceObjectInstancer::AddInstance(AtNode* in_node, AtArray* in_matrix, uint8_t in_visibility, bool in_isShape, int in_pointIndex)
+{
+   unsigned int nodeIdx;
+   map <AtNode*, unsigned int>::iterator it = m_nodesMap.find(in_node);
+   if (it == m_nodesMap.end())
+   {
+      nodeIdx = (unsigned int)m_nodes.size();
+      m_nodes.push_back(in_node);
+      m_nodesMap.insert(pair <AtNode*, unsigned int> (in_node, nodeIdx));
+   }
+   else
+      nodeIdx = it->second;
+
+   m_nodeIdxs.push_back(nodeIdx);
+   for (int iKey=0; iKey<m_nbTransfKeys; iKey++)
+      m_instanceMatrix.push_back(AiArrayGetMtx(in_matrix, iKey));
+   m_instanceVisibility.push_back(in_visibility);
+   m_instanceIsShape.push_back(in_isShape);
+
+   for (int j=0; j<(int)m_attributes.size(); j++)
+      m_attributes[j].PushValue(in_pointIndex);
+}
+
+
+// Return the number of instances
+//
+size_t CIceObjectInstancer::GetNbInstances() const
+{
+   return m_nodeIdxs.size();
+}
+
+
+// Set the visibility of the instances (not yet the node's one)
+//
+// @param in_viz          The input visibility
+// @param in_shapesOnly   If true, set it only for the unit shapes instances. The instances of the
+//                        masters keep the masters' visibility, unless it comes from an arnold_viz property
+//
+void CIceObjectInstancer::SetInstancesVisibility(uint8_t in_viz, bool in_shapesOnly)
+{
+   for (size_t i=0; i<m_instanceVisibility.size(); i++)
+   {
+      if (m_instanceIsShape[i] || !in_shapesOnly)
+         m_instanceVisibility[i] = in_viz;
+   }
+}
+
+
+// Give the node the instances arrays
+//
+// @return false if the node does not exist, else true
+//
+bool CIceObjectInstancer::SetNodeData()
+{
+   if (!m_node)
+      return false;
+   CIceObjectBase::SetNodeData();
+
+   unsigned int nbInstances = (unsigned int)m_nodeIdxs.size();
+   if (nbInstances == 0)
+      return true;
+
+   AiNodeSetArray(m_node, "nodes", AiArrayConvert((uint32_t)m_nodes.size(), 1, AI_TYPE_NODE, &m_nodes[0]));
+   AiNodeSetArray(m_node, "node_idxs", AiArrayConvert(nbInstances, 1, AI_TYPE_UINT, &m_nodeIdxs[0]));
+   AiNodeSetArray(m_node, "instance_visibility", AiArrayConvert(nbInstances, 1, AI_TYPE_BYTE, &m_instanceVisibility[0]));
+
+   // the matrices are stored by instance, while the array wants them by key
+   AtArray* matrices = AiArrayAllocate(nbInstances, (uint8_t)m_nbTransfKeys, AI_TYPE_MATRIX);
+   for (unsigned int i=0; i<nbInstances; i++)
+      for (int iKey=0; iKey<m_nbTransfKeys; iKey++)
+         AiArraySetMtx(matrices, iKey*nbInstances + i, m_instanceMatrix[i*m_nbTransfKeys + iKey]);
+   AiNodeSetArray(m_node, "instance_matrix", matrices);
+
+   // same as setting inherit_xform off on the ginstances
+   AtArray* inheritXform = AiArrayAllocate(nbInstances, 1, AI_TYPE_BOOLEAN);
+   for (unsigned int i=0; i<nbInstances; i++)
+      AiArraySetBool(inheritXform, i, false);
+   AiNodeSetArray(m_node, "instance_inherit_xform", inheritXform);
+
+   // the instance_* user data are given by the instancer to each instance, without the prefix
+   for (int i=0; i<(int)m_attributes.size(); i++)
+   {
+      CInstancerAttribute *attr = &m_attributes[i];
+      CString name = L"instance_" + attr->m_attr->m_name;
+      if (AiNodeDeclare(m_node, name.GetAsciiString(), attr->m_declaration))
+         AiNodeSetArray(m_node, name.GetAsciiString(), AiArrayConvert(nbInstances, 1, attr->m_type, &attr->m_data[0]));
+   }
+
+   return true;
+}
+
+
+// Set the Arnold Parameters set 
+//
+// @param in_property   The Arnold Parameters custom property
+// @param in_frame      The evaluation frame
+//
+void CIceObjectInstancer::SetArnoldParameters(CustomProperty in_property, double in_frame)
+{
+   LoadArnoldParameters(m_node, in_property.GetParameters(), in_frame, false); 
+}
+
+
 ///////////////////////////////////////////////////////////////////////
 // CIceObjects class, the home of all the objects built for the ice tree
 ///////////////////////////////////////////////////////////////////////
@@ -4911,6 +5356,9 @@ bool CIceObjectStrandInstance::LoadStrandInstance(Model in_modelMaster, CRefArra
 void CIceObjects::SetNodesVisibility(uint8_t in_viz, bool in_arnoldVizExists)
 {
    int i;
+   // if batched, the unit shapes are just the hidden masters of the instancer
+   uint8_t shapesViz = m_batchShapes ? 0 : in_viz;
+
    for (i=0; i < (int)m_pointsSphere.size(); i++)
       m_pointsSphere[i].SetVisibility(in_viz);
    for (i=0; i < (int)m_pointsDisk.size(); i++)
@@ -4918,15 +5366,17 @@ void CIceObjects::SetNodesVisibility(uint8_t in_viz, bool in_arnoldVizExists)
    for (i=0; i < (int)m_rectangles.size(); i++)
       m_rectangles[i].SetVisibility(in_viz);
    for (i=0; i < (int)m_discs.size(); i++)
-      m_discs[i].SetVisibility(in_viz);
+      m_discs[i].SetVisibility(shapesViz);
    for (i=0; i < (int)m_boxes.size(); i++)
-      m_boxes[i].SetVisibility(in_viz);
+      m_boxes[i].SetVisibility(shapesViz);
    for (i=0; i < (int)m_cylinders.size(); i++)
-      m_cylinders[i].SetVisibility(in_viz);
+      m_cylinders[i].SetVisibility(shapesViz);
    for (i=0; i < (int)m_cones.size(); i++)
-      m_cones[i].SetVisibility(in_viz);
+      m_cones[i].SetVisibility(shapesViz);
    for (i=0; i < (int)m_strands.size(); i++)
       m_strands[i].SetVisibility(in_viz);
+   for (i=0; i < (int)m_instancer.size(); i++)
+      m_instancer[i].SetInstancesVisibility(in_viz, true);
 
    // if the viz is not an arnold one (but an xsi one), do not set the visibility
    // of the instances, since they will inherit the masters' one
@@ -4941,6 +5391,12 @@ void CIceObjects::SetNodesVisibility(uint8_t in_viz, bool in_arnoldVizExists)
       m_instances[i].SetVisibility(in_viz);
    }
 
+   for (i=0; i < (int)m_instancer.size(); i++)
+   {
+      m_instancer[i].SetInstancesVisibility(in_viz, false);
+      m_instancer[i].SetVisibility(in_viz);
+   }
+
    for (i=0; i < (int)m_strandInstances.size(); i++)
    {
       // set the viz for the strand instances
@@ -4981,6 +5437,9 @@ void CIceObjects::SetNodesSidedness(uint8_t in_sid)
          m_instances[i].m_members[j].SetSidedness(in_sid);
       m_instances[i].SetSidedness(in_sid);
    }
+
+   for (i=0; i < (int)m_instancer.size(); i++)
+      m_instancer[i].SetSidedness(in_sid);
    
    for (i=0; i < (int)m_strandInstances.size(); i++)
    {
@@ -5041,6 +5500,8 @@ void CIceObjects::SetNodesData()
       m_strands[i].SetNodeData();
    for (i=0; i < (int)m_instances.size(); i++) //set the data for the ginstances
       m_instances[i].SetNodeData(true);
+   for (i=0; i < (int)m_instancer.size(); i++)
+      m_instancer[i].SetNodeData();
    for (i=0; i < (int)m_strandInstances.size(); i++)
       m_strandInstances[i].SetNodeData(false);
 }
@@ -5078,6 +5539,8 @@ void CIceObjects::SetArnoldParameters(CustomProperty in_property, double in_fram
       for (j=0; j <(int)m_instances[i].m_members.size(); j++)
          m_instances[i].m_members[j].SetArnoldParameters(in_property, in_frame);
    }
+   for (i=0; i < (int)m_instancer.size(); i++)
+      m_instancer[i].SetArnoldParameters(in_property, in_frame);
    for (i=0; i < (int)m_strandInstances.size(); i++)
    {
       for (j=0; j <(int)m_strandInstances[i].m_members.size(); j++)
@@ -5112,6 +5575,8 @@ void CIceObjects::SetMotionStartEnd()
       for (j=0; j <(int)m_instances[i].m_members.size(); j++)
          m_instances[i].m_members[j].SetMotionStartEnd();
    }
+   for (i=0; i < (int)m_instancer.size(); i++)
+      m_instancer[i].SetMotionStartEnd();
    for (i=0; i < (int)m_strandInstances.size(); i++)
    {
       for (j=0; j <(int)m_strandInstances[i].m_members.size(); j++)
@@ -5152,6 +5617,8 @@ void CIceObjects::SetArnoldUserOptions(CustomProperty in_property,  double in_fr
       for (j=0; j <(int)m_instances[i].m_members.size(); j++)
          m_instances[i].m_members[j].SetArnoldUserOptions(in_property, in_frame);
    }
+   for (i=0; i < (int)m_instancer.size(); i++)
+      m_instancer[i].SetArnoldUserOptions(in_property, in_frame);
    for (i=0; i < (int)m_strandInstances.size(); i++)
    {
       for (j=0; j <(int)m_strandInstances[i].m_members.size(); j++)
@@ -5192,6 +5659,8 @@ void CIceObjects::SetUserDataBlobs(const X3DObject &in_xsiObj, double in_frame)
          for (j=0; j <(int)m_instances[i].m_members.size(); j++)
             m_instances[i].m_members[j].SetUserDataBlobs(blobProperties, in_frame);
       }
+      for (i=0; i < (int)m_instancer.size(); i++)
+         m_instancer[i].SetUserDataBlobs(blobProperties, in_frame);
       for (i=0; i < (int)m_strandInstances.size(); i++)
       {
          for (j=0; j <(int)m_strandInstances[i].m_members.size(); j++)
@@ -5230,6 +5699,8 @@ void CIceObjects::SetMatte(Property in_property, double in_frame)
       for (j=0; j <(int)m_instances[i].m_members.size(); j++)
          m_instances[i].m_members[j].SetMatte(in_property, in_frame);
    }
+   for (i=0; i < (int)m_instancer.size(); i++)
+      m_instancer[i].SetMatte(in_property, in_frame);
    for (i=0; i < (int)m_strandInstances.size(); i++)
    {
       for (j=0; j <(int)m_strandInstances[i].m_members.size(); j++)
@@ -5246,7 +5717,8 @@ vector <AtNode*> CIceObjects::GetAllNodes()
    int i, j;
    vector <AtNode*> result;
    int size = (int)m_pointsSphere.size() + (int)m_pointsDisk.size() + (int)m_rectangles.size() + (int)m_discs.size() + 
-              (int)m_boxes.size() + (int)m_cylinders.size() + (int)m_cones.size() + (int)m_strands.size(); 
+              (int)m_boxes.size() + (int)m_cylinders.size() + (int)m_cones.size() + (int)m_strands.size() +
+              (int)m_instancer.size(); 
    // for instances, we take the members sizes
    for (i=0; i < (int)m_instances.size(); i++)
       size+= (int)m_instances[i].m_members.size();
@@ -5306,6 +5778,12 @@ vector <AtNode*> CIceObjects::GetAllNodes()
       index++;
    }
 
+   for (i=0; i < (int)m_instancer.size(); i++)
+   {
+      result[index] = m_instancer[i].GetNode();
+      index++;
+   }
+
    for (i=0; i < (int)m_strandInstances.size(); i++)
    for (j=0; j <(int)m_strandInstances[i].m_members.size(); j++)
    {
@@ -5434,6 +5912,8 @@ void CIceObjects::SetLightGroup(AtArray* in_lightGroup)
       for (j=0; j <(int)m_instances[i].m_members.size(); j++)
          m_instances[i].m_members[j].SetLightGroup(in_lightGroup);
    }
+   for (i=0; i < (int)m_instancer.size(); i++)
+      m_instancer[i].SetLightGroup(in_lightGroup);
    for (i=0; i < (int)m_strandInstances.size(); i++)
    {
       for (j=0; j <(int)m_strandInstances[i].m_members.size(); j++)
@@ -5456,6 +5936,57 @@ bool CIceObjects::HasAtLeastOneInstancedLight()
 }
 
 
+// Remove the members of the instances that were moved into the instancer.
+// Their ginstance nodes were never created, so only their matrices are to be freed.
+// If nothing went into the instancer, the instancer is destroyed instead.
+//
+void CIceObjects::RemoveInstancerMembers()
+{
+   if (m_instancer.size() == 0)
+      return;
+
+   CIceObjectInstancer *instancer = &m_instancer[0];
+   if (instancer->GetNbInstances() == 0)
+   {
+      AiNodeDestroy(instancer->GetNode());
+      m_instancer.clear();
+      return;
+   }
+
+   for (int i=0; i < (int)m_instances.size(); i++)
+   {
+      CIceObjectInstance *instance = &m_instances[i];
+      vector <CIceObjectBaseShape> members;
+      bool removed(false);
+
+      for (int j=0; j < (int)instance->m_members.size(); j++)
+      {
+         CIceObjectBaseShape *member = &instance->m_members[j];
+         // the matrix array was never given to a node, so let the destructor free it
+         if (instancer->IsInstanceable(*member))
+            removed = true;
+         else
+            members.push_back(*member);
+      }
+
+      if (!removed)
+         continue;
+
+      // the kept members were copied with their own matrix array
+      for (int j=0; j < (int)instance->m_members.size(); j++)
+      {
+         CIceObjectBaseShape *member = &instance->m_members[j];
+         if (member->m_node && member->m_matrix)
+         {
+            AiArrayDestroy(member->m_matrix);
+            member->m_matrix = NULL;
+         }
+      }
+      instance->m_members.swap(members);
+   }
+}
+
+
 // Log the number of objects for each type
 void CIceObjects::Log()
 {
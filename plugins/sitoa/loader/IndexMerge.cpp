@@ -0,0 +1,336 @@
+/************************************************************************************************************************************
+Copyright 2017 Autodesk, Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance with the License. 
+You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is distributed on an "AS IS" BASIS, 
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+See the License for the specific language governing permissions and limitations under the License.
+************************************************************************************************************************************/
+
+#include "common/WorkerPool.h"
+#include "loader/IndexMerge.h"
+
+#include <algorithm>
+#include <cstring>
+
+inline int compareFloatN(const void *ptr1, const void *ptr2, int float_size)
+{
+    int v = 0;
+    int *p1 = (int*)ptr1;
+    int *p2 = (int*)ptr2;
+
+    while (float_size-- > 0 && v == 0)
+        v = *(p1++) - *(p2++);
+
+    return v;
+}
+
+inline bool equalFloat1(const void *ptr1, const void *ptr2, int /*float_size*/)
+{
+    return *(float*)ptr1 == *(float*)ptr2;
+}
+
+inline bool equalFloat2(const void *ptr1, const void *ptr2, int /*float_size*/)
+{
+    return *(uint64_t*)ptr1 == *(uint64_t*)ptr2;
+}
+
+inline bool equalFloat3(const void *ptr1, const void *ptr2, int /*float_size*/)
+{
+    // compare 64 + 32 bits
+    return *(uint64_t*)ptr1 == *(uint64_t*)ptr2 && *((float*)ptr1 + 2) == *((float*)ptr2 + 2);
+}
+
+inline bool equalFloat4(const void *ptr1, const void *ptr2, int /*float_size*/)
+{
+    // compare 64 + 64 bits
+    const uint64_t *di = (uint64_t*)ptr1;
+    const uint64_t *dj = (uint64_t*)ptr2;
+    return *di == *dj && *(di + 1) == *(dj + 1);
+}
+
+inline bool equalFloatN(const void *ptr1, const void *ptr2, int float_size)
+{
+    return compareFloatN(ptr1, ptr2, float_size) == 0;
+}
+
+/// IndexValue comparison functors for std::sort()
+struct IndexValueLessThanFloat1
+{
+    bool operator()(const IndexValue& i, const IndexValue& j)
+    {
+        return i.vidx == j.vidx ? *(float*)i.value < *(float*)j.value : i.vidx < j.vidx;
+    }
+};
+
+struct IndexValueLessThanFloat2
+{
+    bool operator()(const IndexValue& i, const IndexValue& j)
+    {
+        // compare 64 bits
+        return i.vidx == j.vidx ? *(uint64_t*)i.value < *(uint64_t*)j.value : i.vidx < j.vidx;
+    }
+};
+
+struct IndexValueLessThanFloat3
+{
+    bool operator()(const IndexValue& i, const IndexValue& j)
+    {
+        if (i.vidx == j.vidx)
+        {
+            // compare 64 + 32 bits
+            uint64_t *di = (uint64_t*)i.value;
+            uint64_t *dj = (uint64_t*)j.value;
+            return *di == *dj ? *((float*)i.value + 2) < *((float*)j.value + 2) : *di < *dj;
+        }
+        return i.vidx < j.vidx;
+    }
+};
+
+struct IndexValueLessThanFloat4
+{
+    bool operator()(const IndexValue& i, const IndexValue& j)
+    {
+        if (i.vidx == j.vidx)
+        {
+            // compare 64 + 64 bits
+            uint64_t *di = (uint64_t*)i.value;
+            uint64_t *dj = (uint64_t*)j.value;
+            return *di == *dj ? *(di + 1) < *(dj + 1) : *di < *dj;
+        }
+        return i.vidx < j.vidx;
+    }
+};
+
+struct IndexValueLessThanFloatN
+{
+    IndexValueLessThanFloatN(int float_size) : float_size(float_size) {}
+
+    bool operator()(const IndexValue& i, const IndexValue& j)
+    {
+        return i.vidx == j.vidx ? compareFloatN(i.value, j.value, float_size) < 0 : i.vidx < j.vidx;
+    }
+
+    int float_size; ///< size in 32bit floats
+};
+
+
+// Sort a small range by insertion, which is stable and faster than std::sort for a few elements
+template <typename LessThan>
+inline void InsertionSort(IndexValue* first, IndexValue* last, LessThan lessThan)
+{
+    for (IndexValue* it = first + 1; it < last; ++it)
+    {
+        IndexValue value = *it;
+        IndexValue* hole = it;
+        for (; hole > first && lessThan(value, *(hole - 1)); --hole)
+            *hole = *(hole - 1);
+        *hole = value;
+    }
+}
+
+// Sort the index values of one vertex by data value
+template <typename LessThan>
+inline void SortVertexBucket(IndexValue* first, IndexValue* last, LessThan lessThan)
+{
+    if (last - first < 2)
+        return;
+    if (last - first <= 16)
+        InsertionSort(first, last, lessThan);
+    else
+        std::stable_sort(first, last, lessThan);
+}
+
+// Sort all the index values by vertex index and by data value for equal indices
+inline void SortIndexValues(IndexValue* index_values, uint32_t index_count, int float_size)
+{
+    switch (float_size)
+    {
+    case 1:  std::sort(index_values, index_values + index_count, IndexValueLessThanFloat1()); break;
+    case 2:  std::sort(index_values, index_values + index_count, IndexValueLessThanFloat2()); break;
+    case 3:  std::sort(index_values, index_values + index_count, IndexValueLessThanFloat3()); break;
+    case 4:  std::sort(index_values, index_values + index_count, IndexValueLessThanFloat4()); break;
+    default: std::sort(index_values, index_values + index_count, IndexValueLessThanFloatN(float_size)); break;
+    }
+}
+
+/// Sorts the per-vertex buckets of the index values, for a range of vertices
+class CSortVertexBucketsBody : public CParallelForBody
+{
+public:
+    CSortVertexBucketsBody(IndexValue* index_values, const uint32_t* offsets, int float_size) :
+        index_values(index_values), offsets(offsets), float_size(float_size)
+    {}
+
+    void Run(unsigned int in_begin, unsigned int in_end)
+    {
+        for (unsigned int v = in_begin; v < in_end; ++v)
+        {
+            IndexValue* first = index_values + offsets[v];
+            IndexValue* last  = index_values + offsets[v + 1];
+            switch (float_size)
+            {
+            case 1:  SortVertexBucket(first, last, IndexValueLessThanFloat1()); break;
+            case 2:  SortVertexBucket(first, last, IndexValueLessThanFloat2()); break;
+            case 3:  SortVertexBucket(first, last, IndexValueLessThanFloat3()); break;
+            case 4:  SortVertexBucket(first, last, IndexValueLessThanFloat4()); break;
+            default: SortVertexBucket(first, last, IndexValueLessThanFloatN(float_size)); break;
+            }
+        }
+    }
+
+    IndexValue*     index_values;
+    const uint32_t* offsets;     ///< start of the bucket of each vertex, plus the end of the last one
+    int             float_size;  ///< size in 32bit floats
+};
+
+
+// Merge vertex indices that have the same value on the same point in place.
+// For a value array with multiple mb keys, it's important to call this function only after
+// having collected all the keys, and NOT after each single key, because the input array
+// gets destroyed and resized.
+//
+// The function does not access the mesh node, so it can be run by the export workers.
+//
+// @param vidxs the vertex indices of the mesh
+// @param idxs indexed data indices to merge
+// @param values data values to merge
+// @param canonical assume the indices and values are canonical
+//
+void IndexMerge(AtArray* vidxs, AtArray*& idxs, AtArray*& values, bool canonical)
+{
+    if (!vidxs || !idxs || !values)
+        return;
+
+    if (AiArrayGetNumElements(vidxs) != AiArrayGetNumElements(idxs))
+        return;
+
+    if (AiArrayGetNumElements(idxs) < 2 || AiArrayGetNumElements(values) < 2)
+        return;
+
+    const int type_size = AiParamGetTypeSize(AiArrayGetType(values));
+
+    if (type_size % 4) // storage class not float or int
+        return;
+
+    const int float_size = type_size / 4; // size in 32bit floats or ints
+
+    // create indexed values vector
+    const uint32_t index_count = AiArrayGetNumElements(idxs);
+    IndexValue* index_values = (IndexValue*)AiMalloc(sizeof(IndexValue) * index_count);
+
+    const uint32_t* vidx_data = INDEX_ARRAY(vidxs);
+    const uint32_t* idx_data  = INDEX_ARRAY(idxs);
+
+    // For the values with several keys (the motion blurred normals), the corner whose later keys are kept
+    // among the ones with an equal first key is the first one of its group after the sort. So, these keep
+    // the full sort, to merge exactly as they always did. The single key values are bucketed by vertex below.
+    if (AiArrayGetNumKeys(values) > 1)
+    {
+        // initialize the indexed values, optimize if the indices are canonical.
+        // index_values is filled with the first key of the values array only
+        if (canonical)
+            for (uint32_t i = 0; i < index_count; ++i)
+                index_values[i].set(i, vidx_data[i], VALUE_AT(values, 0, i));
+        else
+            for (uint32_t i = 0; i < index_count; ++i)
+                index_values[i].set(i, vidx_data[i], VALUE_AT(values, 0, idx_data[i]));
+
+        SortIndexValues(index_values, index_count, float_size);
+    }
+    else
+    {
+        // bucket the indexed values by vertex index (counting sort, in linear time).
+        // offsets[v] is the start of the bucket of vertex v
+        uint32_t vertex_count = 0;
+        for (uint32_t i = 0; i < index_count; ++i)
+            vertex_count = std::max(vertex_count, vidx_data[i] + 1);
+
+        uint32_t* offsets = (uint32_t*)AiMalloc(sizeof(uint32_t) * (vertex_count + 1));
+        memset(offsets, 0, sizeof(uint32_t) * (vertex_count + 1));
+        for (uint32_t i = 0; i < index_count; ++i)
+            offsets[vidx_data[i] + 1]++;
+        for (uint32_t v = 0; v < vertex_count; ++v)
+            offsets[v + 1]+= offsets[v];
+
+        // initialize the indexed values in their bucket, optimize if the indices are canonical,
+        // which is always the case in HtoA so far.
+        // index_values is filled with the first key of the values array only
+        uint32_t* next = (uint32_t*)AiMalloc(sizeof(uint32_t) * vertex_count);
+        memcpy(next, offsets, sizeof(uint32_t) * vertex_count);
+        if (canonical)
+            for (uint32_t i = 0; i < index_count; ++i)
+                index_values[next[vidx_data[i]]++].set(i, vidx_data[i], VALUE_AT(values, 0, i));
+        else
+            for (uint32_t i = 0; i < index_count; ++i)
+                index_values[next[vidx_data[i]]++].set(i, vidx_data[i], VALUE_AT(values, 0, idx_data[i]));
+        AiFree(next);
+
+        // sort by data value within each vertex bucket. The buckets are a few elements each, and independent,
+        // so this is linear in practice, and is split across the worker threads for the large meshes.
+        // The result is the same order the full sort by vertex index and value used to give.
+        CSortVertexBucketsBody sortBody(index_values, offsets, float_size);
+        CWorkerPool::ParallelFor(vertex_count, sortBody, 65536);
+        AiFree(offsets);
+    }
+
+    // count the number of unique pairs, and assign to first_unique the index to the first unique pair
+    IndexValue* it_prev = index_values;
+    IndexValue* it = it_prev + 1;
+    uint32_t value_count = 1;
+
+    bool (*equalFloatX)(const void *, const void *, int);
+    switch (float_size)
+    {
+    case 1:  equalFloatX = equalFloat1; break;
+    case 2:  equalFloatX = equalFloat2; break;
+    case 3:  equalFloatX = equalFloat3; break;
+    case 4:  equalFloatX = equalFloat4; break;
+    default: equalFloatX = equalFloatN; break;
+    }
+
+    for (uint32_t i = 1; i < index_count; ++it, ++i)
+    {
+        if (it->vidx == it_prev->vidx && equalFloatX(it->value, it_prev->value, float_size))
+            it->value_index = it_prev->value_index;
+        else
+        {
+            it->value_index = i;
+            it_prev = it;
+            ++value_count;
+        }
+    }
+
+    // nothing to merge, the caller will keep its original arrays
+    if (value_count == AiArrayGetNumElements(values))
+    {
+        AiFree(index_values);
+        return;
+    }
+
+    const uint32_t values_stride = arrayStride(values);
+    // write out compressed values array and update merged indices
+    AtArray* merged_values = AiArrayAllocate(value_count, AiArrayGetNumKeys(values), AiArrayGetType(values));
+
+    for (uint32_t i = 0, value_index = 0; i < index_count; ++i)
+    {
+        // unique value to be added to the returned value array, true for i == 0
+        if (i == index_values[i].value_index)
+        {
+            // All the keys are copied: key 0 from index_values[i].value, key k from the same pointer displaced by k * array_stride bytes.
+            // Note however that nkeys should be > 1 only when merging normals, other data should not be subject to motion blur.
+            for (uint8_t k = 0; k < AiArrayGetNumKeys(values); ++k)
+                memcpy(VALUE_AT(merged_values, k, value_index), (uint8_t*)index_values[i].value + k * values_stride, type_size);
+            value_index++;
+        }
+
+        // the index to be returned for the i-th vertex index points to the last added value
+        INDEX_ARRAY(idxs)[index_values[i].position] = value_index - 1;
+    }
+
+    AiFree(index_values);
+    AiArrayDestroy(values);
+    values = merged_values;
+}
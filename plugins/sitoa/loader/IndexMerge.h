@@ -0,0 +1,46 @@
+/************************************************************************************************************************************
+Copyright 2017 Autodesk, Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance with the License. 
+You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is distributed on an "AS IS" BASIS, 
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+See the License for the specific language governing permissions and limitations under the License.
+************************************************************************************************************************************/
+
+#pragma once
+
+#include <ai_array.h>
+#include <ai_params.h>
+
+/// Return the distance in bytes from key to key of an array
+inline uint32_t arrayStride(const AtArray* array)
+{
+    return AiArrayGetNumElements(array) * AiParamGetTypeSize(AiArrayGetType(array));
+}
+
+#define INDEX_ARRAY(a) (static_cast<unsigned*>(AiArrayMap(a)))
+#define VALUE_AT(a, k, i) (&(static_cast<uint8_t*>(AiArrayMap(a))[(k * AiArrayGetNumElements(a) + i) * type_size]))
+
+/// Index-value pairs
+struct IndexValue
+{
+    uint32_t vidx;         ///< vertex index
+    uint32_t position;     ///< original index position
+    uint32_t value_index;  ///< corresponding value index
+    void*    value;        ///< value pointer
+
+    IndexValue() {}
+
+    inline void set(uint32_t position, uint32_t vidx, void* value)
+    {
+        this->vidx        = vidx;
+        this->position    = position;
+        this->value_index = 0;
+        this->value       = value;
+    }
+};
+
+// Merge vertex indices that have the same value on the same point in place
+void IndexMerge(AtArray* vidxs, AtArray*& idxs, AtArray*& values, bool canonical = false);
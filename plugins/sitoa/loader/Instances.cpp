@@ -66,20 +66,26 @@ CStatus LoadInstances(double in_frame, CRefArray &in_selectedObjs, bool in_selec
    // into the sorted array BEFORE B
    SortInstances(instancedModels, sortedInstancedModels, 0);
 
+   // the user data that the instances share with their shapes instead of copying
+   CSharedUserData sharedUserData;
    for (LONG i=0; i<sortedInstancedModels.GetCount(); ++i)
    {
       Model model(sortedInstancedModels[i]);
       // GetMessageQueue()->LogMessage(L"  LoadInstances: model = " + model.GetName()); 
-      status = LoadSingleInstance(model, in_frame);
+      status = LoadSingleInstance(model, in_frame, &sharedUserData);
       if (status != CStatus::OK) // something went wrong
          break;
    }
 
+   if (sharedUserData.m_bytes > 0)
+      GetMessageQueue()->LogMsg(L"[sitoa] Instances: " + CValue((double)sharedUserData.m_bytes / (1024.0 * 1024.0)).GetAsText() + 
+                                L" MB of user data shared with the master shapes instead of being copied");
+
    return status;
 }
 
 
-CStatus LoadSingleInstance(Model &in_instanceModel, double in_frame)
+CStatus LoadSingleInstance(Model &in_instanceModel, double in_frame, CSharedUserData *io_sharedUserData)
 {
    if (GetRenderInstance()->InterruptRenderSignal())
       return CStatus::Abort;
@@ -188,7 +194,7 @@ CStatus LoadSingleInstance(Model &in_instanceModel, double in_frame)
             double keyFrame = transfKeys[ikey];
             // Model transform
             AtMatrix matrixModel, matrixModelInv;
-            CUtilities().S2A(modelMaster.GetKinematics().GetGlobal().GetTransform(keyFrame), matrixModel);            
+            GetRenderInstance()->TransformCache().GetGlobalMatrix(modelMaster, keyFrame, matrixModel);            
             matrixModelInv = AiM4Invert(matrixModel);
             // Child transform
             AtMatrix matrixChild, matrixChildInv;
@@ -196,7 +202,7 @@ CStatus LoadSingleInstance(Model &in_instanceModel, double in_frame)
             matrixChildInv = AiM4Mult(matrixChild, matrixModelInv);
             // output transform
             AtMatrix matrixOutput, matrixOutputInv;
-            CUtilities().S2A(in_instanceModel.GetKinematics().GetGlobal().GetTransform(keyFrame), matrixOutput);
+            GetRenderInstance()->TransformCache().GetGlobalMatrix(in_instanceModel, keyFrame, matrixOutput);
             matrixOutputInv = AiM4Mult(matrixChildInv, matrixOutput);
             // save to array
             AiArraySetMtx(matrices, ikey, matrixOutputInv);
@@ -257,7 +263,7 @@ CStatus LoadSingleInstance(Model &in_instanceModel, double in_frame)
                {
                   CNodeSetter::SetPointer(ginstanceNode, "node", (AtNode*)AiNodeGetPtr(masterNode, "node"));
                   // clone the user attributes (if any)
-                  CloneNodeUserData(ginstanceNode, masterNode);
+                  CloneNodeUserData(ginstanceNode, masterNode, GetRenderOptions()->m_share_instance_user_data ? io_sharedUserData : NULL);
                   // Override the id (trac#437). For coherence, power instances inherit the id of the base object.
                   // If we comment this line, the ginstances that inherited the members from other
                   // ginstances get the instanced model id, instead of the instanced polymesh id
@@ -490,153 +496,3 @@ void SortInstances(CRefArray &in_modelsArray, CRefArray &out_modelsArray, int in
 	}
 }
 
-
-// these are the categories:
-// #define AI_USERDEF_UNDEFINED  0  // Undefined, you should never encounter a parameter of this category
-// #define AI_USERDEF_CONSTANT   1  // User-defined: per-object parameter
-// #define AI_USERDEF_UNIFORM    2  // User-defined: per-face parameter
-// #define AI_USERDEF_VARYING    3  // User-defined: per-vertex parameter
-
-// Copy the attributes from in_masterNode to in_node
-//
-// @param in_node        The target node to which the attributes must be copied
-// @param in_masterNode  The input node where to copy the attributes from
-// @return void 
-//
-void CloneNodeUserData(AtNode* in_node, AtNode* in_masterNode)
-{
-   AtUserParamIterator *iter = AiNodeGetUserParamIterator(in_masterNode);
-   // iterate all the user attributes
-   while (!AiUserParamIteratorFinished(iter))
-   {
-      const AtUserParamEntry *upentry = AiUserParamIteratorGetNext(iter);
-      // attribute name
-      string attrName(AiUserParamGetName(upentry));
-      // get the declaration string of the attribute, for instance "uniform FLOAT"
-      string declarationString = GetUserParamaterDeclarationString(upentry);
-      if (declarationString == "") // something went wrong
-         continue;
-      // declare the attribute on in_node
-      if (AiNodeDeclare(in_node, attrName.c_str(), declarationString.c_str()))
-      {
-         // constant attributes (just one value). Copy it
-         if (declarationString == "constant BOOL")
-            CNodeSetter::SetBoolean(in_node, attrName.c_str(), AiNodeGetBool(in_masterNode, attrName.c_str()));
-         else if (declarationString == "constant INT")
-            CNodeSetter::SetInt(in_node, attrName.c_str(), AiNodeGetInt(in_masterNode, attrName.c_str()));
-         else if (declarationString == "constant FLOAT")
-            CNodeSetter::SetFloat(in_node, attrName.c_str(), AiNodeGetFlt(in_masterNode, attrName.c_str()));
-         else if (declarationString == "constant VECTOR")
-         {
-            AtVector v = AiNodeGetVec(in_masterNode, attrName.c_str());
-            CNodeSetter::SetVector(in_node, attrName.c_str(), v.x, v.y, v.z);
-         }
-         else if (declarationString == "constant RGB")
-         {
-            AtRGB c = AiNodeGetRGB(in_masterNode, attrName.c_str());
-            CNodeSetter::SetRGB(in_node, attrName.c_str(), c.r, c.g, c.b);
-         }
-         else if (declarationString == "constant RGBA")
-         {
-            AtRGBA c = AiNodeGetRGBA(in_masterNode, attrName.c_str());
-            CNodeSetter::SetRGBA(in_node, attrName.c_str(), c.r, c.g, c.b, c.a);
-         }
-         else // constant array, or uniform or varying or indexed data: clone the array
-         {
-            AiNodeSetArray(in_node, attrName.c_str(), AiArrayCopy(AiNodeGetArray(in_masterNode, attrName.c_str())));
-            if (AiUserParamGetCategory(upentry) == 4) // indexed? Also copy the idxs array
-            {
-               string indexesName = attrName + "idxs";
-               AiNodeSetArray(in_node, indexesName.c_str(), AiArrayCopy(AiNodeGetArray(in_masterNode, indexesName.c_str())));
-            }
-         }
-      }
-   }
-   AiUserParamIteratorDestroy(iter);
-}
-
-
-// Return the declaration string for an attribute, pointed by in_upentry
-//
-// @param in_upentry  The user attribute
-// @return the declaration string (for instance "varying INT"), or "" in case of error 
-//
-string GetUserParamaterDeclarationString(const AtUserParamEntry *in_upentry)
-{
-   string result;
-   string categories[4] = {"constant", "uniform", "varying", "indexed"};
-
-   int attrCat = AiUserParamGetCategory(in_upentry);
-
-   if (attrCat < 1 || attrCat > 4)
-      return ""; // error
-   else
-      result = categories[attrCat-1];
-
-   int attrType = AiUserParamGetType(in_upentry);
-
-   switch (attrType)
-   {
-      case AI_TYPE_BOOLEAN:
-         result+= " BOOL";
-         break;
-      case AI_TYPE_INT:
-         result+= " INT";
-         break;
-      case AI_TYPE_FLOAT:
-         result+= " FLOAT";
-         break;
-      case AI_TYPE_VECTOR:
-         result+= " VECTOR";
-         break;
-      case AI_TYPE_RGB:
-         result+= " RGB";
-         break;
-      case AI_TYPE_RGBA:
-         result+= " RGBA";
-         break;
-      case AI_TYPE_VECTOR2:
-         result+= " VECTOR2";
-         break;
-      case AI_TYPE_ARRAY:
-         result+= " ARRAY";
-         break;
-      default: // unsupported attribute type
-         return "";
-   }
-
-   if (attrType == AI_TYPE_ARRAY)
-   {
-      attrType = AiUserParamGetArrayType(in_upentry);
-
-      switch (attrType)
-      {
-         case AI_TYPE_BOOLEAN:
-            result+= " BOOL";
-            break;
-         case AI_TYPE_INT:
-            result+= " INT";
-            break;
-         case AI_TYPE_FLOAT:
-            result+= " FLOAT";
-            break;
-         case AI_TYPE_VECTOR:
-            result+= " VECTOR";
-            break;
-         case AI_TYPE_RGB:
-            result+= " RGB";
-            break;
-         case AI_TYPE_RGBA:
-            result+= " RGBA";
-            break;
-         case AI_TYPE_VECTOR2:
-            result+= " VECTOR2";
-            break;
-         default: // unsupported attribute type
-            return "";
-      }
-   }
-
-   return result;
-}
-
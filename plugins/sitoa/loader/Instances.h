@@ -11,6 +11,8 @@ See the License for the specific language governing permissions and limitations
 
 #pragma once
 
+#include "loader/UserData.h"
+
 #include <xsi_x3dobject.h>
 
 enum eInstanceType
@@ -57,7 +59,7 @@ typedef pair<CString, CMasterData> CMasterDataPair;
 // Load all the instances
 CStatus LoadInstances(double in_frame, CRefArray &in_selectedObjs, bool in_selectionOnly = false);
 // Load one single instance into Arnold
-CStatus LoadSingleInstance(Model &in_instanceModel, double in_frame);
+CStatus LoadSingleInstance(Model &in_instanceModel, double in_frame, CSharedUserData *io_sharedUserData = NULL);
 // Return a list of the objects and lights under a model or hierarchy. If the model is an instance, return what under its master
 CRefArray GetObjectsAndLightsUnderMaster(const X3DObject &in_xsiObj);
 // Returns all the model instances under this model
@@ -79,8 +81,4 @@ bool AddRefInUniqueRefArray(CRefArray &io_refArray, const CRef &in_ref);
 // Sorts the input array of model instances into a new array (of the same size) 
 // where the deeper nested models are inserted first.
 void SortInstances(CRefArray &in_modelsArray, CRefArray &out_modelsArray, int in_securityExit);
-// Copy the attributes from in_masterNode to in_node
-void CloneNodeUserData(AtNode* in_node, AtNode* in_masterNode);
-// Return the declaration string for an attribute, pointed by in_upentry
-string GetUserParamaterDeclarationString(const AtUserParamEntry *in_upentry);
 
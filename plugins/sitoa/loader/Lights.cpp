@@ -379,6 +379,20 @@ AtArray* CLightMap::GetLightGroup(const X3DObject &in_xsiObj)
 }
 
 
+// Get the pointers to all the lights, in the map order
+//
+// @param out_lights      the returned lights
+//
+void CLightMap::GetLights(vector <CLight*> &out_lights)
+{
+   out_lights.clear();
+   out_lights.reserve(m_map.size());
+   map <AtNodeLookupKey, CLight>::iterator it;
+   for (it = m_map.begin(); it != m_map.end(); it++)
+      out_lights.push_back(&it->second);
+}
+
+
 // Cycle all the lights and erase a light node from the nodes belonging to the lights
 //
 // @param in_node    the light node to be erased
@@ -684,6 +698,102 @@ AtNode* DuplicateLightNode(const Light& in_xsiLight, CString in_nodeName, double
 }
 
 
+/////////////////////////////////////
+/////////////////////////////////////
+// CLightGroupTable
+/////////////////////////////////////
+/////////////////////////////////////
+
+// Build the table from the lights in the map
+//
+// @param in_lightMap      the lights map
+//
+void CLightGroupTable::Build(CLightMap &in_lightMap)
+{
+   m_objects.clear();
+   m_groups.clear();
+   in_lightMap.GetLights(m_lights);
+   m_hasMembers = in_lightMap.AtLeastOneLightHasMembers();
+   if (!m_hasMembers)
+      return;
+
+   unsigned int nbWords = (unsigned int)(m_lights.size() + 31) / 32;
+   // invert the association sets of the lights into a bitset for each object
+   for (unsigned int i=0; i<(unsigned int)m_lights.size(); i++)
+   {
+      if (!m_lights[i]->m_hasMembers)
+         continue;
+
+      set <CString> *associatedObjects = m_lights[i]->GetAssociatedObjects();
+      for (set <CString>::iterator it = associatedObjects->begin(); it != associatedObjects->end(); it++)
+      {
+         CLightBitset &bitset = m_objects[*it];
+         if (bitset.empty())
+            bitset.resize(nbWords, 0);
+         bitset[i >> 5] |= 1u << (i & 31);
+      }
+   }
+}
+
+
+// Resolve a bitset into the light nodes affecting its objects.
+// The result is computed only once for each distinct bitset
+//
+// @param in_bitset     the lights the objects are associated with
+//
+// @return the light nodes
+//
+const vector <AtNode*>& CLightGroupTable::GetGroupNodes(const CLightBitset &in_bitset)
+{
+   map <CLightBitset, vector <AtNode*> >::iterator it = m_groups.find(in_bitset);
+   if (it != m_groups.end())
+      return it->second;
+
+   vector <AtNode*> &lightsVector = m_groups[in_bitset];
+   for (unsigned int i=0; i<(unsigned int)m_lights.size(); i++)
+   {
+      CLight *p_light = m_lights[i];
+      vector <AtNode*> *p_nodes = p_light->GetAllNodes();
+      if (!p_nodes)
+         continue;
+
+      bool add(true);
+      if (p_light->m_hasMembers)
+      {
+         bool isMember = !in_bitset.empty() && (in_bitset[i >> 5] & (1u << (i & 31)));
+         // if inclusive, add the light if the object is a member, else if it is not
+         add = p_light->m_isInclusive == isMember;
+      }
+
+      if (add)
+         lightsVector.insert(lightsVector.end(), p_nodes->begin(), p_nodes->end());
+   }
+
+   return lightsVector;
+}
+
+
+// Return an array of lights node pointers that affect the object
+//
+// @param in_xsiObj       the xsi object to look for
+//
+// @return the array of the lights (AtNode*)s influencing the object's lighting, or NULL if no light exploits association
+//
+AtArray* CLightGroupTable::GetLightGroup(const X3DObject &in_xsiObj)
+{
+   if (!m_hasMembers)
+      return NULL;
+
+   map <CString, CLightBitset>::iterator it = m_objects.find(in_xsiObj.GetFullName());
+   const vector <AtNode*> &lightsVector = GetGroupNodes(it != m_objects.end() ? it->second : CLightBitset());
+
+   // Each node owns its arrays, so the shapes sharing the group get a copy of the resolved vector
+   if (lightsVector.size() > 0)
+      return AiArrayConvert((int)lightsVector.size(), 1, AI_TYPE_NODE, &lightsVector[0]);
+   return AiArrayAllocate(0, 1, AI_TYPE_NODE); // to avoid a NULL pointer
+}
+
+
 // Do the full shape/lights association
 //
 // @param in_frame       the frame time
@@ -695,6 +805,10 @@ void DoFullLightAssociation(double in_frame)
    families.Add(siGeometryFamily);
 
    CRefArray shapesArray = Application().GetActiveSceneRoot().FindChildren(L"", L"", families, true);
+
+   // precompute the light groups of all the objects at once
+   CLightGroupTable lightGroupTable;
+   lightGroupTable.Build(GetRenderInstance()->LightMap());
     
    LONG nbShapes = shapesArray.GetCount();
    for (LONG ishape=0; ishape<nbShapes; ishape++)
@@ -714,6 +828,10 @@ void DoFullLightAssociation(double in_frame)
             nodes = *tempV;
       }
 
+      // the lights for which the shape is inclusive/exclusive, shared by all its nodes
+      AtArray* light_group = NULL;
+      bool lightGroupResolved(false);
+
       for (nodeIter=nodes.begin(); nodeIter!=nodes.end(); nodeIter++)
       {
          shapeNode = *nodeIter;
@@ -722,19 +840,21 @@ void DoFullLightAssociation(double in_frame)
          if (CNodeUtilities().GetEntryType(shapeNode) == L"light")
             continue;
 
-         // Resetting 
-         CNodeSetter::SetBoolean(shapeNode, "use_light_group", false);
-         AiNodeSetArray(shapeNode, "light_group", AiArrayAllocate(0, 0, AI_TYPE_NODE));
-         // loops all the lights and return those for which the shape is inclusive/exclusive
-         AtArray* light_group = GetRenderInstance()->LightMap().GetLightGroup(xsiObj);
-         if (light_group)
+         if (!lightGroupResolved)
          {
-            CNodeSetter::SetBoolean(shapeNode, "use_light_group", true);
-            if (AiArrayGetNumElements(light_group) > 0)
-               AiNodeSetArray(shapeNode, "light_group", light_group);
+            light_group = lightGroupTable.GetLightGroup(xsiObj);
+            lightGroupResolved = true;
          }
+
+         CNodeSetter::SetBoolean(shapeNode, "use_light_group", light_group != NULL);
+         if (light_group && AiArrayGetNumElements(light_group) > 0)
+            AiNodeSetArray(shapeNode, "light_group", AiArrayCopy(light_group));
+         else // resetting
+            AiNodeSetArray(shapeNode, "light_group", AiArrayAllocate(0, 0, AI_TYPE_NODE));
       }
 
+      if (light_group)
+         AiArrayDestroy(light_group);
       nodes.clear();
    }
 }
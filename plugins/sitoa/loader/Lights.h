@@ -138,6 +138,8 @@ public:
    bool AtLeastOneLightHasMembers();
    // Get an array of lights node pointers that affects the object
    AtArray* GetLightGroup(const X3DObject &in_xsiObj);
+   // Get the pointers to all the lights, in the map order
+   void GetLights(vector <CLight*> &out_lights);
    // Cycle all the lights and erase a light node from the nodes belonging to the lights
    void EraseNode(AtNode *in_node);
    // Erase an object from the association set of all the lights
@@ -151,6 +153,40 @@ public:
 };
 
 
+// The light groups of all the objects, precomputed for the full shape/lights association.
+// Each light gets a dense index, and each associated object a bitset over those indices, so that
+// the light group of an object costs a single lookup, instead of a search in the association set of each light.
+// Objects with the same bitset share the same resolved vector of light nodes.
+class CLightGroupTable
+{
+private:
+   typedef vector <unsigned int> CLightBitset;
+
+   vector <CLight*>                          m_lights;     // the lights, by dense index
+   bool                                      m_hasMembers; // does at least one light exploit association?
+   map <CString, CLightBitset>               m_objects;    // the lights each object is associated with
+   map <CLightBitset, vector <AtNode*> >     m_groups;     // the light nodes of each distinct bitset
+
+   // Resolve a bitset into the light nodes affecting its objects
+   const vector <AtNode*>& GetGroupNodes(const CLightBitset &in_bitset);
+
+public:
+   CLightGroupTable() : m_hasMembers(false)
+   {}
+
+   ~CLightGroupTable()
+   {
+      m_objects.clear();
+      m_groups.clear();
+   }
+
+   // Build the table from the lights in the map
+   void Build(CLightMap &in_lightMap);
+   // Get an array of lights node pointers that affects the object
+   AtArray* GetLightGroup(const X3DObject &in_xsiObj);
+};
+
+
 // Search all XSI lights to load into Arnold
 CStatus LoadLights(double in_frame, CRefArray &in_selectedObjs, bool in_selectionOnly = false);
 // Load Light of type "Point" into Arnold
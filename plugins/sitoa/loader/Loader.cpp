@@ -10,6 +10,7 @@ See the License for the specific language governing permissions and limitations
 ************************************************************************************************************************************/
 
 #include "common/Tools.h"
+#include "loader/AsyncAssWriter.h"
 #include "loader/Cameras.h"
 #include "loader/Hairs.h"
 #include "loader/Instances.h"
@@ -19,6 +20,7 @@ See the License for the specific language governing permissions and limitations
 #include "loader/Shaders.h"
 #include "loader/Procedurals.h"
 #include "loader/Operators.h"
+#include "loader/StaticShapes.h"
 #include "renderer/RenderMessages.h"
 #include "renderer/Renderer.h"
 
@@ -31,9 +33,92 @@ See the License for the specific language governing permissions and limitations
 #include <xsi_selection.h>
 #include <xsi_uitoolkit.h>
 
+#include <chrono>
 #include <ctime>
 
 
+// Wall clock times of the export stages of a frame.
+// Each stage is split into the gather time (the main thread reading the scene) and the merge time
+// (the export jobs run by the workers, if the parallel export is enabled, and their commit).
+class CExportStageTimes
+{
+private:
+   vector <CString> m_names;
+   vector <double>  m_gatherTimes, m_mergeTimes;
+   chrono::steady_clock::time_point m_start;
+
+   double Elapsed() const
+   {
+      return chrono::duration<double>(chrono::steady_clock::now() - m_start).count();
+   }
+
+public:
+   void Clear()
+   {
+      m_names.clear();
+      m_gatherTimes.clear();
+      m_mergeTimes.clear();
+   }
+
+   // Start timing a stage
+   void Start()
+   {
+      m_start = chrono::steady_clock::now();
+   }
+
+   // End the gather part of a stage, flush the pending export jobs and store the times
+   void End(const CString &in_name)
+   {
+      double gatherTime = Elapsed();
+      m_start = chrono::steady_clock::now();
+      GetRenderInstance()->ExportJobQueue().Flush();
+
+      m_names.push_back(in_name);
+      m_gatherTimes.push_back(gatherTime);
+      m_mergeTimes.push_back(Elapsed());
+   }
+
+   // Log the times of all the stages
+   void Log(double in_frame) const
+   {
+      GetMessageQueue()->LogMsg(L"[sitoa] Frame " + CValue(in_frame).GetAsText() + L" export stages (" + 
+                                CValue((LONG)CWorkerPool::GetNbThreads()).GetAsText() + L" threads):");
+      for (size_t i = 0; i < m_names.size(); i++)
+         GetMessageQueue()->LogMsg(L"[sitoa]   " + m_names[i] + L": gather " + CValue(m_gatherTimes[i]).GetAsText() + 
+                                   L" sec., merge " + CValue(m_mergeTimes[i]).GetAsText() + L" sec.");
+   }
+};
+
+
+// Return the name of the .ass file to be written for a frame (includes .gz if compressed is true)
+//
+// @param in_filename        The filename passed to LoadScene
+// @param in_outputAssDir    The output directory, used if in_filename is empty
+// @param in_frame           The frame time
+//
+// @return the .ass file name
+//
+static CPathString GetAssOutputName(const CString &in_filename, const CPathString &in_outputAssDir, double in_frame)
+{
+   CPathString assOutputName;
+   if (!in_filename.IsEmpty())
+   {
+      assOutputName = in_filename;
+      if (GetRenderOptions()->m_compress_output_ass) // compressed ?
+         assOutputName+= ".gz";
+   }
+   else
+   {
+      CTime frametime(in_frame);
+      assOutputName = in_outputAssDir + CUtils::Slash() + CPathUtilities().GetOutputExportFileName(true, true, frametime);
+   }
+
+   // #1467
+   assOutputName.ResolveTokensInPlace(in_frame);
+   return assOutputName;
+}
+
+
 CStatus LoadScene(const Property &in_arnoldOptions, const CString& in_renderType, double in_frameIni, double in_frameEnd, LONG in_frameStep, 
                   bool in_createStandIn, bool in_useProgressBar, CString in_filename, bool in_selectionOnly, CRefArray in_objects, bool in_recurse)
 {
@@ -99,6 +184,7 @@ CStatus LoadScene(const Property &in_arnoldOptions, const CString& in_renderType
 
    // Clocks for Time statistics
    clock_t loadStart(0), loadEnd(0), dumpStart(0), dumpEnd(0);
+   CExportStageTimes stageTimes;
    // Progress bar
    ProgressBar progressBar;
 
@@ -131,6 +217,8 @@ CStatus LoadScene(const Property &in_arnoldOptions, const CString& in_renderType
    // Initializing translations paths tables (only to export to ass)
    if (!toRender && useTranslation)
       InitializePathTranslator();
+   // the .tx files may have been created or deleted since the last export
+   CPathTranslator::ClearFileExistenceCache();
 
    // The PlayControl property set is stored with scene data under the project
    Property playctrl = app.GetActiveProject().GetProperties().GetItem(L"Play Control");
@@ -174,11 +262,61 @@ CStatus LoadScene(const Property &in_arnoldOptions, const CString& in_renderType
    }
 
    bool enableDisplayDriver = in_renderType == L"Region" || CSceneUtilities::DisplayRenderedImage();
+   // compresses the .ass.gz files while the next frames are loaded
+   CAsyncAssWriter assWriter;
+   // true if at least one frame could not be written
+   bool assWriteFailed(false);
+   if (!toRender && in_useProgressBar)
+      assWriter.SetProgressBar(&progressBar);
+
+   // .ass sequences: export the polymeshes that don't change over the frame range only once, into 
+   // an include file referenced by all the frames
+   GetStaticShapes().Clear();
+   if (!toRender && !in_createStandIn && in_frameEnd > in_frameIni && 
+       GetRenderOptions()->m_static_geometry_include && output_geometry == AI_NODE_SHAPE)
+   {
+      if (in_useProgressBar)
+         progressBar.PutCaption(L"Exporting Static Geometry");
+
+      playctrl.PutParameterValue(L"Current", in_frameIni);
+      GetRenderInstance()->SetFrame(in_frameIni);
+
+      GetStaticShapes().Classify(in_frameIni, in_frameEnd, in_frameStep, selectedObjs, in_selectionOnly);
+      if (GetStaticShapes().GetCount() > 0)
+      {
+         CPathString includeName = GetAssOutputName(in_filename, outputAssDir, in_frameIni).GetStaticAss();
+         if (includeName.IsVoid())
+         {
+            GetMessageQueue()->LogMsg(L"[sitoa] Static Geometry Include disabled, the output file is not a .ass file", siWarningMsg);
+            GetStaticShapes().Clear();
+         }
+         else
+         {
+            status = GetStaticShapes().WriteInclude(in_arnoldOptions, includeName, in_frameIni, selectedObjs, in_selectionOnly);
+            if (status == CStatus::Abort)
+            {
+               GetStaticShapes().Clear();
+               if (useTranslation)
+                  CPathTranslator::Destroy();
+               return status;
+            }
+            else if (status != CStatus::OK)
+            {
+               // export the static polymeshes with each frame, as if the include was disabled
+               GetMessageQueue()->LogMsg(L"[sitoa] Static Geometry Include disabled, failed writing " + includeName, siWarningMsg);
+               GetStaticShapes().Clear();
+            }
+         }
+      }
+   }
 
    for (double iframe = in_frameIni; iframe <= in_frameEnd; iframe += in_frameStep)
    {
       if (GetRenderInstance()->InterruptRenderSignal())
+      {
+         GetStaticShapes().Clear();
          return CStatus::Abort;
+      }
 
       if (toRender) 
       {
@@ -190,6 +328,12 @@ CStatus LoadScene(const Property &in_arnoldOptions, const CString& in_renderType
 
       // Setting time to statistics
       loadStart = clock();
+      stageTimes.Clear();
+      // the transformations of the previous frame are no longer valid, also in flythrough mode
+      GetRenderInstance()->TransformCache().Clear();
+      GetRenderInstance()->PolymeshShareCache().Clear();
+      // if enabled, defer the parallelizable part of the export to the worker threads
+      GetRenderInstance()->ExportJobQueue().SetDeferred(GetRenderOptions()->m_parallel_export);
 
       AiBegin(GetSessionMode());
       // Setting Log Level
@@ -236,6 +380,8 @@ CStatus LoadScene(const Property &in_arnoldOptions, const CString& in_renderType
          GetRenderInstance()->GetDisplayDriver()->CreateDisplayDriver();
 
       AiMsgDebug("[sitoa] Start Loading Scene");
+      // read each parameter only once while loading this frame
+      GetParameterCache().Enable(true);
 
       ////////////////////////////////////
       // Loading Options
@@ -265,6 +411,7 @@ CStatus LoadScene(const Property &in_arnoldOptions, const CString& in_renderType
       if (!in_createStandIn)
       {
          AiMsgDebug("[sitoa] Loading Operators");
+         stageTimes.Start();
          status = LoadPassOperator(iframe);
 
          if (progressBar.IsCancelPressed() || status == CStatus::Abort)
@@ -272,12 +419,14 @@ CStatus LoadScene(const Property &in_arnoldOptions, const CString& in_renderType
             AbortFrameLoadScene();
             break;
          }
+         stageTimes.End(L"Operators");
       }
 
       //////////// Cameras //////////// 
       if (!in_createStandIn && output_cameras == AI_NODE_CAMERA)
       {
          AiMsgDebug("[sitoa] Loading Cameras");
+         stageTimes.Start();
          status = LoadCameras(iframe);
 
          if (progressBar.IsCancelPressed() || status == CStatus::Abort)
@@ -285,12 +434,14 @@ CStatus LoadScene(const Property &in_arnoldOptions, const CString& in_renderType
             AbortFrameLoadScene();
             break;
          }
+         stageTimes.End(L"Cameras");
       }
 
       //////////// Pass shaders //////////// 
       if (!in_createStandIn && output_shaders == AI_NODE_SHADER)
       {
          AiMsgDebug("[sitoa] Loading ShaderStack");
+         stageTimes.Start();
          status = LoadPassShaders(iframe, in_selectionOnly);
 
          if (progressBar.IsCancelPressed() || status == CStatus::Abort)
@@ -298,12 +449,14 @@ CStatus LoadScene(const Property &in_arnoldOptions, const CString& in_renderType
             AbortFrameLoadScene();
             break;
          }
+         stageTimes.End(L"Pass Shaders");
       }
 
       //////////// Lights //////////// 
       if (output_lights == AI_NODE_LIGHT)
       {
          AiMsgDebug("[sitoa] Loading Lights");
+         stageTimes.Start();
          status = LoadLights(iframe, selectedObjs, in_selectionOnly);
 
          if (progressBar.IsCancelPressed() || status == CStatus::Abort)
@@ -311,12 +464,14 @@ CStatus LoadScene(const Property &in_arnoldOptions, const CString& in_renderType
             AbortFrameLoadScene();
             break;
          }
+         stageTimes.End(L"Lights");
       }
 
       //////////// Polymeshes //////////// 
       if (output_geometry == AI_NODE_SHAPE || output_shaders == AI_NODE_SHADER)
       {
          AiMsgDebug("[sitoa] Loading Polymeshes");
+         stageTimes.Start();
          status = LoadPolymeshes(iframe, selectedObjs, in_selectionOnly);
 
          if (progressBar.IsCancelPressed() || status == CStatus::Abort)
@@ -324,12 +479,14 @@ CStatus LoadScene(const Property &in_arnoldOptions, const CString& in_renderType
             AbortFrameLoadScene();
             break;
          }
+         stageTimes.End(L"Polymeshes");
       }
 
       //////////// Hair //////////// 
       if (output_geometry == AI_NODE_SHAPE || output_shaders == AI_NODE_SHADER)
       {
          AiMsgDebug("[sitoa] Loading Hairs");
+         stageTimes.Start();
          status = LoadHairs(iframe, selectedObjs, in_selectionOnly);
 
          if (progressBar.IsCancelPressed() || status == CStatus::Abort)
@@ -337,24 +494,28 @@ CStatus LoadScene(const Property &in_arnoldOptions, const CString& in_renderType
             AbortFrameLoadScene();
             break;
          }
+         stageTimes.End(L"Hairs");
       }
 
       //////////// ICE //////////// 
       if (output_geometry == AI_NODE_SHAPE || output_shaders == AI_NODE_SHADER)
       {
          AiMsgDebug("[sitoa] Loading ICE");
+         stageTimes.Start();
          status = LoadPointClouds(iframe, selectedObjs, in_selectionOnly);
          if (progressBar.IsCancelPressed() || status == CStatus::Abort)
          {
             AbortFrameLoadScene();
             break;
          }
+         stageTimes.End(L"ICE");
       }
       
       //////////// Instances //////////// 
       if (output_geometry == AI_NODE_SHAPE || output_shaders == AI_NODE_SHADER)
       {
          AiMsgDebug("[sitoa] Loading Instances");
+         stageTimes.Start();
          status = LoadInstances(iframe, selectedObjs, in_selectionOnly);
 
          if (progressBar.IsCancelPressed() || status == CStatus::Abort)
@@ -362,8 +523,18 @@ CStatus LoadScene(const Property &in_arnoldOptions, const CString& in_renderType
             AbortFrameLoadScene();
             break;
          }
+         stageTimes.End(L"Instances");
       }
 
+      GetRenderInstance()->ExportJobQueue().SetDeferred(false);
+
+      // now that the export jobs are done, the meshes have their final arrays
+      LogSharedPolymeshes();
+
+      //////////// Static Geometry Include //////////// 
+      if (GetStaticShapes().GetCount() > 0)
+         GetStaticShapes().LoadIncludeReference(iframe);
+
       status = PostLoadOptions(in_arnoldOptions, iframe);
 
       // Write the plugin_searchpath in the options node
@@ -376,33 +547,31 @@ CStatus LoadScene(const Property &in_arnoldOptions, const CString& in_renderType
 
       loadEnd = clock(); // time for statistics
 
+      GetParameterCache().Enable(false);
+      GetParameterCache().LogCounters(L"Frame " + CValue(iframe).GetAsText());
+
+      if (GetRenderOptions()->m_parallel_export)
+         stageTimes.Log(iframe);
+
       if (!toRender)
       {
          dumpStart = clock();
 
          // Getting ass output file name (includes .gz if compressed is true)
-         if (!in_filename.IsEmpty())
-         {
-            assOutputName = in_filename;
-            if (GetRenderOptions()->m_compress_output_ass) // compressed ?
-               assOutputName+= ".gz";
-         }
-         else
-         {
-            CTime frametime(iframe);
-            assOutputName = outputAssDir + CUtils::Slash() + CPathUtilities().GetOutputExportFileName(true, true, frametime);
-         }
-
-         // #1467
-         assOutputName.ResolveTokensInPlace(iframe);
+         assOutputName = GetAssOutputName(in_filename, outputAssDir, iframe);
 
          AiMsgDebug("[sitoa] Writing ASS file");
 
-         AiASSWrite(assOutputName.GetAsciiString(), 
-                    output_cameras + output_drivers_filters + output_lights + output_options + output_geometry + output_shaders + output_operators, 
-                    GetRenderOptions()->m_open_procs,
-                    GetRenderOptions()->m_binary_ass
-                   );
+         if (!assWriter.Write(assOutputName, 
+                              output_cameras + output_drivers_filters + output_lights + output_options + output_geometry + output_shaders + output_operators, 
+                              GetRenderOptions()->m_open_procs,
+                              GetRenderOptions()->m_binary_ass,
+                              iframe
+                             ))
+         {
+            GetMessageQueue()->LogMsg(L"[sitoa] Frame " + CValue(iframe).GetAsText() + L": failed writing " + assOutputName, siErrorMsg);
+            assWriteFailed = true;
+         }
 
          AiEnd();
 
@@ -446,7 +615,9 @@ CStatus LoadScene(const Property &in_arnoldOptions, const CString& in_renderType
          GetMessageQueue()->LogMsg(L"[sitoa] Frame " + CValue(iframe).GetAsText()    + L" exported" +
                         L" (to Arnold: "  + CValue(loadDelay).GetAsText() + L" sec.)" +
                         L" (to .ass: "    + CValue(dumpDelay).GetAsText() + L" sec.)");
-                                
+
+         // log the previous frames that were compressed meanwhile
+         assWriter.Poll();
       }
       else
       {
@@ -464,10 +635,22 @@ CStatus LoadScene(const Property &in_arnoldOptions, const CString& in_renderType
          GetRenderInstance()->DestroyScene(false);
    }
 
+   GetStaticShapes().Clear();
+
+   if (assWriter.GetPendingCount() > 0)
+   {
+      if (in_useProgressBar)
+         progressBar.PutCaption(L"Compressing ASS Files");
+      assWriter.Finish();
+   }
+
     // Destroying Translations Paths tables
    if (!toRender && useTranslation)
       CPathTranslator::Destroy();
 
+   if (assWriteFailed)
+      return CStatus::Fail;
+
    return status;
 }
 
@@ -475,6 +658,11 @@ CStatus LoadScene(const Property &in_arnoldOptions, const CString& in_renderType
 void AbortFrameLoadScene()
 {
    GetMessageQueue()->LogMsg(L"[sitoa] Export process aborted");
+   GetParameterCache().Enable(false);
+   // drop the pending export jobs, and go back to the immediate mode
+   GetRenderInstance()->ExportJobQueue().Clear();
+   GetRenderInstance()->ExportJobQueue().SetDeferred(false);
+   GetRenderInstance()->PolymeshShareCache().Clear();
    AiEnd();
 }
 
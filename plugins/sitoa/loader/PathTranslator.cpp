@@ -21,6 +21,12 @@ See the License for the specific language governing permissions and limitations
 #include <sstream>
 #include <sys/stat.h>
 
+#ifdef _WINDOWS
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
 
 // Resolve the xsi token (for instance [Frame]) at in_frame and returns the result
 CPathString CPathString::ResolveTokens(double in_frame, CString in_extraToken)
@@ -154,6 +160,19 @@ CPathString CPathString::GetAssToc()
 }
 
 
+// substitute .ass (or .ass.gz) with .static.ass (or .static.ass.gz)
+CPathString CPathString::GetStaticAss()
+{
+   CPathString result(L"");
+
+   ULONG index = this->ReverseFindString(L".ass", UINT_MAX);
+   if (index == this->Length() - 4 || index == this->Length() - 7) // .ass or .ass.gz
+      result = this->GetSubString(0, index) + L".static" + this->GetSubString(index, UINT_MAX);
+
+   return result;
+}
+
+
 // return true if this is an empty string, else false
 bool CPathString::IsVoid()
 {
@@ -774,10 +793,180 @@ void CImgSequencePathString::Log()
 }
 
 
+////////////////////////////////////////////////////
+////////////////////////////////////////////////////
+
+// Build the trie from the patterns of a path map
+//
+// @param in_map   the map of the pattern/translation pairs
+//
+void CPathPrefixTrie::Build(const pathMap &in_map)
+{
+   Clear();
+   for (pathMap::const_iterator it=in_map.begin(); it!=in_map.end(); it++)
+   {
+      unsigned int nodeIndex = 0;
+      for (size_t i=0; i<it->first.length(); i++)
+      {
+         map <char, unsigned int>::iterator child = m_nodes[nodeIndex].m_children.find(it->first[i]);
+         if (child != m_nodes[nodeIndex].m_children.end())
+            nodeIndex = child->second;
+         else
+         {
+            unsigned int newIndex = (unsigned int)m_nodes.size();
+            m_nodes[nodeIndex].m_children.insert(pair <char, unsigned int>(it->first[i], newIndex));
+            m_nodes.push_back(CNode());
+            nodeIndex = newIndex;
+         }
+      }
+      m_nodes[nodeIndex].m_pair = &(*it);
+   }
+}
+
+
+// Return the shortest pattern that is a prefix of in_path.
+// The shortest one is what the linear search over the (sorted) map used to return
+//
+// @param in_path   the path
+//
+// @return the matching pattern/translation pair, or NULL if no pattern matches
+//
+const pairMap* CPathPrefixTrie::FindPrefix(const string &in_path) const
+{
+   if (m_nodes[0].m_pair) // empty pattern
+      return m_nodes[0].m_pair;
+
+   unsigned int nodeIndex = 0;
+   for (size_t i=0; i<in_path.length(); i++)
+   {
+      map <char, unsigned int>::const_iterator child = m_nodes[nodeIndex].m_children.find(in_path[i]);
+      if (child == m_nodes[nodeIndex].m_children.end())
+         return NULL;
+      nodeIndex = child->second;
+      if (m_nodes[nodeIndex].m_pair)
+         return m_nodes[nodeIndex].m_pair;
+   }
+   return NULL;
+}
+
+
+// Clear the trie
+void CPathPrefixTrie::Clear()
+{
+   m_nodes.clear();
+   m_nodes.push_back(CNode()); // the root
+}
+
+
+////////////////////////////////////////////////////
+////////////////////////////////////////////////////
+
+// List a directory
+//
+// @param in_directory   the directory
+// @param out_files      the names of the files in the directory (lowercase on windows)
+//
+// @return false if the directory could not be listed
+//
+bool CFileExistenceCache::ListDirectory(const string &in_directory, set <string> &out_files)
+{
+#ifdef _WINDOWS
+   WIN32_FIND_DATAA findData;
+   HANDLE handle = FindFirstFileA((in_directory + "\\*").c_str(), &findData);
+   if (handle == INVALID_HANDLE_VALUE)
+      return false;
+   do
+   {
+      string name(findData.cFileName);
+      for (size_t i=0; i<name.length(); i++)
+         name[i] = (char)tolower(name[i]);
+      out_files.insert(name);
+   }
+   while (FindNextFileA(handle, &findData));
+   FindClose(handle);
+#else
+   DIR *dir = opendir(in_directory.c_str());
+   if (!dir)
+      return false;
+   struct dirent *entry;
+   while ((entry = readdir(dir)) != NULL)
+      out_files.insert(string(entry->d_name));
+   closedir(dir);
+#endif
+   return true;
+}
+
+
+// Return true if a file exists
+//
+// @param in_path   the file path
+//
+// @return true if the file exists
+//
+bool CFileExistenceCache::Exists(const string &in_path)
+{
+   size_t slashPos = in_path.find_last_of("/\\");
+   if (slashPos == string::npos || slashPos == in_path.length() - 1) // no directory, or not a file
+      return CPathUtilities().PathExists(in_path.c_str());
+
+   string directory = slashPos == 0 ? in_path.substr(0, 1) : in_path.substr(0, slashPos);
+   string fileName = in_path.substr(slashPos + 1);
+   string pathKey(in_path);
+#ifdef _WINDOWS
+   // the file system is case insensitive, so must be the keys
+   for (size_t i=0; i<fileName.length(); i++)
+      fileName[i] = (char)tolower(fileName[i]);
+   for (size_t i=0; i<directory.length(); i++)
+      directory[i] = (char)tolower(directory[i]);
+   for (size_t i=0; i<pathKey.length(); i++)
+      pathKey[i] = (char)tolower(pathKey[i]);
+#endif
+
+   bool result;
+   AiCritSecEnter(&m_cs);
+
+   map <string, set <string> >::iterator dirIt = m_directories.find(directory);
+   if (dirIt == m_directories.end())
+   {
+      set <string> files;
+      if (ListDirectory(directory, files))
+         dirIt = m_directories.insert(pair <string, set <string> >(directory, files)).first;
+   }
+
+   if (dirIt != m_directories.end())
+      result = dirIt->second.find(fileName) != dirIt->second.end();
+   else // the directory can't be listed (for instance it's not readable, or it does not exist)
+   {
+      map <string, bool>::iterator pathIt = m_paths.find(pathKey);
+      if (pathIt != m_paths.end())
+         result = pathIt->second;
+      else
+      {
+         result = CPathUtilities().PathExists(in_path.c_str());
+         m_paths.insert(pair <string, bool>(pathKey, result));
+      }
+   }
+
+   AiCritSecLeave(&m_cs);
+   return result;
+}
+
+
+// Clear the cache
+void CFileExistenceCache::Clear()
+{
+   AiCritSecEnter(&m_cs);
+   m_directories.clear();
+   m_paths.clear();
+   AiCritSecLeave(&m_cs);
+}
+
+
 ////////////////////////////////////////////////////
 ////////////////////////////////////////////////////
 
 pathMap CPathTranslator::m_PathMap; 
+CPathPrefixTrie CPathTranslator::m_PathTrie;
 bool CPathTranslator::m_Initialized = false; 
 unsigned int CPathTranslator::m_TranslationMode = TRANSLATOR_WIN_TO_LINUX; //win will write paths with the "/"
 
@@ -836,6 +1025,7 @@ bool CPathTranslator::Initialize(const char* in_linktabFile, unsigned int in_mod
          }
 
          file.close();
+         m_PathTrie.Build(m_PathMap);
          m_TranslationMode = in_mode;
          m_Initialized = true;
       }
@@ -883,7 +1073,7 @@ const char* CPathTranslator::TranslatePath(const char* in_path, bool in_replaceE
                startFramePath = startFramePath.GetSubString(0, dotIndex);
                startFramePath = startFramePath + L".tx";
                // GetMessageQueue()->LogMsg(L"startFramePath  = " + startFramePath);
-               if (!CPathUtilities().PathExists(startFramePath.GetAsciiString()))
+               if (!GetFileExistenceCache().Exists(startFramePath.GetAsciiString()))
                   doReplace = false;
             }
             if (doReplace) // survived the start frame existence
@@ -898,7 +1088,7 @@ const char* CPathTranslator::TranslatePath(const char* in_path, bool in_replaceE
                   endFramePath = endFramePath.GetSubString(0, dotIndex);
                   endFramePath = endFramePath + L".tx";
                   // GetMessageQueue()->LogMsg(L"End  = " + endFramePath);
-                  if (!CPathUtilities().PathExists(endFramePath.GetAsciiString()))
+                  if (!GetFileExistenceCache().Exists(endFramePath.GetAsciiString()))
                      doReplace = false;
                }
             }
@@ -937,7 +1127,7 @@ const char* CPathTranslator::TranslatePath(const char* in_path, bool in_replaceE
                size_t expandedTokenlastDotPos = expandedTokenStr.find_last_of('.');
                txPath = expandedTokenStr.substr(0, expandedTokenlastDotPos);
                txPath.append(".tx");
-               if (CPathUtilities().PathExists(txPath.c_str())) // the _u1_v1 or 1001 tx file exists, allow .tx for the original tokened path
+               if (GetFileExistenceCache().Exists(txPath)) // the _u1_v1 or 1001 tx file exists, allow .tx for the original tokened path
                {
                   txPath = str.substr(0, lastDotPos);
                   txPath.append(".tx");
@@ -951,7 +1141,7 @@ const char* CPathTranslator::TranslatePath(const char* in_path, bool in_replaceE
                txPath.append(".tx");
 
                // Attempt to get the file attributes
-               if (CPathUtilities().PathExists(txPath.c_str()))
+               if (GetFileExistenceCache().Exists(txPath))
                {  // the tx file exists, use this path
                   // "seq.7.png" -> "seq.7.tx"
                   str = txPath;
@@ -975,15 +1165,12 @@ const char* CPathTranslator::TranslatePath(const char* in_path, bool in_replaceE
             strComparison[i] = (char)tolower(strComparison[i]);
       }
          
-      for (pathMap::const_iterator it=m_PathMap.begin(); it!=m_PathMap.end(); it++)
+      const pairMap *match = m_PathTrie.FindPrefix(strComparison);
+      if (match)
       {
-         if ((int)strComparison.find(it->first) == 0)
-         {
-            // We will maintain the letter cases from the original path, so we only 
-            // are changing the "pattern" instead all path
-            str = it->second + str.substr(it->first.length());
-            break;
-         }
+         // We will maintain the letter cases from the original path, so we only 
+         // are changing the "pattern" instead all path
+         str = match->second + str.substr(match->first.length());
       }
    }
 
@@ -1019,6 +1206,7 @@ const char* CPathTranslator::TranslatePath(const char* in_path, bool in_replaceE
 void CPathTranslator::Destroy()
 {
    m_PathMap.clear();
+   m_PathTrie.Clear();
    m_Initialized = false;
    // fixing #1235
    m_TranslationMode = TRANSLATOR_WIN_TO_LINUX;
@@ -1039,6 +1227,22 @@ unsigned int CPathTranslator::GetTranslationMode()
 }
 
 
+// Forget the existence of the .tx files checked so far
+void CPathTranslator::ClearFileExistenceCache()
+{
+   GetFileExistenceCache().Clear();
+}
+
+
+// Return the existence cache of the .tx files.
+// Created on first use and not at static initialization, since its constructor calls Arnold
+CFileExistenceCache& CPathTranslator::GetFileExistenceCache()
+{
+   static CFileExistenceCache fileExistenceCache;
+   return fileExistenceCache;
+}
+
+
 /////////////////////////////////
 // Simple class for managing the missing shaders error messages
 /////////////////////////////////
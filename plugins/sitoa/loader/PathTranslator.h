@@ -19,6 +19,8 @@ See the License for the specific language governing permissions and limitations
 
 #include <xsi_string.h>
 
+#include <ai_critsec.h>
+
 #define TRANSLATOR_WIN_TO_LINUX     0
 #define TRANSLATOR_LINUX_TO_WIN     1
 
@@ -58,6 +60,8 @@ public:
    bool IsProcedural();
    // substitute .ass (or .ass.gz) with .asstoc
    CPathString GetAssToc();
+   // substitute .ass (or .ass.gz) with .static.ass (or .static.ass.gz)
+   CPathString GetStaticAss();
    // return true if this is an empty string, else false
    bool IsVoid();
    // Compute the number of chars for the root of this path.
@@ -150,6 +154,79 @@ public:
 typedef pair<string, string> pairMap;   
 typedef map<string, string> pathMap;
 
+
+// Prefix trie of the linktab patterns, so that the pattern matching a path is found
+// by walking the path chars once, instead of testing all the patterns
+class CPathPrefixTrie
+{
+private:
+   class CNode
+   {
+   public:
+      map <char, unsigned int> m_children; // child node index, by char
+      const pairMap           *m_pair;     // the pattern ending at this node, if any
+
+      CNode() : m_pair(NULL)
+      {}
+   };
+
+   vector <CNode> m_nodes; // m_nodes[0] is the root
+
+public:
+   CPathPrefixTrie()
+   {
+      Clear();
+   }
+
+   ~CPathPrefixTrie()
+   {
+      m_nodes.clear();
+   }
+
+   // Build the trie from the patterns of a path map
+   void Build(const pathMap &in_map);
+   // Return the shortest pattern that is a prefix of in_path, or NULL
+   const pairMap* FindPrefix(const string &in_path) const;
+   // Clear the trie
+   void Clear();
+};
+
+
+// Cache of the existence of files, used by the .tx substitution.
+// The first time a file of a directory is queried, the whole directory is listed, so that
+// the following queries on the same directory don't hit the file system (that can be a network share).
+// The cache must be cleared at each export, since the files may have changed in between
+class CFileExistenceCache
+{
+private:
+   // the file names of each listed directory
+   map <string, set <string> > m_directories;
+   // the paths checked by stat, for the directories that could not be listed
+   map <string, bool>          m_paths;
+   AtCritSec                   m_cs;
+
+   // List a directory. Return false if it could not be listed
+   bool ListDirectory(const string &in_directory, set <string> &out_files);
+
+public:
+   CFileExistenceCache()
+   {
+      AiCritSecInit(&m_cs);
+   }
+
+   ~CFileExistenceCache()
+   {
+      Clear();
+      AiCritSecClose(&m_cs);
+   }
+
+   // Return true if a file exists
+   bool Exists(const string &in_path);
+   // Clear the cache
+   void Clear();
+};
+
+
 // Class for Path Translations
 class CPathTranslator
 {
@@ -165,13 +242,20 @@ public:
    static bool IsInitialized();
    // return the translation mode (win->linux by default, since we write slashed pathes from windows)
    static unsigned int GetTranslationMode();
+   // Forget the existence of the .tx files checked so far
+   static void ClearFileExistenceCache();
 
 private:
 
+   // Return the existence cache of the .tx files, created on first use
+   static CFileExistenceCache& GetFileExistenceCache();
+
    // Custom implementation of strlwr 
    static char* strlwr(char* s);
    // Map to allocate the pairs
    static pathMap m_PathMap;
+   // The patterns of m_PathMap, compiled into a trie
+   static CPathPrefixTrie m_PathTrie;
    // If it is Initialized
    static bool m_Initialized;
    // Mode of Translation
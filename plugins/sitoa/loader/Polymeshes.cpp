@@ -10,11 +10,14 @@ See the License for the specific language governing permissions and limitations
 ************************************************************************************************************************************/
 
 #include "common/ParamsCommon.h"
+#include "common/WorkerPool.h"
+#include "loader/Instances.h"
 #include "loader/Loader.h"
 #include "loader/Polymeshes.h"
 #include "loader/Properties.h"
 #include "loader/Shaders.h"
 #include "loader/Procedurals.h"
+#include "loader/StaticShapes.h"
 #include "loader/Volume.h"
 #include "renderer/Renderer.h"
 #include "renderer/RendererOptions.h"
@@ -36,122 +39,20 @@ See the License for the specific language governing permissions and limitations
 
 #include <algorithm>
 
-inline int compareFloatN(const void *ptr1, const void *ptr2, int float_size)
-{
-    int v = 0;
-    int *p1 = (int*)ptr1;
-    int *p2 = (int*)ptr2;
-
-    while (float_size-- > 0 && v == 0)
-        v = *(p1++) - *(p2++);
-
-    return v;
-}
-
-inline bool equalFloat1(const void *ptr1, const void *ptr2, int /*float_size*/)
-{
-    return *(float*)ptr1 == *(float*)ptr2;
-}
-
-inline bool equalFloat2(const void *ptr1, const void *ptr2, int /*float_size*/)
-{
-    return *(uint64_t*)ptr1 == *(uint64_t*)ptr2;
-}
-
-inline bool equalFloat3(const void *ptr1, const void *ptr2, int /*float_size*/)
-{
-    // compare 64 + 32 bits
-    return *(uint64_t*)ptr1 == *(uint64_t*)ptr2 && *((float*)ptr1 + 2) == *((float*)ptr2 + 2);
-}
-
-inline bool equalFloat4(const void *ptr1, const void *ptr2, int /*float_size*/)
-{
-    // compare 64 + 64 bits
-    const uint64_t *di = (uint64_t*)ptr1;
-    const uint64_t *dj = (uint64_t*)ptr2;
-    return *di == *dj && *(di + 1) == *(dj + 1);
-}
-
-inline bool equalFloatN(const void *ptr1, const void *ptr2, int float_size)
-{
-    return compareFloatN(ptr1, ptr2, float_size) == 0;
-}
-
-/// IndexValue comparison functors for std::sort()
-struct IndexValueLessThanFloat1
-{
-    bool operator()(const IndexValue& i, const IndexValue& j)
-    {
-        return i.vidx == j.vidx ? *(float*)i.value < *(float*)j.value : i.vidx < j.vidx;
-    }
-};
-
-struct IndexValueLessThanFloat2
-{
-    bool operator()(const IndexValue& i, const IndexValue& j)
-    {
-        // compare 64 bits
-        return i.vidx == j.vidx ? *(uint64_t*)i.value < *(uint64_t*)j.value : i.vidx < j.vidx;
-    }
-};
-
-struct IndexValueLessThanFloat3
-{
-    bool operator()(const IndexValue& i, const IndexValue& j)
-    {
-        if (i.vidx == j.vidx)
-        {
-            // compare 64 + 32 bits
-            uint64_t *di = (uint64_t*)i.value;
-            uint64_t *dj = (uint64_t*)j.value;
-            return *di == *dj ? *((float*)i.value + 2) < *((float*)j.value + 2) : *di < *dj;
-        }
-        return i.vidx < j.vidx;
-    }
-};
-
-struct IndexValueLessThanFloat4
-{
-    bool operator()(const IndexValue& i, const IndexValue& j)
-    {
-        if (i.vidx == j.vidx)
-        {
-            // compare 64 + 64 bits
-            uint64_t *di = (uint64_t*)i.value;
-            uint64_t *dj = (uint64_t*)j.value;
-            return *di == *dj ? *(di + 1) < *(dj + 1) : *di < *dj;
-        }
-        return i.vidx < j.vidx;
-    }
-};
-
-struct IndexValueLessThanFloatN
-{
-    IndexValueLessThanFloatN(int float_size) : float_size(float_size) {}
-
-    bool operator()(const IndexValue& i, const IndexValue& j)
-    {
-        return i.vidx == j.vidx ? compareFloatN(i.value, j.value, float_size) < 0 : i.vidx < j.vidx;
-    }
-
-    int float_size; ///< size in 32bit floats
-};
-
-
 //////////////////////////////////////////////////
 //////////////////////////////////////////////////
 // CMesh class
 //////////////////////////////////////////////////
 //////////////////////////////////////////////////
 
-// Create the polymesh node and set the base class members
+// Set the base class members and evaluate the geometry accessor
 //
 // @param in_xsiObj         The Softimage object
 // @param in_frame          The frame time
 //
-// @return true is creation went ok, else false
+// @return false if the mesh has no polygons, else true
 //
-bool CMesh::Create(const X3DObject &in_xsiObj, double in_frame)
+bool CMesh::Init(const X3DObject &in_xsiObj, double in_frame)
 {
    m_xsiObj = in_xsiObj;
    m_properties = m_xsiObj.GetProperties();
@@ -180,16 +81,75 @@ bool CMesh::Create(const X3DObject &in_xsiObj, double in_frame)
                                                   m_useDiscontinuity, m_discontinuityAngle);
    m_nbVertices = m_geoAccessor.GetVertexCount(); 
    m_nbPolygons = m_geoAccessor.GetPolygonCount();
-   if (m_nbPolygons == 0)
+   return m_nbPolygons > 0;
+}
+
+
+// Create the polymesh node and set the base class members.
+// If io_shareCache is given, and an already exported mesh has the same source data, a ginstance of it
+// is created instead, and only ExportSharedInstance must be called (see IsShared)
+//
+// @param in_xsiObj         The Softimage object
+// @param in_frame          The frame time
+// @param io_shareCache     The exported meshes that can be shared, or NULL
+//
+// @return true is creation went ok, else false
+//
+bool CMesh::Create(const X3DObject &in_xsiObj, double in_frame, CPolymeshShareCache *io_shareCache)
+{
+   if (!Init(in_xsiObj, in_frame))
       return false;
 
-   m_node = AiNode("polymesh");
+   CheckIceTree();
+
+   // collect the source data only if an exported mesh has the same counts and bbox
+   CMeshPreKey preKey;
+   CMeshSource source;
+   bool hasSource(false);
+   bool canShare = io_shareCache && GetPreKey(in_frame, preKey);
+   if (canShare && io_shareCache->HasPreKey(preKey))
+   {
+      GetSource(in_frame, source);
+      hasSource = true;
+      m_sharedNode = io_shareCache->GetSharedNode(preKey, source, in_frame);
+   }
+
+   m_node = AiNode(m_sharedNode ? "ginstance" : "polymesh");
    CString name = CStringUtilities().MakeSItoAName(m_xsiObj, in_frame, L"", false);
    CNodeUtilities().SetName(m_node, name);
    CNodeSetter::SetInt(m_node, "id", CObjectUtilities().GetId(m_xsiObj));
       
    GetRenderInstance()->NodeMap().PushExportedNode(m_xsiObj, in_frame, m_node);
 
+   if (canShare && !m_sharedNode)
+      io_shareCache->Push(m_xsiObj, m_node, preKey, hasSource ? &source : NULL);
+
+   CheckIceNodeUserNormal();
+
+   return true;
+}
+
+
+// Attach to an already exported polymesh node, for an IPR geometry update.
+// The node is not re-created, and the Export* methods then just overwrite its arrays.
+//
+// @param in_xsiObj         The Softimage object
+// @param in_node           The polymesh node exported for in_xsiObj
+// @param in_frame          The frame time
+//
+// @return false if the node is not a polymesh (for instance a ginstance of an identical mesh, see CPolymeshShareCache)
+//         or if the mesh has no polygons, else true
+//
+bool CMesh::Update(const X3DObject &in_xsiObj, AtNode *in_node, double in_frame)
+{
+   if (!in_node || !AiNodeIs(in_node, ATSTRING::polymesh))
+      return false;
+   if (!Init(in_xsiObj, in_frame))
+      return false;
+
+   m_node = in_node;
+   m_isUpdate = true;
+
    CheckIceTree();
    CheckIceNodeUserNormal();
 
@@ -197,6 +157,100 @@ bool CMesh::Create(const X3DObject &in_xsiObj, double in_frame)
 }
 
 
+// Check if the topology (nsides and vidxs) of the attached node still matches the Softimage mesh.
+// If so, the points, normals, uvs and clusters can be updated in place
+//
+// @return true if the topology did not change, else false
+//
+bool CMesh::HasSameTopology()
+{
+   AtArray *nsides = AiNodeGetArray(m_node, "nsides");
+   AtArray *vidxs  = AiNodeGetArray(m_node, "vidxs");
+   AtArray *vlist  = AiNodeGetArray(m_node, "vlist");
+   if (!nsides || !vidxs || !vlist)
+      return false;
+   if (AiArrayGetNumElements(nsides) != (uint32_t)m_nbPolygons || AiArrayGetNumElements(vlist) != (uint32_t)m_nbVertices)
+      return false;
+
+   CLongArray polygonVerticesCount, vertexIndices;
+   m_geoAccessor.GetPolygonVerticesCount(polygonVerticesCount);
+   m_geoAccessor.GetVertexIndices(vertexIndices);
+   if (AiArrayGetNumElements(vidxs) != (uint32_t)vertexIndices.GetCount())
+      return false;
+
+   bool result = true;
+   const uint32_t* data = (const uint32_t*)AiArrayMap(nsides);
+   for (LONG i = 0; result && i < m_nbPolygons; i++)
+      result = data[i] == (uint32_t)polygonVerticesCount[i];
+   AiArrayUnmap(nsides);
+
+   data = (const uint32_t*)AiArrayMap(vidxs);
+   for (LONG i = 0; result && i < vertexIndices.GetCount(); i++)
+      result = data[i] == (uint32_t)vertexIndices[i];
+   AiArrayUnmap(vidxs);
+
+   if (result)
+      m_nbVertexIndices = vertexIndices.GetCount();
+   return result;
+}
+
+
+// Check if the materials of the attached node still match the Softimage mesh, ie if
+// the number of materials and the per polygon material indices (the polygon clusters) did not change.
+// To be called after CollectMaterials
+//
+// @return true if the materials did not change
+//
+bool CMesh::HasSameMaterials()
+{
+   AtArray *shaders = AiNodeGetArray(m_node, "shader");
+   uint32_t nbShaders = shaders ? AiArrayGetNumElements(shaders) : 0;
+   if (nbShaders != (uint32_t)m_nbMaterials)
+      return false;
+   if (m_nbMaterials < 2) // no shidxs
+      return true;
+
+   AtArray *shidxs = AiNodeGetArray(m_node, "shidxs");
+   CLongArray materialIndices;
+   m_geoAccessor.GetPolygonMaterialIndices(materialIndices);
+   if (!shidxs || AiArrayGetNumElements(shidxs) != (uint32_t)materialIndices.GetCount())
+      return false;
+
+   bool result = true;
+   const uint8_t* data = (const uint8_t*)AiArrayMap(shidxs);
+   for (LONG i = 0; result && i < materialIndices.GetCount(); i++)
+      result = data[i] == (uint8_t)materialIndices[i];
+   AiArrayUnmap(shidxs);
+   return result;
+}
+
+
+// Declare a user data. When updating an existing node, the data could have been
+// declared already by the previous export, in which case it's reused if its declaration 
+// did not change, else removed and declared again.
+//
+// @param in_name           The user data name
+// @param in_declaration    The declaration string, for instance "indexed VECTOR2"
+//
+// @return true if the data can be set, else false
+//
+bool CMesh::DeclareUserData(const char *in_name, const char *in_declaration)
+{
+   if (m_isUpdate)
+   {
+      const AtUserParamEntry *upentry = AiNodeLookUpUserParameter(m_node, in_name);
+      if (upentry)
+      {
+         if (GetUserParamaterDeclarationString(upentry) == in_declaration)
+            return true;
+         AiNodeResetParameter(m_node, in_name); // removes the user data
+      }
+   }
+
+   return AiNodeDeclare(m_node, in_name, in_declaration);
+}
+
+
 // Check if the mesh has an ICE tree, and set m_hasIceTree accordingly
 //
 void CMesh::CheckIceTree()
@@ -226,6 +280,194 @@ void CMesh::CheckIceNodeUserNormal()
 }
 
 
+// Add the values of the parameters of a property or primitive to the source data of a mesh
+//
+// @param in_item           The property or primitive
+// @param in_frame          The frame time
+// @param io_source         The source data
+//
+static void AddParameterValues(const ProjectItem &in_item, double in_frame, CMeshSource &io_source)
+{
+   io_source.m_strings.push_back(in_item.GetType() + L" " + in_item.GetName());
+   CParameterRefArray params = in_item.GetParameters();
+   for (LONG i=0; i<params.GetCount(); i++)
+   {
+      Parameter param(params[i]);
+      io_source.m_strings.push_back(param.GetScriptName() + L"=" + param.GetValue(in_frame).GetAsText());
+   }
+}
+
+
+// Add the values of an array to the source data of a mesh
+//
+// @param in_array          The array
+// @param in_count          The number of values
+// @param io_source         The source data
+//
+template <typename T>
+static void AddValues(const T* in_array, LONG in_count, CMeshSource &io_source)
+{
+   io_source.m_values.push_back((double)in_count);
+   io_source.m_values.insert(io_source.m_values.end(), in_array, in_array + in_count);
+}
+
+
+// Get the counts and bounding box of the mesh, that two meshes must share before their 
+// source data is collected and compared (see GetSource).
+// The meshes with an ICE tree, deformation motion blur, or Pref/Nref are not shared,
+// since their geometry also depends on data not collected by GetSource.
+//
+// @param in_frame          The frame time
+// @param out_preKey        The returned pre-key
+//
+// @return false if the mesh can't share its geometry
+//
+bool CMesh::GetPreKey(double in_frame, CMeshPreKey &out_preKey)
+{
+   if (m_hasIceTree || m_nbDefKeys > 1)
+      return false;
+   if (m_paramProperty.IsValid() && ((bool)ParAcc_GetValue(m_paramProperty, L"export_pref", in_frame) || 
+                                     (bool)ParAcc_GetValue(m_paramProperty, L"export_nref", in_frame)))
+      return false;
+
+   out_preKey.m_nbVertices = m_nbVertices;
+   out_preKey.m_nbPolygons = m_nbPolygons;
+   out_preKey.m_nbNodes = m_geoAccessor.GetNodeCount();
+   // in object space, so the transformation of the object does not matter
+   double *bbox = out_preKey.m_bbox;
+   return m_polyMesh.GetBoundingBox(bbox[0], bbox[1], bbox[2], bbox[3], bbox[4], bbox[5], CTransformation()) == CStatus::OK;
+}
+
+
+// Collect the Softimage data that the geometry arrays of the mesh are built from, so that 
+// two meshes with the same data can share the same polymesh node (see CPolymeshShareCache).
+// The data is only read from the Softimage mesh, no Arnold array is built.
+// The properties that drive the export (Arnold parameters, visibility, matte, etc.) are compared as a whole,
+// so the ginstance can copy them from the shared mesh.
+// Must be called only for the meshes that passed GetPreKey.
+//
+// @param in_frame          The frame time
+// @param out_source        The returned source data
+//
+void CMesh::GetSource(double in_frame, CMeshSource &out_source)
+{
+   out_source.m_values.push_back((double)m_useDiscontinuity);
+   out_source.m_values.push_back(m_discontinuityAngle);
+   out_source.m_values.push_back((double)m_subdivIterations);
+
+   Parameter subdruleParameter = m_primitive.GetParameter(L"subdrule");
+   if (subdruleParameter.IsValid())
+      out_source.m_values.push_back((double)subdruleParameter.GetValue(in_frame));
+
+   // points and topology
+   CDoubleArray points;
+   m_geoAccessor.GetVertexPositions(points);
+   AddValues(points.GetArray(), points.GetCount(), out_source);
+
+   CLongArray longValues;
+   m_geoAccessor.GetPolygonVerticesCount(longValues);
+   AddValues(longValues.GetArray(), longValues.GetCount(), out_source);
+   m_geoAccessor.GetVertexIndices(longValues);
+   AddValues(longValues.GetArray(), longValues.GetCount(), out_source);
+
+   // materials, that also give the displacement and the default uv set
+   CRefArray materials = m_geoAccessor.GetMaterials();
+   for (LONG i=0; i<materials.GetCount(); i++)
+   {
+      Material material(materials[i]);
+      out_source.m_strings.push_back(material.GetFullName());
+      ClusterProperty currentUV(material.GetCurrentUV());
+      out_source.m_strings.push_back(currentUV.IsValid() ? currentUV.GetName() : CString());
+      // the projection used by the texture, that can be an instance value (see ExportUVs)
+      Texture texture(material.GetCurrentTexture());
+      if (texture.IsValid())
+      {
+         Parameter tspace_id = ParAcc_GetParameter(texture, L"tspace_id");
+         if (!tspace_id.IsValid())
+            tspace_id = ParAcc_GetParameter(texture, L"tspaceid");
+         if (tspace_id.IsValid())
+            out_source.m_strings.push_back(tspace_id.GetInstanceValue(m_xsiObj.GetRef(), false).GetAsText());
+      }
+   }
+   m_geoAccessor.GetPolygonMaterialIndices(longValues);
+   AddValues(longValues.GetArray(), longValues.GetCount(), out_source);
+
+   // the clusters, with their uvs, weight maps, vertex colors, user normals and visibility
+   CRefArray clusters = m_polyMesh.GetClusters();
+   for (LONG i=0; i<clusters.GetCount(); i++)
+   {
+      Cluster cluster(clusters[i]);
+      out_source.m_strings.push_back(cluster.GetType() + L" " + cluster.GetName());
+      CLongArray elements = cluster.GetElements().GetArray();
+      AddValues(elements.GetArray(), elements.GetCount(), out_source);
+
+      Property visibilityProperty = cluster.GetLocalProperties().GetItem(L"Visibility");
+      if (visibilityProperty.IsValid())
+         AddParameterValues(visibilityProperty, in_frame, out_source);
+
+      CRefArray clusterProperties = cluster.GetProperties();
+      for (LONG j=0; j<clusterProperties.GetCount(); j++)
+      {
+         if (clusterProperties[j].GetClassID() != siClusterPropertyID)
+            continue;
+
+         ClusterProperty clusterProperty(clusterProperties[j]);
+         AddParameterValues(clusterProperty, in_frame, out_source);
+         CDoubleArray values = clusterProperty.GetElements().GetArray();
+         AddValues(values.GetArray(), values.GetCount(), out_source);
+
+         if (clusterProperty.GetPropertyType() == siClusterPropertyUVType)
+         {
+            Primitive projectionDefinition = GetTextureProjectionDefFromTextureProjection(clusterProperty);
+            if (projectionDefinition.IsValid())
+               AddParameterValues(projectionDefinition, in_frame, out_source);
+         }
+      }
+   }
+
+   // creases
+   CEdgeRefArray edges = m_polyMesh.GetEdges();
+   CBoolArray hardEdges = edges.GetIsHardArray();
+   for (LONG i=0; i<hardEdges.GetCount(); i++)
+      out_source.m_values.push_back((double)hardEdges[i]);
+   CDoubleArray creases = edges.GetCreaseArray();
+   AddValues(creases.GetArray(), creases.GetCount(), out_source);
+   creases = m_polyMesh.GetVertices().GetCreaseArray();
+   AddValues(creases.GetArray(), creases.GetCount(), out_source);
+
+   // the properties read by the Export* methods. For the blobs, just the names of the data
+   for (LONG i=0; i<m_properties.GetCount(); i++)
+   {
+      Property property(m_properties[i]);
+      CString type = property.GetType();
+      CString name = property.GetName();
+      if (type == L"UserDataBlob")
+         out_source.m_strings.push_back(type + L" " + name);
+      else if (type == L"TextureProp" || name == L"Visibility" || name == L"Geometry Approximation" || 
+               type.FindString(L"arnold_") == 0)
+         AddParameterValues(property, in_frame, out_source);
+   }
+}
+
+
+// Evaluate an exported Softimage mesh and collect its source data
+//
+// @param in_xsiObj         The Softimage object
+// @param in_frame          The frame time
+// @param out_source        The returned source data
+//
+// @return false if the mesh can't be evaluated
+//
+bool CMesh::GetSourceOf(const X3DObject &in_xsiObj, double in_frame, CMeshSource &out_source)
+{
+   if (!Init(in_xsiObj, in_frame))
+      return false;
+   CheckIceTree();
+   GetSource(in_frame, out_source);
+   return true;
+}
+
+
 // Check if the input uvs are homogenous, ie their w is the weight. For now, this only happens
 // in the case the projection was a camera projection.
 //
@@ -271,16 +513,24 @@ bool CMesh::AreUVsHomogenous(ClusterProperty &in_uvProperty, CDoubleArray &in_uv
 
 // Export nsides, the number of nodes per polygon
 //
-void CMesh::ExportPolygonVerticesCount()
+// @return false if the polygon count doesn't match the one of the mesh, else true
+//
+bool CMesh::ExportPolygonVerticesCount()
 {
    CLongArray polygonVerticesCountArray;
    m_geoAccessor.GetPolygonVerticesCount(polygonVerticesCountArray);
 
    AtArray *nsides = AiArrayAllocate(m_nbPolygons, 1, AI_TYPE_UINT);
-   for (LONG i = 0; i < m_nbPolygons; i++)
-      AiArraySetUInt(nsides, i, polygonVerticesCountArray[i]);      
+   if (!CBulkCopy::SetKey(nsides, polygonVerticesCountArray.GetArray(), (size_t)polygonVerticesCountArray.GetCount(), 0))
+   {
+      GetMessageQueue()->LogMsg(L"[sitoa] polygon count mismatch for " + m_xsiObj.GetFullName() + L": " + CValue(polygonVerticesCountArray.GetCount()).GetAsText() + 
+                                L" values, " + CValue(m_nbPolygons).GetAsText() + L" expected. Skipping.", siWarningMsg);
+      AiArrayDestroy(nsides);
+      return false;
+   }
 
    AiNodeSetArray(m_node, "nsides", nsides);
+   return true;
 }
 
 
@@ -320,6 +570,10 @@ bool CMesh::ExportIceVertices(AtArray *io_vlist)
    CDoubleArray transfKeysAtTimeZero, defKeysAtTimeZero;
    CSceneUtilities::GetMotionBlurData(m_xsiObj.GetRef(), transfKeysAtTimeZero, defKeysAtTimeZero, 0, true);
 
+   CIceAttributeView velocities = pointVelocityAttr.GetView();
+   if (velocities.m_eType != siICENodeDataVector3 || velocities.m_count == 0)
+      return false;
+
    m_geoAccessor.GetVertexPositions(pointsArray);
    CVector3f p, vel;
 
@@ -330,7 +584,7 @@ bool CMesh::ExportIceVertices(AtArray *io_vlist)
       {
          // point at in_frame
          p.Set((float)pointsArray[i*3], (float)pointsArray[i*3+1], (float)pointsArray[i*3+2]);
-         vel = pointVelocityAttr.m_isConstant ? pointVelocityAttr.m_v3Data[0] : pointVelocityAttr.m_v3Data[i];
+         vel = velocities.Get<CVector3f>(i);
          vel.ScaleInPlace(scaleFactor);
          p.AddInPlace(vel);
 
@@ -370,14 +624,17 @@ bool CMesh::RemoveMotionBlur(AtArray *in_vlist, AtArray *in_nlist, bool in_expor
          return false;
    }
 
-   AtVector  p;
+   uint32_t nbElements = AiArrayGetNumElements(in_vlist);
    // allocate a new vlist array with a single key
-   AtArray *vlist = AiArrayAllocate(AiArrayGetNumElements(in_vlist), 1, AI_TYPE_VECTOR);
+   AtArray *vlist = AiArrayAllocate(nbElements, 1, AI_TYPE_VECTOR);
    // copy the first key of the input array into the new array
-   for (unsigned int i=0; i<AiArrayGetNumElements(in_vlist); i++)
+   const float* firstKey = (const float*)AiArrayMap(in_vlist) + (size_t)in_firstKeyPosition * nbElements * 3;
+   bool copied = CBulkCopy::SetKey(vlist, firstKey, (size_t)nbElements * 3, 0);
+   AiArrayUnmap(in_vlist);
+   if (!copied)
    {
-      CUtilities().GetArrayValue(in_vlist, &p, i, in_firstKeyPosition);
-      CUtilities().SetArrayValue(vlist, p, i, 0);
+      AiArrayDestroy(vlist);
+      return false;
    }
    // we can destroy the old array, so the calling function, if still referencing it, MUST return
    AiArrayDestroy(in_vlist);
@@ -399,9 +656,10 @@ bool CMesh::RemoveMotionBlur(AtArray *in_vlist, AtArray *in_nlist, bool in_expor
 //
 // @param in_frame          The frame time
 //
-void CMesh::ExportVerticesAndNormals(double in_frame)
+// @return false if the points of the first key could not be exported, else true
+//
+bool CMesh::ExportVerticesAndNormals(double in_frame)
 {
-   AtVector point;
    CDoubleArray pointsArray;
 
    AtArray* vlist = AiArrayAllocate(m_nbVertices, (uint8_t)m_nbDefKeys, AI_TYPE_VECTOR);
@@ -462,16 +720,30 @@ void CMesh::ExportVerticesAndNormals(double in_frame)
             if (pointsCount != m_nbVertices)
             {
                GetMessageQueue()->LogMsg(L"[sitoa] point count mismatch for " + m_xsiObj.GetFullName() + " in the shutter interval. Disabling motion blur for the object", siWarningMsg);
-               RemoveMotionBlur(vlist, nlist, exportNormals, keysPosition[0]);
-               // return, RemoveMotionBlur sets vlist and nlist, and destroys the current arrays
-               return;
+               // RemoveMotionBlur sets vlist and destroys the current arrays, so return in any case
+               if (!RemoveMotionBlur(vlist, nlist, exportNormals, keysPosition[0]))
+               {
+                  AiArrayDestroy(vlist);
+                  if (nlist)
+                     AiArrayDestroy(nlist);
+               }
+               if (nidxs)
+                  AiArrayDestroy(nidxs);
+               return true;
             }
          }
 
-         for (LONG i = 0; i < m_nbVertices; i++)
+         // convert the whole key at once, straight into the vlist key
+         if (!CBulkCopy::SetKey(vlist, pointsArray.GetArray(), (size_t)pointsArray.GetCount(), keyPosition))
          {
-            CUtilities().S2A(pointsArray[i*3], pointsArray[i*3+1], pointsArray[i*3+2], point);
-            CUtilities().SetArrayValue(vlist, point, i, keyPosition);
+            // the first key sets m_nbVertices for the others, so a mismatch there means the mesh can't be exported
+            GetMessageQueue()->LogMsg(L"[sitoa] point count mismatch for " + m_xsiObj.GetFullName() + L" at frame " + CValue(defKeys[key]).GetAsText() + L". Skipping.", siWarningMsg);
+            AiArrayDestroy(vlist);
+            if (nlist)
+               AiArrayDestroy(nlist);
+            if (nidxs)
+               AiArrayDestroy(nidxs);
+            return false;
          }
       }
 
@@ -489,23 +761,34 @@ void CMesh::ExportVerticesAndNormals(double in_frame)
          else // Eric Mootz for #704
              GetGeoAccessorNormals(geoAccessorBlur, normalIndicesSize, nodeNormals);
 
-         AtVector normal;         
-         for (LONG i = 0, i3 = 0; i < normalIndicesSize; i++, i3+= 3)
+         if (!CBulkCopy::SetKey(nlist, nodeNormals.GetArray(), (size_t)nodeNormals.GetCount(), keyPosition))
          {
-            CUtilities().S2A(nodeNormals[i3], nodeNormals[i3 + 1], nodeNormals[i3 + 2], normal);
-            CUtilities().SetArrayValue(nlist, normal, i, keyPosition); 
+            if (key == 0) // no valid key to start from, let Arnold compute the normals
+            {
+               GetMessageQueue()->LogMsg(L"[sitoa] normal count mismatch for " + m_xsiObj.GetFullName() + L" at frame " + CValue(defKeys[key]).GetAsText() + 
+                                         L". Skipping the normals.", siWarningMsg);
+               AiArrayDestroy(nlist);
+               AiArrayDestroy(nidxs);
+               nlist = nidxs = NULL;
+               exportNormals = false;
+            }
+            else // no normal motion blur, repeat the first key
+            {
+               GetMessageQueue()->LogMsg(L"[sitoa] normal count mismatch for " + m_xsiObj.GetFullName() + L" at frame " + CValue(defKeys[key]).GetAsText() + 
+                                         L". Using the normals of frame " + CValue(defKeys[0]).GetAsText(), siWarningMsg);
+               CBulkCopy::CopyKey(nlist, keysPosition[0], keyPosition);
+            }
          }
       } // if exportNormals
    } // keys loop
 
    if (exportNormals)
    {
-      IndexMerge(nidxs, nlist);
-      AiNodeSetArray(m_node, "nidxs", nidxs);
-      AiNodeSetArray(m_node, "nlist", nlist);
+      MergeAndSetIndexedArray("nlist", nlist, "nidxs", nidxs);
    }
 
    AiNodeSetArray(m_node, "vlist", vlist);
+   return true;
 }
 
 
@@ -573,14 +856,23 @@ void CMesh::GetIceNodeUserNormals(PolygonMesh in_polyMesh, CFloatArray &out_node
    if (!nodeUserNormalAttr.Update())
       return; // ouch
 
-   LONG count = nodeUserNormalAttr.m_v3Data.GetCount();
+   CIceAttributeView normals = nodeUserNormalAttr.GetView();
+   if (normals.m_eType != siICENodeDataVector3)
+      return;
+
+   LONG count = normals.m_count;
    // this count should always by equal to the node indeces count
    out_nodeNormals.Resize(count*3);
+   if (count == 0)
+      return;
 
-   for (LONG i=0; i<count; i++)
+   if (normals.m_stride > 0) // copy the x,y,z floats in one go
+      CBulkCopy::Convert((const float*)normals.m_data, &out_nodeNormals[0], (size_t)count*3);
+   else
    {
-      CVector3f n = nodeUserNormalAttr.m_isConstant ? nodeUserNormalAttr.m_v3Data[0] : nodeUserNormalAttr.m_v3Data[i];
-      n.Get(out_nodeNormals[i*3], out_nodeNormals[i*3+1], out_nodeNormals[i*3+2]);
+      const CVector3f &n = normals.Get<CVector3f>(0);
+      for (LONG i=0; i<count; i++)
+         n.Get(out_nodeNormals[i*3], out_nodeNormals[i*3+1], out_nodeNormals[i*3+2]);
    }
 }
 
@@ -593,7 +885,7 @@ void CMesh::ExportMatrices()
    AtArray* matrices = AiArrayAllocate(1, (uint8_t)m_nbTransfKeys, AI_TYPE_MATRIX);
    for (LONG key=0; key<m_nbTransfKeys; key++)
    {
-      CUtilities().S2A(m_xsiObj.GetKinematics().GetGlobal().GetTransform(m_transfKeys[key]), matrix);
+      GetRenderInstance()->TransformCache().GetGlobalMatrix(m_xsiObj, m_transfKeys[key], matrix);
       AiArraySetMtx(matrices, key, matrix);
    }
 
@@ -635,14 +927,19 @@ void CMesh::ExportClusters()
                 continue;
             }
 
-            if (AiNodeDeclare(m_node, propName, "varying FLOAT"))
+            if (DeclareUserData(propName, "varying FLOAT"))
             {
                AtArray* propArray = AiArrayAllocate(nbValues, 1, AI_TYPE_FLOAT);         
                if (!propArray)
                   continue;
                
-               for (LONG i = 0; i < nbValues; i++) 
-                  AiArraySetFlt(propArray, i, (float)values[i]); 
+               if (!CBulkCopy::SetKey(propArray, values.GetArray(), (size_t)values.GetCount(), 0))
+               {
+                  GetMessageQueue()->LogMsg(L"[sitoa] Cluster size mismatch for " + propNameString + L": " + (CValue(values.GetCount()).GetAsText()) + 
+                                            L" values, " + (CValue(nbValues).GetAsText()) + " expected. Skipping.", siWarningMsg);
+                  AiArrayDestroy(propArray);
+                  continue;
+               }
 
                AiNodeSetArray(m_node, propName, propArray);
             }
@@ -657,22 +954,21 @@ void CMesh::ExportClusters()
                 continue;
             }
 
-            if (AiNodeDeclare(m_node, propName, "indexed RGBA"))
+            if (DeclareUserData(propName, "indexed RGBA"))
             {
                AtArray* colors  = AiArrayAllocate(m_nbVertexIndices, 1, AI_TYPE_RGBA);
-               AtArray* indices = NodeIndices();
-
-               for (LONG i = 0, i4 = 0; i < m_nbVertexIndices; i++, i4+= 4)
+               if (!CBulkCopy::SetKey(colors, values.GetArray(), (size_t)values.GetCount(), 0))
                {
-                  AtRGBA color = AtRGBA((float)values[i4], (float)values[i4 + 1], (float)values[i4 + 2], (float)values[i4 + 3]);
-                  AiArraySetRGBA(colors, i, color);
+                  GetMessageQueue()->LogMsg(L"[sitoa] Cluster size mismatch for " + propNameString + L": " + (CValue(values.GetCount()).GetAsText()) + 
+                                            L" values, " + (CValue(m_nbVertexIndices*4).GetAsText()) + " expected. Skipping.", siWarningMsg);
+                  AiArrayDestroy(colors);
+                  continue;
                }
 
-               IndexMerge(indices, colors);
+               AtArray* indices = NodeIndices();
 
-               AiNodeSetArray(m_node, propName, colors);
                CString idxName = CString(propName) + L"idxs";
-               AiNodeSetArray(m_node, idxName.GetAsciiString(), indices);
+               MergeAndSetIndexedArray(propName, colors, idxName.GetAsciiString(), indices);
             }
          }
          // else if (prop.GetPropertyType() == siClusterPropertyUVType)
@@ -845,11 +1141,13 @@ void CMesh::ExportCreases()
 }
 
 
-// Export the materials, ie the shaders and the displacement map
+// Collect the materials and the uv properties, needed by ExportUVs
 //
 // @param in_frame          The frame time
 //
-void CMesh::ExportMaterials(double in_frame)
+// @return true if ICE materials were found, else false
+//
+bool CMesh::CollectMaterials(double in_frame)
 {
    m_materialFrame = in_frame;
 
@@ -863,7 +1161,7 @@ void CMesh::ExportMaterials(double in_frame)
 
    bool hasICEMaterials(false);
 
-   long nbMaterialsObjLevel = m_materialsArray.GetCount();
+   m_nbObjectMaterials = m_materialsArray.GetCount();
    // ICE materials patch by Paul Hudson
    m_xsiIceGeo = CObjectUtilities().GetGeometryAtFrame(m_xsiObj, in_frame);
 
@@ -895,6 +1193,17 @@ void CMesh::ExportMaterials(double in_frame)
    }
 
    m_nbMaterials = m_materialsArray.GetCount();
+   return hasICEMaterials;
+}
+
+
+// Export the materials, ie the shaders and the displacement map
+//
+// @param in_frame          The frame time
+//
+void CMesh::ExportMaterials(double in_frame)
+{
+   bool hasICEMaterials = CollectMaterials(in_frame);
 
    AtArray *shaders = AiArrayAllocate(m_nbMaterials, 1, AI_TYPE_NODE);
 
@@ -947,7 +1256,7 @@ void CMesh::ExportMaterials(double in_frame)
          {
             for (ULONG d=0; d<matIdAttr.m_lData.GetCount(); d++)
                 if (matIdAttr.m_lData[d] > 0)
-                    AiArraySetByte(shidxs, d, (uint8_t)(matIdAttr.m_lData[d] + nbMaterialsObjLevel-1));
+                    AiArraySetByte(shidxs, d, (uint8_t)(matIdAttr.m_lData[d] + m_nbObjectMaterials-1));
          }
       }
 
@@ -1052,8 +1361,13 @@ AtArray* CMesh::LongArrayToUIntArray(const CLongArray &in_nodeIndices) const
 {
    LONG indicesSize = in_nodeIndices.GetCount();
    AtArray* indices = AiArrayAllocate(indicesSize, 1, AI_TYPE_UINT);
-   for (LONG i = 0; i < indicesSize; i++)
-      AiArraySetUInt(indices, i, in_nodeIndices[i]);
+   if (!CBulkCopy::SetKey(indices, in_nodeIndices.GetArray(), (size_t)indicesSize, 0))
+   {
+      // return an empty array, that fails the count checks of the callers
+      GetMessageQueue()->LogMsg(L"[sitoa] Could not convert the indices of " + m_xsiObj.GetFullName(), siWarningMsg);
+      AiArrayDestroy(indices);
+      indices = AiArrayAllocate(0, 1, AI_TYPE_UINT);
+   }
 
    return indices;
 }
@@ -1072,116 +1386,57 @@ AtArray* CMesh::NodeIndices()
 }
 
 
-// Merge vertex indices that have the same value on the same point in place.
-// For a value array with multiple mb keys, it's important to call this function only after
-// having collected all the keys, and NOT after each single key, because the input array
-// gets destroyed and resized.
+// The job merging an indexed array (see IndexMerge) and assigning it to the mesh node
+class CIndexMergeJob : public CWorkerJob
+{
+private:
+   AtNode*  m_node;
+   AtArray* m_vidxs;
+   AtArray* m_values;
+   AtArray* m_idxs;
+   CString  m_valuesName, m_idxsName;
+
+public:
+   CIndexMergeJob(AtNode* in_node, AtArray* in_vidxs, const char* in_valuesName, AtArray* in_values, const char* in_idxsName, AtArray* in_idxs) : 
+      m_node(in_node), m_vidxs(in_vidxs), m_values(in_values), m_idxs(in_idxs), m_valuesName(in_valuesName), m_idxsName(in_idxsName)
+   {}
+
+   ~CIndexMergeJob()
+   {
+      // not committed, for instance because the export was aborted
+      if (m_values)
+         AiArrayDestroy(m_values);
+      if (m_idxs)
+         AiArrayDestroy(m_idxs);
+   }
+
+   void Run()
+   {
+      IndexMerge(m_vidxs, m_idxs, m_values);
+   }
+
+   void Commit()
+   {
+      AiNodeSetArray(m_node, m_valuesName.GetAsciiString(), m_values);
+      AiNodeSetArray(m_node, m_idxsName.GetAsciiString(), m_idxs);
+      m_values = m_idxs = NULL;
+   }
+};
+
+
+// Merge an indexed array and assign it to the mesh node.
+// If the parallel export is enabled, the merge is run later by the export workers.
+// vidxs must already be set, since the merge depends on it.
 //
-// @param idxs indexed data indices to merge
-// @param values data values to merge
-// @param canonical assume the indices and values are canonical
+// @param in_valuesName  the name of the values parameter
+// @param in_values      the values array
+// @param in_idxsName    the name of the indices parameter
+// @param in_idxs        the indices array
 //
-void CMesh::IndexMerge(AtArray*& idxs, AtArray*& values, bool canonical) const
+void CMesh::MergeAndSetIndexedArray(const char* in_valuesName, AtArray* in_values, const char* in_idxsName, AtArray* in_idxs)
 {
-    AtArray* vidxs = AiNodeGetArray(m_node, "vidxs");
-
-    if (!vidxs || !idxs || !values)
-        return;
-
-    if (AiArrayGetNumElements(vidxs) != AiArrayGetNumElements(idxs))
-        return;
-
-    if (AiArrayGetNumElements(idxs) < 2 || AiArrayGetNumElements(values) < 2)
-        return;
-
-    const int type_size = AiParamGetTypeSize(AiArrayGetType(values));
-
-    if (type_size % 4) // storage class not float or int
-        return;
-
-    const int float_size = type_size / 4; // size in 32bit floats or ints
-
-    // create indexed values vector
-    const uint32_t index_count = AiArrayGetNumElements(idxs);
-    IndexValue* index_values = (IndexValue*)AiMalloc(sizeof(IndexValue) * index_count);
-
-    // initialize the indexed values, optimize if the indices are canonical,
-    // which is always the case in HtoA so far.
-    // index_values is filled with the first key of the values array only
-    if (canonical)
-        for (uint32_t i = 0; i < index_count; ++i)
-            index_values[i].set(i, INDEX_ARRAY(vidxs)[i], VALUE_AT(values, 0, i));
-    else
-        for (uint32_t i = 0; i < index_count; ++i)
-            index_values[i].set(i, INDEX_ARRAY(vidxs)[i], VALUE_AT(values, 0, INDEX_ARRAY(idxs)[i]));
-
-    // sort by vertex index and by data value for equal indices
-    switch (float_size)
-    {
-    case 1:  std::sort(index_values, index_values + index_count, IndexValueLessThanFloat1()); break;
-    case 2:  std::sort(index_values, index_values + index_count, IndexValueLessThanFloat2()); break;
-    case 3:  std::sort(index_values, index_values + index_count, IndexValueLessThanFloat3()); break;
-    case 4:  std::sort(index_values, index_values + index_count, IndexValueLessThanFloat4()); break;
-    default: std::sort(index_values, index_values + index_count, IndexValueLessThanFloatN(float_size)); break;
-    }
-
-    // count the number of unique pairs, and assign to first_unique the index to the first unique pair
-    IndexValue* it_prev = index_values;
-    IndexValue* it = it_prev + 1;
-    uint32_t value_count = 1;
-
-    bool (*equalFloatX)(const void *, const void *, int);
-    switch (float_size)
-    {
-    case 1:  equalFloatX = equalFloat1; break;
-    case 2:  equalFloatX = equalFloat2; break;
-    case 3:  equalFloatX = equalFloat3; break;
-    case 4:  equalFloatX = equalFloat4; break;
-    default: equalFloatX = equalFloatN; break;
-    }
-
-    for (uint32_t i = 1; i < index_count; ++it, ++i)
-    {
-        if (it->vidx == it_prev->vidx && equalFloatX(it->value, it_prev->value, float_size))
-            it->value_index = it_prev->value_index;
-        else
-        {
-            it->value_index = i;
-            it_prev = it;
-            ++value_count;
-        }
-    }
-
-    // nothing to merge, the caller will keep its original arrays
-    if (value_count == AiArrayGetNumElements(values))
-    {
-        AiFree(index_values);
-        return;
-    }
-
-    const uint32_t values_stride = arrayStride(values);
-    // write out compressed values array and update merged indices
-    AtArray* merged_values = AiArrayAllocate(value_count, AiArrayGetNumKeys(values), AiArrayGetType(values));
-
-    for (uint32_t i = 0, value_index = 0; i < index_count; ++i)
-    {
-        // unique value to be added to the returned value array, true for i == 0
-        if (i == index_values[i].value_index)
-        {
-            // All the keys are copied: key 0 from index_values[i].value, key k from the same pointer displaced by k * array_stride bytes.
-            // Note however that nkeys should be > 1 only when merging normals, other data should not be subject to motion blur.
-            for (uint8_t k = 0; k < AiArrayGetNumKeys(values); ++k)
-                memcpy(VALUE_AT(merged_values, k, value_index), (uint8_t*)index_values[i].value + k * values_stride, type_size);
-            value_index++;
-        }
-
-        // the index to be returned for the i-th vertex index points to the last added value
-        INDEX_ARRAY(idxs)[index_values[i].position] = value_index - 1;
-    }
-
-    AiFree(index_values);
-    AiArrayDestroy(values);
-    values = merged_values;
+   AtArray* vidxs = AiNodeGetArray(m_node, "vidxs");
+   GetRenderInstance()->ExportJobQueue().Push(new CIndexMergeJob(m_node, vidxs, in_valuesName, in_values, in_idxsName, in_idxs));
 }
 
 
@@ -1328,10 +1583,14 @@ void CMesh::ExportUVs(double in_frame)
       // If a valid ICE texture projection was detected, we skip this
       // Also, we skip using uvlist if the UV set is homogenous, because if so we export it as face varying points,
       // since the w is needed in the texture shader to divide u and v, for proper camera projection
+      bool exported;
       if ((!areUVsHomogenous) && (!mainUvDone) && (m_defaultUV == uvProperty || (!m_defaultUV.IsValid() && i == 0)))
-         ExportStandardProjectionAsUV(indices, uvValues);
+         exported = ExportStandardProjectionAsUV(indices, uvValues);
       else // For other projections, add them as face varying user data
-         ExportStandardProjectionAsFaceVaryingData(indices, uvValues, uvPropertyName, areUVsHomogenous);
+         exported = ExportStandardProjectionAsFaceVaryingData(indices, uvValues, uvPropertyName, areUVsHomogenous);
+
+      if (!exported)
+         GetMessageQueue()->LogMsg(L"[sitoa] UV size mismatch for " + uvPropertyName + L" of " + m_xsiObj.GetFullName() + L". Skipping.", siWarningMsg);
    }
 
    AiArrayDestroy(nodeIndices);
@@ -1343,7 +1602,7 @@ void CMesh::ExportUVs(double in_frame)
 // @param in_nodeIndices     the nodes indexes array
 // @param in_uvValues        the uv values
 // 
-// @return true
+// @return false if the indices or values don't match the node count, else true
 //
 bool CMesh::ExportStandardProjectionAsUV(AtArray *in_nodeIndices, CDoubleArray &in_uvValues)
 {
@@ -1354,16 +1613,15 @@ bool CMesh::ExportStandardProjectionAsUV(AtArray *in_nodeIndices, CDoubleArray &
    }
 
    AtArray* uvlist = AiArrayAllocate(m_nbVertexIndices, 1, AI_TYPE_VECTOR2);
-   LONG i3 = 0;
-   for (LONG i = 0; i < m_nbVertexIndices; i++, i3+=3)
+   // the uv values come as u,v,w triplets
+   if (!CBulkCopy::SetKeyStrided(uvlist, in_uvValues.GetArray(), (size_t)(in_uvValues.GetCount() / 3), 3, 0))
    {
-      AtVector2 uv = AtVector2((float)in_uvValues[i3], (float)in_uvValues[i3 + 1]);
-      AiArraySetVec2(uvlist, i, uv);
+      AiArrayDestroy(uvlist);
+      AiArrayDestroy(in_nodeIndices);
+      return false;
    }
       
-   IndexMerge(in_nodeIndices, uvlist);
-   AiNodeSetArray(m_node, "uvlist", uvlist);
-   AiNodeSetArray(m_node, "uvidxs", in_nodeIndices);
+   MergeAndSetIndexedArray("uvlist", uvlist, "uvidxs", in_nodeIndices);
 
    return true;
 }
@@ -1376,12 +1634,12 @@ bool CMesh::ExportStandardProjectionAsUV(AtArray *in_nodeIndices, CDoubleArray &
 // @param in_projectionName    the texture projection name
 // @param in_areUVsHomogenous  true if the w is to exported, in case of camera projection
 // 
-// @return true
+// @return false if the data can't be declared or the indices or values don't match the node count, else true
 //
 bool CMesh::ExportStandardProjectionAsFaceVaryingData(AtArray* in_nodeIndices, CDoubleArray &in_uvValues, CString &in_projectionName, bool in_areUVsHomogenous)
 {
    // we export the uvs are VECTOR if the set is homogenous (for camera projection), else as standard VECTOR2
-   if (!AiNodeDeclare(m_node, in_projectionName.GetAsciiString(), in_areUVsHomogenous ? "indexed VECTOR" : "indexed VECTOR2"))
+   if (!DeclareUserData(in_projectionName.GetAsciiString(), in_areUVsHomogenous ? "indexed VECTOR" : "indexed VECTOR2"))
    {
       AiArrayDestroy(in_nodeIndices);
       return false;
@@ -1394,34 +1652,21 @@ bool CMesh::ExportStandardProjectionAsFaceVaryingData(AtArray* in_nodeIndices, C
    }
 
    AtArray* uvlist = AiArrayAllocate(m_nbVertexIndices, 1, in_areUVsHomogenous ? AI_TYPE_VECTOR : AI_TYPE_VECTOR2);                  
-   LONG i3 = 0;
+   bool copied;
    if (in_areUVsHomogenous) // export uvw
+      copied = CBulkCopy::SetKey(uvlist, in_uvValues.GetArray(), (size_t)in_uvValues.GetCount(), 0);
+   else // skip w
+      copied = CBulkCopy::SetKeyStrided(uvlist, in_uvValues.GetArray(), (size_t)(in_uvValues.GetCount() / 3), 3, 0);
+
+   if (!copied)
    {
-      AtVector uvw;
-      for (LONG i = 0; i < m_nbVertexIndices; i++, i3+=3)
-      {
-         uvw.x = (float)in_uvValues[i3];
-         uvw.y = (float)in_uvValues[i3 + 1];
-         uvw.z = (float)in_uvValues[i3 + 2];
-         AiArraySetVec(uvlist, i, uvw);
-      }
-   }
-   else
-   {
-       AtVector2 uv;
-       for (LONG i = 0; i < m_nbVertexIndices; i++, i3+=3)
-       {
-          uv.x = (float)in_uvValues[i3];
-          uv.y = (float)in_uvValues[i3 + 1];
-          AiArraySetVec2(uvlist, i, uv);
-       }
+      AiArrayDestroy(uvlist);
+      AiArrayDestroy(in_nodeIndices);
+      return false; // COUNT_CHECK
    }
 
-   IndexMerge(in_nodeIndices, uvlist);
-
-   AiNodeSetArray(m_node, in_projectionName.GetAsciiString(), uvlist);
    CString idxName = in_projectionName + L"idxs"; // no need to declare the idx array
-   AiNodeSetArray(m_node, idxName.GetAsciiString(), in_nodeIndices);
+   MergeAndSetIndexedArray(in_projectionName.GetAsciiString(), uvlist, idxName.GetAsciiString(), in_nodeIndices);
 
    return true;
 }
@@ -1452,23 +1697,24 @@ bool CMesh::ExportIceProjection(CIceAttribute &in_txtProjAttr, bool in_mainUvDon
          AiArraySetVec2(uvlist, i, uv);
       }
 
-      IndexMerge(uvidxs, uvlist);
-
       if (!in_mainUvDone) // export the node set as the main uv
       {
-         AiNodeSetArray(m_node, "uvlist", uvlist);
-         AiNodeSetArray(m_node, "uvidxs", uvidxs);
+         MergeAndSetIndexedArray("uvlist", uvlist, "uvidxs", uvidxs);
          return true; // return true to mean that the main uv set is now set
       }
       else // export the node set as face varying user data
       {
          CString attributeName = in_txtProjAttr.GetName();
 
-         if (AiNodeDeclare(m_node, attributeName.GetAsciiString(), "indexed VECTOR2"))
+         if (DeclareUserData(attributeName.GetAsciiString(), "indexed VECTOR2"))
          {
-            AiNodeSetArray(m_node, attributeName.GetAsciiString(), uvlist);
             CString idxName = attributeName + L"idxs"; // no need to declare the idx array
-            AiNodeSetArray(m_node, idxName.GetAsciiString(), uvidxs);
+            MergeAndSetIndexedArray(attributeName.GetAsciiString(), uvlist, idxName.GetAsciiString(), uvidxs);
+         }
+         else
+         {
+            AiArrayDestroy(uvlist);
+            AiArrayDestroy(uvidxs);
          }
          return false;
       }
@@ -1477,7 +1723,7 @@ bool CMesh::ExportIceProjection(CIceAttribute &in_txtProjAttr, bool in_mainUvDon
    {
       LONG elementCount = (LONG)in_txtProjAttr.GetElementCount();
       CString attributeName = in_txtProjAttr.GetName();
-      if (AiNodeDeclare(m_node, attributeName.GetAsciiString(), "varying VECTOR2"))
+      if (DeclareUserData(attributeName.GetAsciiString(), "varying VECTOR2"))
       {
          AtArray* uvs = AiArrayAllocate(elementCount, 1, AI_TYPE_VECTOR2);
          for (LONG i=0; i<elementCount; i++) // loop the points
@@ -1613,15 +1859,13 @@ void CMesh::ExportNref(double in_frame)
    if (!(bool)ParAcc_GetValue(m_paramProperty, L"export_nref", in_frame))
       return;
 
-   AiNodeDeclare(m_node, "Nref", "indexed VECTOR");  // Nrefidxs seems to be defined automatically by this.
-
    PolygonMesh polyMeshBindPose = CObjectUtilities().GetGeometryAtFrame(m_xsiObj, siConstructionModeModeling, in_frame);
    CGeometryAccessor geoAccessorBindPose = polyMeshBindPose.GetGeometryAccessor(siConstructionModeModeling, siCatmullClark, 0, false, 
                                                                                 m_useDiscontinuity, m_discontinuityAngle);
 
    CLongArray NodeIndicesBindPose;
    geoAccessorBindPose.GetNodeIndices(NodeIndicesBindPose);
-   AtArray* nidxsBindPose = AiArrayCopy(LongArrayToUIntArray(NodeIndicesBindPose));
+   AtArray* nidxsBindPose = LongArrayToUIntArray(NodeIndicesBindPose);
    LONG nodeCountBindPose = AiArrayGetNumElements(nidxsBindPose);
 
    AtArray* nlistBindPose = AiArrayAllocate(nodeCountBindPose, 1, AI_TYPE_VECTOR);
@@ -1632,11 +1876,16 @@ void CMesh::ExportNref(double in_frame)
    else // Eric Mootz for #704
       GetGeoAccessorNormals(geoAccessorBindPose, nodeCountBindPose, nodeNormalsBindPose);
 
-   for (LONG i=0; i < nodeCountBindPose; ++i)
+   if (!CBulkCopy::SetKey(nlistBindPose, nodeNormalsBindPose.GetArray(), (size_t)nodeNormalsBindPose.GetCount(), 0))
    {
-      AiArraySetVec(nlistBindPose, i, AtVector((float)nodeNormalsBindPose[3*i], (float)nodeNormalsBindPose[3*i + 1], (float)nodeNormalsBindPose[3*i + 2]));
+      GetMessageQueue()->LogMsg(L"[sitoa] Nref count mismatch for " + m_xsiObj.GetFullName() + L": " + CValue(nodeNormalsBindPose.GetCount() / 3).GetAsText() + 
+                                L" normals, " + CValue(nodeCountBindPose).GetAsText() + L" expected. Skipping.", siWarningMsg);
+      AiArrayDestroy(nlistBindPose);
+      AiArrayDestroy(nidxsBindPose);
+      return;
    }
 
+   AiNodeDeclare(m_node, "Nref", "indexed VECTOR");  // Nrefidxs seems to be defined automatically by this.
    AiNodeSetArray(m_node, "Nrefidxs", nidxsBindPose);
    AiNodeSetArray(m_node, "Nref", nlistBindPose);
 }
@@ -1678,6 +1927,296 @@ void CMesh::ExportMotionStartEnd()
 }
 
 
+// Copy the parameters of a polymesh that a ginstance also has, for instance the matrix, shader, visibility
+//
+// @param in_ginstanceNode  The ginstance node
+// @param in_meshNode       The polymesh node
+//
+static void CopyShapeParameters(AtNode* in_ginstanceNode, AtNode* in_meshNode)
+{
+   const AtNodeEntry* meshEntry = AiNodeGetNodeEntry(in_meshNode);
+   AtParamIterator* pIter = AiNodeEntryGetParamIterator(AiNodeGetNodeEntry(in_ginstanceNode));
+   while (!AiParamIteratorFinished(pIter))
+   {
+      const AtParamEntry *pEntry = AiParamIteratorGetNext(pIter);
+      const char* paramName = AiParamGetName(pEntry);
+      if (!strcmp(paramName, "name"))
+         continue;
+
+      int paramType = AiParamGetType(pEntry);
+      const AtParamEntry *meshParamEntry = AiNodeEntryLookUpParameter(meshEntry, paramName);
+      if (!meshParamEntry || AiParamGetType(meshParamEntry) != paramType)
+         continue;
+
+      switch (paramType)
+      {
+         case AI_TYPE_BYTE:
+            AiNodeSetByte(in_ginstanceNode, paramName, AiNodeGetByte(in_meshNode, paramName));
+            break;
+         case AI_TYPE_INT:
+         case AI_TYPE_ENUM:
+            AiNodeSetInt(in_ginstanceNode, paramName, AiNodeGetInt(in_meshNode, paramName));
+            break;
+         case AI_TYPE_UINT:
+            AiNodeSetUInt(in_ginstanceNode, paramName, AiNodeGetUInt(in_meshNode, paramName));
+            break;
+         case AI_TYPE_BOOLEAN:
+            AiNodeSetBool(in_ginstanceNode, paramName, AiNodeGetBool(in_meshNode, paramName));
+            break;
+         case AI_TYPE_FLOAT:
+            AiNodeSetFlt(in_ginstanceNode, paramName, AiNodeGetFlt(in_meshNode, paramName));
+            break;
+         case AI_TYPE_RGB:
+         {
+            AtRGB c = AiNodeGetRGB(in_meshNode, paramName);
+            AiNodeSetRGB(in_ginstanceNode, paramName, c.r, c.g, c.b);
+            break;
+         }
+         case AI_TYPE_RGBA:
+         {
+            AtRGBA c = AiNodeGetRGBA(in_meshNode, paramName);
+            AiNodeSetRGBA(in_ginstanceNode, paramName, c.r, c.g, c.b, c.a);
+            break;
+         }
+         case AI_TYPE_VECTOR:
+         {
+            AtVector v = AiNodeGetVec(in_meshNode, paramName);
+            AiNodeSetVec(in_ginstanceNode, paramName, v.x, v.y, v.z);
+            break;
+         }
+         case AI_TYPE_VECTOR2:
+         {
+            AtVector2 v = AiNodeGetVec2(in_meshNode, paramName);
+            AiNodeSetVec2(in_ginstanceNode, paramName, v.x, v.y);
+            break;
+         }
+         case AI_TYPE_STRING:
+            AiNodeSetStr(in_ginstanceNode, paramName, AiNodeGetStr(in_meshNode, paramName));
+            break;
+         case AI_TYPE_POINTER:
+         case AI_TYPE_NODE:
+            AiNodeSetPtr(in_ginstanceNode, paramName, AiNodeGetPtr(in_meshNode, paramName));
+            break;
+         case AI_TYPE_MATRIX:
+            AiNodeSetMatrix(in_ginstanceNode, paramName, AiNodeGetMatrix(in_meshNode, paramName));
+            break;
+         case AI_TYPE_ARRAY:
+         {
+            AtArray* array = AiNodeGetArray(in_meshNode, paramName);
+            if (array)
+               AiNodeSetArray(in_ginstanceNode, paramName, AiArrayCopy(array));
+            break;
+         }
+         default:
+            break;
+      }
+   }
+   AiParamIteratorDestroy(pIter);
+}
+
+
+// Export the parameters of a ginstance created by Create in place of a mesh with the same source data as an exported one.
+// The shared mesh has the same properties and materials, so the shape parameters are copied from it,
+// then the ones that depend on the object are exported: the id, the matrix, the light group, and the
+// constant user data of the instance values and the blobs
+//
+// @param in_frame          The frame time
+//
+void CMesh::ExportSharedInstance(double in_frame)
+{
+   CopyShapeParameters(m_node, m_sharedNode);
+   CNodeSetter::SetPointer(m_node, "node", m_sharedNode);
+   CNodeSetter::SetBoolean(m_node, "inherit_xform", false);
+   CNodeSetter::SetInt(m_node, "id", CObjectUtilities().GetId(m_xsiObj));
+
+   ExportMatrices();
+
+   CNodeSetter::SetBoolean(m_node, "use_light_group", false, true);
+   AiNodeResetParameter(m_node, "light_group");
+   ExportLightGroup();
+
+   m_materialFrame = in_frame;
+   m_materialsArray = m_geoAccessor.GetMaterials();
+   m_standardUVsArray = m_geoAccessor.GetUVs();
+   for (LONG i=0; i<m_materialsArray.GetCount(); i++)
+      SetWrappingAndInstanceValues(m_node, m_xsiObj.GetRef(), m_materialsArray[i], m_standardUVsArray, NULL, m_materialFrame);
+
+   LoadUserDataBlobs(m_node, m_xsiObj, in_frame);
+}
+
+
+// Return true if a parameter of a polymesh is part of its geometry, so it can't be overridden by a ginstance.
+// These are the parameters that the ginstance node does not have, plus the motion range,
+// since it also times the deformation keys of vlist and nlist
+//
+// @param in_paramEntry     The polymesh parameter
+// @param in_ginstanceEntry The ginstance node entry
+//
+// @return true if the parameter is part of the geometry
+//
+static bool IsGeometryParameter(const AtParamEntry* in_paramEntry, const AtNodeEntry* in_ginstanceEntry)
+{
+   const char* paramName = AiParamGetName(in_paramEntry);
+   if (!strcmp(paramName, "name"))
+      return false;
+   if (!strcmp(paramName, "motion_start") || !strcmp(paramName, "motion_end"))
+      return true;
+   return AiNodeEntryLookUpParameter(in_ginstanceEntry, paramName) == NULL;
+}
+
+
+// Hash a memory block (FNV-1a)
+//
+// @param in_data      The data
+// @param in_size      The size in bytes of the data
+// @param io_hash      The hash to update
+//
+static inline void HashBytes(const void* in_data, size_t in_size, uint64_t &io_hash)
+{
+   const uint8_t* data = (const uint8_t*)in_data;
+   for (size_t i=0; i<in_size; i++)
+   {
+      io_hash^= data[i];
+      io_hash*= 1099511628211ULL;
+   }
+}
+
+
+// Return a hash of the data
+//
+// @return the hash
+//
+uint64_t CMeshSource::GetHash() const
+{
+   uint64_t hash = 14695981039346656037ULL;
+   if (m_values.size() > 0)
+      HashBytes(&m_values[0], m_values.size() * sizeof(double), hash);
+   for (vector <CString>::const_iterator it = m_strings.begin(); it != m_strings.end(); it++)
+      HashBytes(it->GetWideString(), it->Length() * sizeof(wchar_t), hash);
+   return hash;
+}
+
+
+// Return the size in bytes of the geometry arrays of a polymesh node
+//
+// @param in_node     The polymesh node
+//
+// @return the size
+//
+size_t CMesh::GetGeometrySize(AtNode* in_node)
+{
+   size_t result(0);
+   const AtNodeEntry* ginstanceEntry = AiNodeEntryLookUp("ginstance");
+   AtParamIterator* pIter = AiNodeEntryGetParamIterator(AiNodeGetNodeEntry(in_node));
+   while (!AiParamIteratorFinished(pIter))
+   {
+      const AtParamEntry *pEntry = AiParamIteratorGetNext(pIter);
+      if (AiParamGetType(pEntry) == AI_TYPE_ARRAY && IsGeometryParameter(pEntry, ginstanceEntry))
+         result+= GetArrayDataSize(AiNodeGetArray(in_node, AiParamGetName(pEntry)));
+   }
+   AiParamIteratorDestroy(pIter);
+   return result;
+}
+
+
+//////////////////////////////////////////////////
+//////////////////////////////////////////////////
+// CPolymeshShareCache class
+//////////////////////////////////////////////////
+//////////////////////////////////////////////////
+
+// Return the node of an exported mesh with the same source data.
+// The source data of the exported meshes with the same pre-key are collected the first time they 
+// are looked up, and compared to in_source. The hashes just skip the comparison of most different sources
+//
+// @param in_preKey       The pre-key of the mesh to export
+// @param in_source       The source data of the mesh to export
+// @param in_frame        The frame time
+//
+// @return the polymesh node to be shared, or NULL if none has the same source data
+//
+AtNode* CPolymeshShareCache::GetSharedNode(const CMeshPreKey &in_preKey, const CMeshSource &in_source, double in_frame)
+{
+   map <CMeshPreKey, vector <CSharedMesh> >::iterator bucket = m_meshes.find(in_preKey);
+   if (bucket == m_meshes.end())
+      return NULL;
+
+   uint64_t hash = in_source.GetHash();
+   for (vector <CSharedMesh>::iterator it = bucket->second.begin(); it != bucket->second.end(); it++)
+   {
+      if (!it->m_hasSource)
+      {
+         CMesh().GetSourceOf(it->m_xsiObj, in_frame, it->m_source);
+         it->m_hash = it->m_source.GetHash();
+         it->m_hasSource = true;
+      }
+
+      if (it->m_hash == hash && it->m_source == in_source)
+      {
+         it->m_nbInstances++;
+         return it->m_node;
+      }
+   }
+
+   return NULL;
+}
+
+
+// Add an exported polymesh, that the meshes exported later with the same source data can share
+//
+// @param in_xsiObj     The Softimage object
+// @param in_node       The polymesh node exported for in_xsiObj
+// @param in_preKey     The pre-key of in_xsiObj
+// @param in_source     The source data of in_xsiObj, if already collected, else NULL
+//
+void CPolymeshShareCache::Push(const X3DObject &in_xsiObj, AtNode *in_node, const CMeshPreKey &in_preKey, const CMeshSource *in_source)
+{
+   CSharedMesh sharedMesh(in_xsiObj, in_node);
+   if (in_source)
+   {
+      sharedMesh.m_source = *in_source;
+      sharedMesh.m_hash = in_source->GetHash();
+      sharedMesh.m_hasSource = true;
+   }
+   m_meshes[in_preKey].push_back(sharedMesh);
+}
+
+
+// Return the number of ginstances created in place of polymeshes.
+// Must be called when the export jobs are done, since they build the final uv and normal arrays
+//
+// @param out_sharedBytes The bytes of geometry that were not exported
+//
+// @return the number of ginstances
+//
+unsigned int CPolymeshShareCache::GetNbShared(size_t &out_sharedBytes)
+{
+   out_sharedBytes = 0;
+   unsigned int nbShared(0);
+
+   for (map <CMeshPreKey, vector <CSharedMesh> >::iterator bucket = m_meshes.begin(); bucket != m_meshes.end(); bucket++)
+   {
+      for (vector <CSharedMesh>::iterator it = bucket->second.begin(); it != bucket->second.end(); it++)
+      {
+         if (it->m_nbInstances == 0)
+            continue;
+         nbShared+= it->m_nbInstances;
+         out_sharedBytes+= it->m_nbInstances * CMesh::GetGeometrySize(it->m_node);
+      }
+   }
+
+   return nbShared;
+}
+
+
+// Clear the cache
+//
+void CPolymeshShareCache::Clear()
+{
+   m_meshes.clear();
+}
+
+
 ////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////
@@ -1696,6 +2235,11 @@ CStatus LoadPolymeshes(double in_frame, CRefArray &in_selectedObjs, bool in_sele
 
    CRefArray polysArray = Application().GetActiveSceneRoot().FindChildren(L"", siPolyMeshType, CStringArray(), true);
 
+   // share the geometry of the identical meshes. Not during IPR, where each mesh can be updated on its own
+   CPolymeshShareCache *shareCache = NULL;
+   if (GetRenderOptions()->m_share_identical_polymeshes && GetRenderInstance()->GetRenderType() != L"Region")
+      shareCache = &GetRenderInstance()->PolymeshShareCache();
+
    for (LONG i=0; i<polysArray.GetCount(); i++)
    {
       // check if this mesh is selected
@@ -1703,7 +2247,11 @@ CStatus LoadPolymeshes(double in_frame, CRefArray &in_selectedObjs, bool in_sele
          continue;
 
       X3DObject mesh(polysArray[i]);
-      status = LoadSinglePolymesh(mesh, in_frame, in_selectedObjs, in_selectionOnly);
+      // already written into the static geometry include of the .ass sequence
+      if (GetStaticShapes().IsStatic(mesh))
+         continue;
+
+      status = LoadSinglePolymesh(mesh, in_frame, in_selectedObjs, in_selectionOnly, shareCache);
       if (status != CStatus::OK)
          break;
    }
@@ -1718,10 +2266,11 @@ CStatus LoadPolymeshes(double in_frame, CRefArray &in_selectedObjs, bool in_sele
 // @param in_frame               The frame time
 // @param in_selectedObjs        The selected objs to render (if in_selectionOnly==true)
 // @param in_selectionOnly       True is only in_selectedObjs must be rendered
+// @param io_shareCache          If not NULL, the mesh is exported as a ginstance of an identical mesh found in it, if any, else added to it
 //
 // @return CStatus:OK if all went well, else the error CStatus
 //
-CStatus LoadSinglePolymesh(X3DObject &in_xsiObj, double in_frame, CRefArray &in_selectedObjs, bool in_selectionOnly)
+CStatus LoadSinglePolymesh(X3DObject &in_xsiObj, double in_frame, CRefArray &in_selectedObjs, bool in_selectionOnly, CPolymeshShareCache *io_shareCache)
 {
    if (GetRenderInstance()->InterruptRenderSignal())
       return CStatus::Abort;
@@ -1750,12 +2299,27 @@ CStatus LoadSinglePolymesh(X3DObject &in_xsiObj, double in_frame, CRefArray &in_
       return LoadSingleVolume(in_xsiObj, in_frame, in_selectedObjs, in_selectionOnly);
 
    CMesh mesh;
-   if (!mesh.Create(in_xsiObj, in_frame))
+   if (!mesh.Create(in_xsiObj, in_frame, io_shareCache))
+      return CStatus::OK;
+
+   if (mesh.IsShared())
+   {
+      mesh.ExportSharedInstance(in_frame);
       return CStatus::OK;
+   }
 
-   mesh.ExportPolygonVerticesCount();
+   // a mesh whose topology or points don't match its counts would render garbage, so hide it
+   if (!mesh.ExportPolygonVerticesCount())
+   {
+      CNodeSetter::SetByte(mesh.GetNode(), "visibility", 0, true);
+      return CStatus::OK;
+   }
    mesh.ExportVertexIndices();
-   mesh.ExportVerticesAndNormals(in_frame);
+   if (!mesh.ExportVerticesAndNormals(in_frame))
+   {
+      CNodeSetter::SetByte(mesh.GetNode(), "visibility", 0, true);
+      return CStatus::OK;
+   }
    mesh.ExportMatrices();
    mesh.ExportFaceVisibility(in_frame);
    mesh.ExportSubdivision(in_frame);
@@ -1775,3 +2339,60 @@ CStatus LoadSinglePolymesh(X3DObject &in_xsiObj, double in_frame, CRefArray &in_
 }
 
 
+// Log the polymeshes exported as ginstances of an identical mesh, then clear the share cache.
+// Must be called when the export jobs are done.
+//
+void LogSharedPolymeshes()
+{
+   size_t sharedBytes(0);
+   unsigned int nbShared = GetRenderInstance()->PolymeshShareCache().GetNbShared(sharedBytes);
+   GetRenderInstance()->PolymeshShareCache().Clear();
+
+   if (nbShared > 0)
+      GetMessageQueue()->LogMsg(L"[sitoa] Polymeshes: " + CValue((LONG)nbShared).GetAsText() + 
+                                L" meshes exported as ginstances of identical meshes, " + 
+                                CValue((double)sharedBytes / (1024.0 * 1024.0)).GetAsText() + L" MB saved");
+}
+
+
+
+
+// Update the geometry of an already exported polymesh, for IPR.
+// Only the points, normals, clusters and uvs are exported again, and set on the existing node,
+// so that moving some points does not require the whole scene to be destroyed and loaded again.
+// Meshes with an ICE tree are not updated, since their ICE attributes depend on the geometry too. 
+// Neither are the hidden meshes, that can be the masters of the hair and ICE strand instances, 
+// whose bended copies are built from the master geometry at export time.
+//
+// @param in_xsiObj              The Softimage mesh
+// @param in_node                The polymesh node exported for in_xsiObj
+// @param in_frame               The frame time
+//
+// @return false if the topology or the materials changed, so the mesh could not be updated in place, else true
+//
+bool UpdateSinglePolymeshGeometry(const X3DObject &in_xsiObj, AtNode *in_node, double in_frame)
+{
+   LockSceneData lock;
+   if (lock.m_status != CStatus::OK)
+      return false;
+
+   if (AiNodeGetByte(in_node, "visibility") == 0)
+      return false;
+
+   CMesh mesh;
+   if (!mesh.Update(in_xsiObj, in_node, in_frame))
+      return false;
+   if (mesh.HasIceTree() || !mesh.HasSameTopology())
+      return false;
+
+   mesh.CollectMaterials(in_frame);
+   if (!mesh.HasSameMaterials())
+      return false;
+
+   if (!mesh.ExportVerticesAndNormals(in_frame))
+      return false;
+   mesh.ExportClusters();
+   mesh.ExportUVs(in_frame);
+
+   return true;
+}
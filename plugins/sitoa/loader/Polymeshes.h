@@ -12,6 +12,7 @@ See the License for the specific language governing permissions and limitations
 #pragma once
 
 #include "loader/ICE.h"
+#include "loader/IndexMerge.h"
 
 #include <xsi_geometryaccessor.h>
 #include <xsi_polygonmesh.h>
@@ -20,35 +21,6 @@ See the License for the specific language governing permissions and limitations
 
 using namespace XSI;
 
-/// Return the distance in bytes from key to key of an array
-inline uint32_t arrayStride(const AtArray* array)
-{
-    return AiArrayGetNumElements(array) * AiParamGetTypeSize(AiArrayGetType(array));
-}
-
-#define INDEX_ARRAY(a) (static_cast<unsigned*>(AiArrayMap(a)))
-#define VALUE_AT(a, k, i) (&(static_cast<uint8_t*>(AiArrayMap(a))[(k * AiArrayGetNumElements(a) + i) * type_size]))
-
-/// Index-value pairs
-struct IndexValue
-{
-    uint32_t vidx;         ///< vertex index
-    uint32_t position;     ///< original index position
-    uint32_t value_index;  ///< corresponding value index
-    void*    value;        ///< value pointer
-
-    IndexValue() {}
-
-    inline void set(uint32_t position, uint32_t vidx, void* value)
-    {
-        this->vidx        = vidx;
-        this->position    = position;
-        this->value_index = 0;
-        this->value       = value;
-    }
-};
-
-
 struct ClusterIndexToNodeIndex
 {
    uint32_t clusterIndex;
@@ -73,15 +45,69 @@ struct ClusterIndexToNodeIndex
     }
 };
 
+class CPolymeshShareCache;
+
+// The counts and bounding box of a polymesh, cheap to get. Only the meshes with the same pre-key
+// can have the same source data (see CMeshSource), so this is compared first
+class CMeshPreKey
+{
+public:
+   LONG   m_nbVertices, m_nbPolygons, m_nbNodes;
+   double m_bbox[6]; // center and extent
+
+   CMeshPreKey() : m_nbVertices(0), m_nbPolygons(0), m_nbNodes(0)
+   {
+      for (int i=0; i<6; i++)
+         m_bbox[i] = 0.0;
+   }
+
+   bool operator<(const CMeshPreKey &in_other) const
+   {
+      if (m_nbVertices != in_other.m_nbVertices)
+         return m_nbVertices < in_other.m_nbVertices;
+      if (m_nbPolygons != in_other.m_nbPolygons)
+         return m_nbPolygons < in_other.m_nbPolygons;
+      if (m_nbNodes != in_other.m_nbNodes)
+         return m_nbNodes < in_other.m_nbNodes;
+      for (int i=0; i<6; i++)
+      {
+         if (m_bbox[i] != in_other.m_bbox[i])
+            return m_bbox[i] < in_other.m_bbox[i];
+      }
+      return false;
+   }
+};
+
+// The Softimage data that the geometry of a polymesh node is built from: points, topology, clusters,
+// materials and the properties that drive the export. Two meshes with the same source data get the same
+// geometry arrays, so one of them can be exported as a ginstance of the other (see CPolymeshShareCache)
+class CMeshSource
+{
+public:
+   vector <double>  m_values;  // the points, indices, crease and cluster values
+   vector <CString> m_strings; // the names, and the values of the parameters
+
+   // Return a hash of the data
+   uint64_t GetHash() const;
+
+   bool operator==(const CMeshSource &in_other) const
+   {
+      return m_values == in_other.m_values && m_strings == in_other.m_strings;
+   }
+};
+
 class CMesh
 {
 public:
    CMesh()
    {
+      m_node = NULL;
+      m_sharedNode = NULL;
       m_node_indices = NULL;
       m_hasMainUv = false;
       m_hasIceTree = false;
       m_hasIceNodeUserNormal = false;
+      m_isUpdate = false;
    }
 
    ~CMesh()
@@ -89,14 +115,20 @@ public:
       AiArrayDestroy(m_node_indices);
    }
 
-   // Create the polymesh node and set the base class members
-   bool Create(const X3DObject &in_xsiObj, double in_frame);
+   // Create the polymesh node, or a ginstance of an identical mesh, and set the base class members
+   bool Create(const X3DObject &in_xsiObj, double in_frame, CPolymeshShareCache *io_shareCache = NULL);
+   // Attach to an already exported polymesh node, for an IPR geometry update
+   bool Update(const X3DObject &in_xsiObj, AtNode *in_node, double in_frame);
+   // Check if the topology (nsides and vidxs) of the attached node still matches the Softimage mesh
+   bool HasSameTopology();
+   // Check if the materials (shader and shidxs) of the attached node still match the Softimage mesh
+   bool HasSameMaterials();
    // Export nsides, the number of nodes per polygon
-   void ExportPolygonVerticesCount();
+   bool ExportPolygonVerticesCount();
    // Export vidxs, the vertices indeces. The number of vidxs equals the sum of the nsides array
    void ExportVertexIndices();
    // Export the vertices and the nidxs and nlist, ie the normals
-   void ExportVerticesAndNormals(double in_frame);
+   bool ExportVerticesAndNormals(double in_frame);
    // Export the transformation matrices
    void ExportMatrices();
    // Export weight maps and CAV
@@ -111,6 +143,8 @@ public:
    void ExportIceAttributes(double in_frame);
    // Export the UVs, either as the main UV set or as VECTOR2 user data
    void ExportUVs(double in_frame);
+   // Collect the materials and the uv properties, needed by ExportUVs
+   bool CollectMaterials(double in_frame);
    // Export the environment shader
    void ExportEnvironment();
    // Export the light group
@@ -125,10 +159,43 @@ public:
    void ExportVizSidednessAndOptions(double in_frame);
    // Export motion_start, motion_end
    void ExportMotionStartEnd();
+   // Export the parameters of a ginstance created by Create for a mesh with the same geometry as an exported one
+   void ExportSharedInstance(double in_frame);
+   // Evaluate a Softimage mesh and collect its source data
+   bool GetSourceOf(const X3DObject &in_xsiObj, double in_frame, CMeshSource &out_source);
+
+   // Return the polymesh node
+   AtNode* GetNode() const
+   {
+      return m_node;
+   }
+
+   // Return true if the mesh has an ICE tree
+   bool HasIceTree() const
+   {
+      return m_hasIceTree;
+   }
+
+   // Return true if Create made a ginstance of an exported mesh with the same geometry
+   bool IsShared() const
+   {
+      return m_sharedNode != NULL;
+   }
+
+   // Return the size in bytes of the geometry arrays of a polymesh node
+   static size_t GetGeometrySize(AtNode* in_node);
 
 private:
+   // Set the base class members and evaluate the geometry accessor
+   bool Init(const X3DObject &in_xsiObj, double in_frame);
+   // Declare a user data, or reuse the existing one when updating
+   bool DeclareUserData(const char *in_name, const char *in_declaration);
    // Check if the mesh has an ICE tree, and set m_hasIceTree accordingly
    void CheckIceTree();
+   // Get the pre-key of the mesh, if it can share its geometry
+   bool GetPreKey(double in_frame, CMeshPreKey &out_preKey);
+   // Collect the source data of the mesh
+   void GetSource(double in_frame, CMeshSource &out_source);
    // Export the vertices in case they have to be mblurred by the PointVelocity attribute
    bool ExportIceVertices(AtArray *io_vlist);
    // Resize the vlist and nlist arrays to just contain one key.
@@ -147,8 +214,8 @@ private:
    AtArray* LongArrayToUIntArray(const CLongArray &in_nodeIndices) const;
    // Return the Softimage node indices as an AtArray
    AtArray* NodeIndices();
-   // Merge vertex indices that have the same value on the same point in place.
-   void IndexMerge(AtArray*& idxs, AtArray*& values, bool canonical = false) const;
+   // Merge and set an indexed array, in the export job queue
+   void MergeAndSetIndexedArray(const char* in_valuesName, AtArray* in_values, const char* in_idxsName, AtArray* in_idxs);
    // Export a standard Softimage projection as the main UV set
    bool ExportStandardProjectionAsUV(AtArray* in_nodeIndices, CDoubleArray &in_uvValues);
    // Export a standard Softimage projection as face varying user data
@@ -157,6 +224,7 @@ private:
    bool ExportIceProjection(CIceAttribute &in_txtProjAttr, bool in_mainUvDone);
 
    AtNode* m_node;                  // the created polymesh node
+   AtNode* m_sharedNode;            // the polymesh node whose geometry m_node shares, set by Create()
    AtArray *m_node_indices;         // Softimage node indices
    Geometry m_xsiIceGeo;            // used to get the ICE materials and UVs
 
@@ -168,6 +236,7 @@ private:
    LONG              m_nbVertices;         // number of vertices;
    LONG              m_nbPolygons;         // number of polygons
    LONG              m_nbMaterials;        // total number of materials, including the ICE ones  
+   LONG              m_nbObjectMaterials;  // number of non ICE materials
    CRefArray         m_standardUVsArray;   // standard (non ICE) UV clusters
    LONG              m_nbStandardUVs;      // number of standard UV clusters
    double            m_materialFrame;      // frame for shifted materials (if enabled in the preferences)
@@ -187,12 +256,70 @@ private:
    bool              m_hasMainUv;            // turned true after the first main UV (uvlist) is exported
    bool              m_hasIceTree;           // true if the mesh has an ICE tree applied
    bool              m_hasIceNodeUserNormal; // true if the nodeusernormal attribute is avaliable
+   bool              m_isUpdate;             // true if updating an existing node, set by Update()
 
    CDoubleArray      m_transfKeys, m_defKeys;     // the mb keys
    LONG              m_nbTransfKeys, m_nbDefKeys; // the number of transf/def keys
 };
 
+
+// The polymeshes exported by LoadPolymeshes whose geometry can be shared.
+// CMesh::Create looks up the pre-key of each mesh (see CMeshPreKey) before building any array.
+// Only if an already exported mesh has the same pre-key, the source data (see CMeshSource) of both are collected
+// and compared. If equal, the new mesh is exported as a ginstance of the exported one, else it is exported as usual
+// and added to the cache.
+// The first mesh stays a regular polymesh, so the nodes that reference it are not affected.
+class CPolymeshShareCache
+{
+private:
+   // An exported polymesh that the meshes with the same source data can share
+   class CSharedMesh
+   {
+   public:
+      X3DObject    m_xsiObj;      // the Softimage object
+      AtNode*      m_node;        // the polymesh node exported for m_xsiObj
+      CMeshSource  m_source;      // the source data of m_xsiObj, collected on the first lookup
+      uint64_t     m_hash;        // the hash of m_source
+      bool         m_hasSource;   // true if m_source was collected
+      unsigned int m_nbInstances; // the number of ginstances sharing m_node
+
+      CSharedMesh(const X3DObject &in_xsiObj, AtNode *in_node) :
+         m_xsiObj(in_xsiObj), m_node(in_node), m_hash(0), m_hasSource(false), m_nbInstances(0)
+      {}
+   };
+
+   map <CMeshPreKey, vector <CSharedMesh> > m_meshes; // the exported meshes, by pre-key
+
+public:
+   CPolymeshShareCache()
+   {}
+
+   ~CPolymeshShareCache()
+   {
+      Clear();
+   }
+
+   // Return true if an exported mesh has the same pre-key
+   bool HasPreKey(const CMeshPreKey &in_preKey) const
+   {
+      return m_meshes.find(in_preKey) != m_meshes.end();
+   }
+   // Return the node of an exported mesh with the same source data, or NULL
+   AtNode* GetSharedNode(const CMeshPreKey &in_preKey, const CMeshSource &in_source, double in_frame);
+   // Add an exported polymesh
+   void Push(const X3DObject &in_xsiObj, AtNode *in_node, const CMeshPreKey &in_preKey, const CMeshSource *in_source);
+   // Return the number of ginstances created in place of polymeshes, and the bytes that were saved
+   unsigned int GetNbShared(size_t &out_sharedBytes);
+   // Clear the cache
+   void Clear();
+};
+
+
 // Load all the polymeshes
 CStatus LoadPolymeshes(double in_frame, CRefArray &in_selectedObjs, bool in_selectionOnly = false);
 // Load a single polymesh
-CStatus LoadSinglePolymesh(X3DObject &in_xsiObj, double in_frame, CRefArray &in_selectedObjs, bool in_selectionOnly = false);
+CStatus LoadSinglePolymesh(X3DObject &in_xsiObj, double in_frame, CRefArray &in_selectedObjs, bool in_selectionOnly = false, CPolymeshShareCache *io_shareCache = NULL);
+// Log the polymeshes exported as ginstances of an identical mesh, then clear the share cache
+void LogSharedPolymeshes();
+// Update the geometry of an already exported polymesh
+bool UpdateSinglePolymeshGeometry(const X3DObject &in_xsiObj, AtNode *in_node, double in_frame);
@@ -248,7 +248,7 @@ CStatus LoadSingleProcedural(const X3DObject &in_xsiObj, double in_frame, CRefAr
    {
       // Get the transform matrix
       AtMatrix matrix;
-      CUtilities().S2A(in_xsiObj.GetKinematics().GetGlobal().GetTransform(keyFramesTransform[ikey]).GetMatrix4(), matrix);
+      GetRenderInstance()->TransformCache().GetGlobalMatrix(in_xsiObj, keyFramesTransform[ikey], matrix);
       AiArraySetMtx(matrices, ikey, matrix);
    }
 
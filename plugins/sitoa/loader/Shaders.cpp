@@ -36,7 +36,9 @@ See the License for the specific language governing permissions and limitations
 //
 void CShaderMap::Push(AtNode *in_shader, AtShaderLookupKey in_key)
 {
+   AiCritSecEnter(&m_cs);
    m_map.insert(pair<AtShaderLookupKey, AtNode*> (in_key, in_shader));
+   AiCritSecLeave(&m_cs);
 }
 
 
@@ -61,10 +63,13 @@ void CShaderMap::Push(ProjectItem in_xsiShader, AtNode *in_shader, double in_fra
 //
 AtNode* CShaderMap::Get(const ProjectItem in_xsiShader, double in_frame)
 {
+   AtNode *shader(NULL);
+   AiCritSecEnter(&m_cs);
    map <AtShaderLookupKey, AtNode*>::iterator iter = m_map.find(AtShaderLookupKey(in_xsiShader.GetObjectID(), in_frame));
    if (iter != m_map.end())
-      return iter->second;
-   return NULL;
+      shader = iter->second;
+   AiCritSecLeave(&m_cs);
+   return shader;
 }
 
 // Erase a shader node from the map
@@ -73,6 +78,7 @@ AtNode* CShaderMap::Get(const ProjectItem in_xsiShader, double in_frame)
 //
 void CShaderMap::EraseExportedNode(AtNode *in_shader)
 {
+   AiCritSecEnter(&m_cs);
    map <AtShaderLookupKey, AtNode*>::iterator it;
    for (it=m_map.begin(); it!=m_map.end(); it++)
    {
@@ -82,6 +88,7 @@ void CShaderMap::EraseExportedNode(AtNode *in_shader)
          break;
       }
    }
+   AiCritSecLeave(&m_cs);
 }
 
 
@@ -89,6 +96,7 @@ void CShaderMap::EraseExportedNode(AtNode *in_shader)
 //
 void CShaderMap::FlythroughUpdate()
 {
+   AiCritSecEnter(&m_cs);
    map <AtShaderLookupKey, AtNode*>::iterator it;
    for (it=m_map.begin(); it!=m_map.end(); it++)
    {
@@ -98,6 +106,7 @@ void CShaderMap::FlythroughUpdate()
 
       UpdateShader(shader, GetRenderInstance()->GetFrame());
    }
+   AiCritSecLeave(&m_cs);
 }
 
 
@@ -105,7 +114,9 @@ void CShaderMap::FlythroughUpdate()
 //
 void CShaderMap::Clear()
 {
+   AiCritSecEnter(&m_cs);
    m_map.clear();
+   AiCritSecLeave(&m_cs);
 }
 
 
@@ -19,6 +19,7 @@ See the License for the specific language governing permissions and limitations
 #include <xsi_status.h>
 #include <xsi_string.h>
 
+#include <ai_critsec.h>
 #include <ai_nodes.h>
 
 #include <map>
@@ -46,15 +47,20 @@ class CShaderMap
 {
 private:
    map <AtShaderLookupKey, AtNode*> m_map;
+   // the map can be accessed by the export workers. Recursive, since FlythroughUpdate queries the map again
+   AtCritSec m_cs;
 public:
    // Default constructor
    CShaderMap()
-   {}
+   {
+      AiCritSecInitRecursive(&m_cs);
+   }
 
    // Default destructor
    ~CShaderMap()
    {
       m_map.clear();
+      AiCritSecClose(&m_cs);
    }
 
    // Push into map by AtNode and key
@@ -0,0 +1,372 @@
+/************************************************************************************************************************************
+Copyright 2017 Autodesk, Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance with the License. 
+You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is distributed on an "AS IS" BASIS, 
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+See the License for the specific language governing permissions and limitations under the License.
+************************************************************************************************************************************/
+
+#include "common/ParamsCommon.h"
+#include "loader/Options.h"
+#include "loader/Polymeshes.h"
+#include "loader/StaticShapes.h"
+#include "renderer/Renderer.h"
+#include "renderer/RendererOptions.h"
+
+#include <xsi_application.h>
+#include <xsi_group.h>
+#include <xsi_imageclip2.h>
+#include <xsi_kinematics.h>
+#include <xsi_light.h>
+#include <xsi_material.h>
+#include <xsi_model.h>
+#include <xsi_primitive.h>
+#include <xsi_shader.h>
+#include <xsi_userdatablob.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+
+// the max number of frames the deformation of a polymesh is checked at
+#define STATIC_SHAPES_NB_DEFORMATION_SAMPLES 8
+
+
+// Return true if at least one light of the scene is associated to some objects.
+// The light_group arrays of the static meshes would reference the lights exported by the first frame only.
+//
+static bool SceneHasAssociatedLights()
+{
+   CRefArray lightsArray = Application().GetActiveSceneRoot().FindChildren(L"", siLightPrimType, CStringArray());
+   for (LONG i=0; i<lightsArray.GetCount(); i++)
+   {
+      Light xsiLight(lightsArray[i]);
+      Primitive lightPrimitive = CObjectUtilities().GetPrimitiveAtCurrentFrame(xsiLight);
+      CRefArray nestedObjects = lightPrimitive.GetNestedObjects();
+      for (LONG j=0; j<nestedObjects.GetCount(); j++)
+      {
+         if (nestedObjects[j].GetClassID() == siGroupID && Group(nestedObjects[j]).GetMembers().GetCount() > 0)
+            return true;
+      }
+   }
+
+   return false;
+}
+
+
+// Return true if a material and its render tree don't change over the frame range.
+// The include file holds the shaders exported at the first frame, so animated parameters, 
+// image sequences and time sourced clips would be stuck on that frame.
+//
+// @param in_material        The Softimage material
+//
+// @return true if the material is static
+//
+static bool IsStaticMaterial(const Material &in_material)
+{
+   if (in_material.IsAnimated(siAnySource, false))
+      return false;
+
+   CRefArray shaders = in_material.GetAllShaders();
+   for (LONG i=0; i<shaders.GetCount(); i++)
+   {
+      Shader shader(shaders[i]);
+      if (shader.IsValid() && shader.IsAnimated(siAnySource, false))
+         return false;
+   }
+
+   CRefArray clips = in_material.GetAllImageClips();
+   for (LONG i=0; i<clips.GetCount(); i++)
+   {
+      ImageClip2 clip(clips[i]);
+      if (!clip.IsValid())
+         continue;
+      if (clip.IsAnimated(siAnySource, false))
+         return false;
+      // the frame of a time sourced clip comes from an attribute, that can change at any frame
+      if (!ParAcc_GetValue(clip, L"TimeSource", DBL_MAX).GetAsText().IsEmpty())
+         return false;
+      // image sequences (name.[1..100].pic) get a different file at each frame
+      if (ParAcc_GetValue(clip, L"SourceFileName", DBL_MAX).GetAsText().FindString(L"[") != UINT_MAX)
+         return false;
+   }
+
+   return true;
+}
+
+
+// Return true if a polymesh doesn't change over the given frames
+//
+// @param in_xsiObj          The Softimage polymesh
+// @param in_frames          The frames to check the kinematics and the visibility at
+// @param in_sampleFrames    The frames to check the deformation at
+// @param io_staticMaterials The materials checked so far, by id, with their result
+//
+// @return true if the polymesh is static
+//
+static bool IsStaticPolymesh(const X3DObject &in_xsiObj, const CDoubleArray &in_frames, const CDoubleArray &in_sampleFrames, 
+                             map <ULONG, bool> &io_staticMaterials)
+{
+   CRefArray properties = in_xsiObj.GetProperties();
+   // procedurals and volumes are not exported as polymeshes
+   if (properties.GetItem(L"arnold_procedural").IsValid() || properties.GetItem(L"arnold_volume").IsValid())
+      return false;
+
+   // the properties (visibility, arnold_parameters, geometry approximation, etc.) must not be animated.
+   // The kinematics are checked below, by the global transformation
+   for (LONG i=0; i<properties.GetCount(); i++)
+   {
+      Property prop(properties[i]);
+      if (prop.GetClassID() == siKinematicsID)
+         continue;
+      // the blobs are not animatable, but can be rewritten at any frame by some plugin
+      if (prop.GetType() == L"UserDataBlob")
+      {
+         UserDataBlob udb(prop);
+         if (!udb.IsEmpty())
+            return false;
+      }
+      else if (prop.IsAnimated(siAnySource, false))
+         return false;
+   }
+
+   // the shading, of the object and of its clusters
+   CRefArray materials = in_xsiObj.GetMaterials();
+   for (LONG i=0; i<materials.GetCount(); i++)
+   {
+      Material material(materials[i]);
+      if (!material.IsValid())
+         continue;
+
+      ULONG materialId = CObjectUtilities().GetId(material);
+      map <ULONG, bool>::iterator it = io_staticMaterials.find(materialId);
+      if (it == io_staticMaterials.end())
+         it = io_staticMaterials.insert(pair <ULONG, bool> (materialId, IsStaticMaterial(material))).first;
+      if (!it->second)
+         return false;
+   }
+
+   // an ICE tree can change the geometry or the attributes at any frame
+   CRefArray nestedObjects = in_xsiObj.GetActivePrimitive().GetNestedObjects();
+   for (LONG i=0; i<nestedObjects.GetCount(); i++)
+   {
+      if (nestedObjects[i].GetClassID() == siICETreeID)
+         return false;
+   }
+
+   // visibility and kinematics, at all the frames
+   Property visProperty;
+   in_xsiObj.GetPropertyFromName(L"Visibility", visProperty);
+   CMatrix4 matrix = in_xsiObj.GetKinematics().GetGlobal().GetTransform(in_frames[0]).GetMatrix4();
+
+   for (LONG i=0; i<in_frames.GetCount(); i++)
+   {
+      if (!(bool)ParAcc_GetValue(visProperty, L"rendvis", in_frames[i]))
+         return false;
+      if (i > 0 && !matrix.Equals(in_xsiObj.GetKinematics().GetGlobal().GetTransform(in_frames[i]).GetMatrix4()))
+         return false;
+   }
+
+   // deformation, at the sample frames only, since evaluating the geometry is expensive
+   PolygonMesh mesh = CObjectUtilities().GetGeometryAtFrame(in_xsiObj, siConstructionModeSecondaryShape, in_sampleFrames[0]);
+   CVector3Array points = mesh.GetPoints().GetPositionArray();
+
+   for (LONG i=1; i<in_sampleFrames.GetCount(); i++)
+   {
+      mesh = CObjectUtilities().GetGeometryAtFrame(in_xsiObj, siConstructionModeSecondaryShape, in_sampleFrames[i]);
+      CVector3Array samplePoints = mesh.GetPoints().GetPositionArray();
+      if (samplePoints.GetCount() != points.GetCount())
+         return false;
+      for (LONG j=0; j<points.GetCount(); j++)
+      {
+         if (!points[j].Equals(samplePoints[j]))
+            return false;
+      }
+   }
+
+   return true;
+}
+
+
+// Collect the polymeshes that don't change over the frame range.
+// Only polymeshes are considered, since hair and pointclouds are usually simulated.
+//
+// @param in_frameIni        The first frame
+// @param in_frameEnd        The last frame
+// @param in_frameStep       The frame step
+// @param in_selectedObjs    The selected objs to render (if in_selectionOnly==true)
+// @param in_selectionOnly   True is only in_selectedObjs must be rendered
+//
+void CStaticShapes::Classify(double in_frameIni, double in_frameEnd, double in_frameStep, CRefArray &in_selectedObjs, bool in_selectionOnly)
+{
+   Clear();
+
+   if (SceneHasAssociatedLights())
+   {
+      GetMessageQueue()->LogMsg(L"[sitoa] Static Geometry Include disabled, because some lights are associated to objects", siWarningMsg);
+      return;
+   }
+
+   CDoubleArray frames, sampleFrames;
+   for (double iframe = in_frameIni; iframe <= in_frameEnd; iframe += in_frameStep)
+      frames.Add(iframe);
+
+   if (frames.GetCount() < 2)
+      return;
+
+   // evenly spaced samples, including the first and the last frame
+   LONG nbSamples = min((LONG)STATIC_SHAPES_NB_DEFORMATION_SAMPLES, frames.GetCount());
+   for (LONG i=0; i<nbSamples; i++)
+      sampleFrames.Add(frames[(LONG)((double)i * (frames.GetCount() - 1) / (nbSamples - 1) + 0.5)]);
+
+   // the materials are usually shared by many objects, so check them only once
+   map <ULONG, bool> staticMaterials;
+
+   CRefArray polysArray = Application().GetActiveSceneRoot().FindChildren(L"", siPolyMeshType, CStringArray(), true);
+   for (LONG i=0; i<polysArray.GetCount(); i++)
+   {
+      if (in_selectionOnly && !ArrayContainsCRef(in_selectedObjs, polysArray[i]))
+         continue;
+
+      X3DObject xsiObj(polysArray[i]);
+      if (IsStaticPolymesh(xsiObj, frames, sampleFrames, staticMaterials))
+      {
+         m_objects.push_back(xsiObj);
+         m_ids.insert(CObjectUtilities().GetId(xsiObj));
+      }
+   }
+
+   GetMessageQueue()->LogMsg(L"[sitoa] Static Geometry Include: " + CValue((LONG)m_objects.size()).GetAsText() + L" of " + 
+                             CValue(polysArray.GetCount()).GetAsText() + L" polymeshes are static over the frame range");
+}
+
+
+// Return true if the object was classified as static
+//
+// @param in_xsiObj    The Softimage object
+//
+// @return true if the object is static
+//
+bool CStaticShapes::IsStatic(const X3DObject &in_xsiObj) const
+{
+   if (m_ids.empty())
+      return false;
+   return m_ids.find(CObjectUtilities().GetId(in_xsiObj)) != m_ids.end();
+}
+
+
+// Return the number of static objects
+//
+size_t CStaticShapes::GetCount() const
+{
+   return m_objects.size();
+}
+
+
+// Export the static objects in a universe of their own, and write them into the include file.
+// The universe is destroyed before returning, so this must be called before the frames loop.
+//
+// @param in_arnoldOptions   The Arnold Render Options property
+// @param in_includeName     The name of the include file
+// @param in_frame           The frame time the objects are exported at
+// @param in_selectedObjs    The selected objs to render (if in_selectionOnly==true)
+// @param in_selectionOnly   True is only in_selectedObjs must be rendered
+//
+// @return CStatus::OK if all went well, else the error CStatus
+//
+CStatus CStaticShapes::WriteInclude(const Property &in_arnoldOptions, const CPathString &in_includeName, double in_frame, CRefArray &in_selectedObjs, bool in_selectionOnly)
+{
+   m_includeName = in_includeName;
+
+   GetRenderInstance()->DestroyScene(false);
+   GetRenderInstance()->PolymeshShareCache().Clear();
+
+   AiBegin(GetSessionMode());
+   // the plugins, for the shaders assigned to the objects
+   GetRenderInstance()->GetPluginsSearchPath().Put(CPathUtilities().GetShadersPath(), true);
+   GetRenderInstance()->GetPluginsSearchPath().LoadPlugins();
+
+   GetParameterCache().Enable(true);
+   // the options, for the parameters that the polymeshes read from them (for instance the texture paths)
+   CStatus status = LoadOptions(in_arnoldOptions, in_frame);
+
+   CPolymeshShareCache *shareCache = NULL;
+   if (GetRenderOptions()->m_share_identical_polymeshes)
+      shareCache = &GetRenderInstance()->PolymeshShareCache();
+
+   for (vector <X3DObject>::iterator it = m_objects.begin(); it != m_objects.end() && status == CStatus::OK; it++)
+      status = LoadSinglePolymesh(*it, in_frame, in_selectedObjs, in_selectionOnly, shareCache);
+
+   GetParameterCache().Enable(false);
+   GetRenderInstance()->ExportJobQueue().Flush();
+   LogSharedPolymeshes();
+
+   if (status == CStatus::OK)
+   {
+      if (AiASSWrite(m_includeName.GetAsciiString(), AI_NODE_SHAPE + AI_NODE_SHADER, GetRenderOptions()->m_open_procs, GetRenderOptions()->m_binary_ass) == AI_SUCCESS)
+         GetMessageQueue()->LogMsg(L"[sitoa] Static Geometry Include written to " + m_includeName);
+      else
+         status = CStatus::Fail;
+   }
+
+   // don't leave a partial include, that the frames would reference
+   if (status != CStatus::OK)
+      remove(m_includeName.GetAsciiString());
+
+   GetRenderInstance()->PolymeshShareCache().Clear();
+   AiEnd();
+   GetRenderInstance()->DestroyScene(false);
+
+   return status;
+}
+
+
+// Create the procedural node referencing the include file into the current frame.
+// The static objects that were exported anyway (for instance postloaded as the masters of some instances)
+// are hidden, since their visible copy is the one in the include file.
+//
+// @param in_frame           The frame time
+//
+void CStaticShapes::LoadIncludeReference(double in_frame)
+{
+   for (vector <X3DObject>::iterator it = m_objects.begin(); it != m_objects.end(); it++)
+   {
+      AtNode* node = GetRenderInstance()->NodeMap().GetExportedNode(*it, in_frame);
+      if (node)
+         CNodeSetter::SetByte(node, "visibility", 0, true);
+   }
+
+   AtNode* procNode = AiNode("procedural");
+   if (!procNode)
+      return;
+
+   CNodeUtilities().SetName(procNode, CStringUtilities().MakeSItoAName(CValue(L"static_include"), in_frame, L"", false));
+
+   CPathString filename(m_includeName);
+   if (GetRenderOptions()->m_use_path_translations)
+      filename = CPathString(CPathTranslator::TranslatePath(m_includeName.GetAsciiString(), false));
+   CNodeSetter::SetString(procNode, "filename", filename.GetAsciiString());
+}
+
+
+// Clear the static objects
+//
+void CStaticShapes::Clear()
+{
+   m_objects.clear();
+   m_ids.clear();
+   m_includeName = L"";
+}
+
+
+// Return the static shapes of the current export
+//
+CStaticShapes& GetStaticShapes()
+{
+   static CStaticShapes staticShapes;
+   return staticShapes;
+}
+
@@ -0,0 +1,62 @@
+/************************************************************************************************************************************
+Copyright 2017 Autodesk, Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance with the License. 
+You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is distributed on an "AS IS" BASIS, 
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+See the License for the specific language governing permissions and limitations under the License.
+************************************************************************************************************************************/
+
+#pragma once
+
+#include "loader/PathTranslator.h"
+
+#include <xsi_doublearray.h>
+#include <xsi_property.h>
+#include <xsi_x3dobject.h>
+
+#include <set>
+#include <vector>
+
+using namespace std;
+using namespace XSI;
+
+// The polymeshes that don't change over the frame range of a .ass sequence export, 
+// neither in their geometry nor in their shading and properties.
+// They are exported only once, into an include file that is referenced by a procedural node 
+// in each frame file, so that the frame files only hold what actually changes.
+class CStaticShapes
+{
+private:
+   vector <X3DObject> m_objects;      // the static polymeshes
+   set <ULONG>        m_ids;          // the object ids of m_objects
+   CPathString        m_includeName;  // the name of the include .ass file
+
+public:
+   CStaticShapes()
+   {}
+
+   ~CStaticShapes()
+   {
+      Clear();
+   }
+
+   // Collect the polymeshes that don't change over the frame range
+   void Classify(double in_frameIni, double in_frameEnd, double in_frameStep, CRefArray &in_selectedObjs, bool in_selectionOnly);
+   // Return true if the object was classified as static
+   bool IsStatic(const X3DObject &in_xsiObj) const;
+   // Return the number of static objects
+   size_t GetCount() const;
+   // Export the static objects and write them into the include file
+   CStatus WriteInclude(const Property &in_arnoldOptions, const CPathString &in_includeName, double in_frame, CRefArray &in_selectedObjs, bool in_selectionOnly);
+   // Create the procedural node referencing the include file into the current frame
+   void LoadIncludeReference(double in_frame);
+   // Clear the static objects
+   void Clear();
+};
+
+// Return the static shapes of the current export
+CStaticShapes& GetStaticShapes();
+
@@ -9,9 +9,13 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and limitations under the License.
 ************************************************************************************************************************************/
 
+#include "common/WorkerPool.h"
 #include "loader/Strands.h"
 #include "renderer/Renderer.h"
 
+#include <algorithm>
+
+
 // Return the signed angle from in_v0 to in_v1 around in_axis.
 //
 // @param in_v0     The first vector
@@ -534,15 +538,22 @@ bool CStrand::GetSegmentTangent(CVector3f *out_result, const int in_index)
 }
 
 
-// Compute the length of the strand
+// Compute the length of the strand, and the length from the root to each point.
+// Must be called after the points are set, since the t-based queries below search into m_accLength
 void CStrand::ComputeLength()
 {
    CVector3f v;
+   int nbPoints = (int)m_points.size();
+   m_accLength.resize(nbPoints);
    m_length = 0.0f;
-   for (int i=0; i<(int)m_points.size()-1; i++)
+   for (int i=0; i<nbPoints; i++)
    {
-      v.Sub(m_points[i+1], m_points[i]);
-      m_length+= v.GetLength();
+      if (i > 0)
+      {
+         v.Sub(m_points[i], m_points[i-1]);
+         m_length+= v.GetLength();
+      }
+      m_accLength[i] = m_length;
    }
 }
 
@@ -554,16 +565,11 @@ void CStrand::ComputeLength()
 //
 float CStrand::ComputeLengthRatio(int in_index)
 {
-   CVector3f v;
-   if (in_index > (int)m_points.size())
-      in_index = (int)m_points.size();
-   float l = 0.0f;
-   for (int i=0; i<in_index; i++)
-   {
-      v.Sub(m_points[i+1], m_points[i]);
-      l+= v.GetLength();
-   }
-   return l/m_length;
+   if (m_accLength.empty())
+      return 0.0f;
+   if (in_index >= (int)m_accLength.size())
+      in_index = (int)m_accLength.size() - 1;
+   return m_accLength[in_index] / m_length;
 }
 
 
@@ -577,6 +583,8 @@ float CStrand::ComputeLengthRatio(int in_index)
 // in_t == 0.5 -> out_index = 1, out_remain = 0.5 
 // because in_t is between point 1 and 2, and exactly in the middle of them
 //
+// The segment is found by a binary search into the lengths computed by ComputeLength
+//
 // @param in_t           The length-wise t where to evaluate the strand
 // @param out_index      The index of the corresponding point of the strand
 // @param out_remain     The difference between in_t and returned point's t, norlalized against the segment's length
@@ -584,38 +592,27 @@ float CStrand::ComputeLengthRatio(int in_index)
 // 
 void CStrand::GetPointindexAlongLength(const float in_t, int *out_index, float *out_remain)
 {
+   *out_index = 0; //root
+   *out_remain = 0.0f;
    if (in_t <= 0.0f) 
-   {
-      *out_index = 0; //root
-      *out_remain = 0.0f;
       return;
-   }
-   if (in_t >= 1.0f)
-   {
-      *out_index = (int)m_points.size() - 1; //last
-      *out_remain = 0.0f;
+
+   int last = (int)m_points.size() - 1;
+   *out_index = last;
+   if (in_t >= 1.0f || m_accLength.size() != m_points.size())
       return;
-   }
 
-   float l, accL=0.0f;
-   CVector3f v;
+   float l = in_t * m_length; // the length from the root
+   // first point farther than l from the root. Zero length segments are skipped, as the point
+   // before them is as far as the point after
+   vector<float>::const_iterator it = upper_bound(m_accLength.begin(), m_accLength.end(), l);
+   if (it == m_accLength.end()) // can happen for in_t very close to 1
+      return;
 
-   for (int i=0; i<(int)m_points.size()-1; i++)
-   {
-      v.Sub(m_points[i+1], m_points[i]);
-      l = v.GetLength() / m_length; //dist to next point
-      if ( (accL + l) > in_t) //distance to (i+1)-th point would overtake t
-      {
-         *out_index = i;
-         float remainingT = in_t - accL; //remaining t
-         *out_remain = remainingT / l; //ratio against segment
-         //should always be 0 < remain < 1
-         // if (*out_remain > 1.0f) //test
-         //    *out_remain = *out_remain;
-         break;
-      }
-      accL+=l;
-   }
+   int index = (int)(it - m_accLength.begin()) - 1;
+   *out_index = index;
+   //should always be 0 < remain < 1
+   *out_remain = (l - m_accLength[index]) / (m_accLength[index+1] - m_accLength[index]);
 }
 
 
@@ -1118,12 +1115,10 @@ void CStrandInstance::Init(AtArray *in_vlist, AtArray *in_nlist, AtArray *in_vid
 {
    m_masterObject = in_masterObject;
    m_points.resize(AiArrayGetNumElements(in_vlist));
-   m_bendedPoints.resize(AiArrayGetNumElements(in_vlist));
    if (in_nlist)
    {
       m_normals.resize(AiArrayGetNumElements(in_nlist));
       m_pointAtNormals.resize(AiArrayGetNumElements(in_nlist));
-      m_bendedNormals.resize(AiArrayGetNumElements(in_nlist));
    }
 
    AtVector point;
@@ -1160,34 +1155,6 @@ void CStrandInstance::Init(AtArray *in_vlist, AtArray *in_nlist, AtArray *in_vid
 }
 
 
-// Return the vertices and normals TO an arnold shape
-//
-// @param io_vlist      The vertices array
-// @param io_nlist      The normals array
-// @param in_defKey     The deformation mb key
-// @return void
-// 
-void CStrandInstance::Get(AtArray *io_vlist, AtArray *io_nlist, const unsigned int in_defKey)
-{
-   AtVector current;
-
-   // get the bended points
-   if (io_vlist)
-   for (unsigned int i=0; i<AiArrayGetNumElements(io_vlist); i++)
-   {
-      m_bendedPoints[i].Get(current.x, current.y, current.z);
-      AiArraySetVec(io_vlist, in_defKey * AiArrayGetNumElements(io_vlist) + i, current);
-   }
-   // get the bended normals
-   if (io_nlist)
-   for (unsigned int i=0; i<AiArrayGetNumElements(io_nlist); i++)
-   {
-      m_bendedNormals[i].Get(current.x, current.y, current.z);
-      AiArraySetVec(io_nlist, in_defKey * AiArrayGetNumElements(io_nlist) + i, current);
-   }
-}
-
-
 // Compute the bounding cylinder for this object
 // @return void
 // 
@@ -1224,100 +1191,214 @@ void CStrandInstance::RemapPointsToCylinder()
 }
 
 
-// Bend the vertices and normals along a strand.
-// Store the bended points into this->bendedPoints
-// Store the bended normals into this->bendedNOrmals
+// Bend the i-th vertex along a strand.
+// Only reads the strand and this instance, so it can be called concurrently by several threads
 //
 // @param in_strand      The strand
+// @param in_index       The index of the vertex
+// @param out_point      The returned bended vertex
 // @return void
 // 
-void CStrandInstance::BendOnStrand(CStrand &in_strand)
+void CStrandInstance::BendPointOnStrand(CStrand &in_strand, const unsigned int in_index, AtVector &out_point)
+{
+   CVector3f pos;
+   CVector3f hx, hy; //bending coordinate system
+   CVector3f x, yCrossX;
+   CCylMappedPoint mappedPoint;
+
+   // get cylindrically mapped point
+   m_boundingCylinder.GetRemappedPoint(&mappedPoint, in_index);
+   // pos == point on in_strand at mappedPoint.m_height 
+   int index = in_strand.GetPositionByT(&pos, mappedPoint.m_height); //returning index of point "below" height
+
+   in_strand.GetSegmentDirection(&hy, index);
+   in_strand.ComputeBendedXDirectionByT(&hx, &hy, pos, mappedPoint.m_height);
+   // hx is the x axis, bended along the strand at mappedPoint.height
+   // hy is the bended y, ie the strand tangent at mappedPoint.height
+
+   // so, now we must rotate hx around hy by mappedPoint.angle
+   // this will give us the point correctly bended.
+   // ........ in mental ray this was
+   // ........ mi_matrix_rotate_axis(m, &hy, mappedPoint.angle);
+   // ........ mi_vector_transform(&x, &hx, m);
+   // We used to go through CTransformation and CMatrix3 in double precision, now we apply
+   // Rodrigues' formula in float: x = hx*cos + (hy^hx)*sin + hy*(hy.hx)*(1-cos)
+   float cosAngle = cosf(mappedPoint.m_angle);
+   float sinAngle = sinf(mappedPoint.m_angle);
+   yCrossX.Cross(hy, hx);
+   float yDotX = hy.Dot(hx) * (1.0f - cosAngle);
+   x.PutX(hx.GetX() * cosAngle + yCrossX.GetX() * sinAngle + hy.GetX() * yDotX);
+   x.PutY(hx.GetY() * cosAngle + yCrossX.GetY() * sinAngle + hy.GetY() * yDotX);
+   x.PutZ(hx.GetZ() * cosAngle + yCrossX.GetZ() * sinAngle + hy.GetZ() * yDotX);
+
+   // so, x is the unit vector from the strand to the bended point.
+   // we still have to set its length
+   // Get the ratio between the in_strand length and the master object height
+   // If the master was flat (a grid), set an arbitrary value of 1. Else, the instances would stretch way too much (#1151)
+   float stretch = m_boundingCylinder.m_height > 0.001f ? in_strand.m_length / m_boundingCylinder.m_height : 1.0f;
+   // scale the point's radius accordingly, so we don get FAT instances
+
+   // #1252. Scale (not set) the radius by the strand radius at this height. 
+   // I think it's more elegant to scale than to set, as long as it's documented
+   if (in_strand.m_radii.size() > 0)
+   {
+      float strandRadius;
+      in_strand.GetRadiusByT(&strandRadius, mappedPoint.m_height);
+      stretch*= strandRadius;
+   }
+
+   x.SetLength(mappedPoint.m_radius * stretch);
+
+   // and finally add it to the current strand position
+   pos+=x;
+   // give it to the arnold buffer
+   pos.Get(out_point.x, out_point.y, out_point.z);
+}
+
+
+// Bend the i-th normal along a strand.
+// Only reads the strand and this instance, so it can be called concurrently by several threads
+//
+// @param in_strand      The strand
+// @param in_index       The index of the normal
+// @param out_normal     The returned bended normal
+// @return void
+// 
+void CStrandInstance::BendNormalOnStrand(CStrand &in_strand, const unsigned int in_index, AtVector &out_normal)
 {
    CVector3f pos;
    CVector3f hx, hy, hz; //bending coordinate system
-   CVector3f x, center, v, dir, hDir, n, newV;
-   CVector3  x3, axis, hx3, hy3, hz3;
-   CTransformation trans;
-   int index;
+   CVector3f v, n;
    CCylMappedPoint mappedPoint;
-   float stretch;
 
-   // points
-   for (int i=0; i<(int)m_points.size(); i++)
+   m_boundingCylinder.GetRemappedPoint(&mappedPoint, m_pointAtNormals[in_index]);
+   int index = in_strand.GetPositionByT(&pos, mappedPoint.m_height);
+
+   in_strand.GetSegmentDirection(&hy, index);
+   in_strand.ComputeBendedXDirectionByT(&hx, &hy, pos, mappedPoint.m_height);
+   hz.Cross(hx, hy); //got the full reference axes
+   hz.NormalizeInPlace();
+
+   // get the i-th normal
+   v = m_normals[in_index];
+
+   // now transform the normal (v) to the current strand segment coords sys (hx, hy, hz)
+   n.PutX(hx.GetX() * v.GetX() + hy.GetX() * v.GetY() + hz.GetX() * v.GetZ());
+   n.PutY(hx.GetY() * v.GetX() + hy.GetY() * v.GetY() + hz.GetY() * v.GetZ());
+   n.PutZ(hx.GetZ() * v.GetX() + hy.GetZ() * v.GetY() + hz.GetZ() * v.GetZ());
+   // give it to the arnold buffer
+   n.NormalizeInPlace();
+   n.Get(out_normal.x, out_normal.y, out_normal.z);
+}
+
+
+////////////////////////////////////////
+////////////////////////////////////////
+////////////////////////////////////////
+// Parallel bending of a set of strand instances
+////////////////////////////////////////
+////////////////////////////////////////
+////////////////////////////////////////
+
+// The mapped buffers of a CStrandBendTask
+class CStrandBendBuffers
+{
+public:
+   CStrandInstance *m_instance;
+   CStrand         *m_strand;
+   AtVector        *m_points;
+   AtVector        *m_normals;
+   unsigned int     m_nbPoints, m_nbNormals;
+};
+
+
+// Parallel body bending the vertices and normals of all the tasks. 
+// The vertices and normals of all the tasks are laid out in a single index space, so that 
+// both many small instances and a few huge ones are split evenly across the threads
+class CStrandBendBody : public CParallelForBody
+{
+private:
+   const vector <CStrandBendBuffers> &m_buffers;
+   const vector <unsigned int>       &m_offsets; // the first index of each task, plus the total count
+
+public:
+   CStrandBendBody(const vector <CStrandBendBuffers> &in_buffers, const vector <unsigned int> &in_offsets)
+      : m_buffers(in_buffers), m_offsets(in_offsets)
+   {}
+
+   void Run(unsigned int in_begin, unsigned int in_end)
    {
-      // get cylindrically mapped point
-      m_boundingCylinder.GetRemappedPoint(&mappedPoint, i);
-      // pos == point on in_strand at mappedPoint.m_height 
-      index = in_strand.GetPositionByT(&pos, mappedPoint.m_height); //returning index of point "below" height
-
-      in_strand.GetSegmentDirection(&hy, index);
-      // in_strand.ComputeBendedXDirection(&hx, &hy, pos, index);
-      in_strand.ComputeBendedXDirectionByT(&hx, &hy, pos, mappedPoint.m_height);
-      // hx is the x axis, bended along the strand at mappedPoint.height
-      // hy is the bended y, ie the strand tangent at mappedPoint.height
-
-      // GetMessageQueue()->LogMsg(L"hx = " + (CString)hx.GetX() + L" " + (CString)hx.GetY() + L" " + (CString)hx.GetZ());
-
-      // so, now we must rotate hx around hy by mappedPoint.angle
-      // this will give us the point correctly bended.
-      // ........ in mental ray this was
-      // ........ mi_matrix_rotate_axis(m, &hy, mappedPoint.angle);
-      // ........ mi_vector_transform(&x, &hx, m);
-
-      // in Soft we must use a longer path, because CVector3f is not powerful enough
-      hx3.Set((double)hx.GetX(), (double)hx.GetY(), (double)hx.GetZ());
-      hy3.Set((double)hy.GetX(), (double)hy.GetY(), (double)hy.GetZ());
-
-      trans.SetRotationFromAxisAngle(hy3, mappedPoint.m_angle);   
-      CMatrix3 m3 = trans.GetRotationMatrix3();
-      x3.MulByMatrix3(hx3, m3);
-      x.Set((float)x3.GetX(), (float)x3.GetY(), (float)x3.GetZ());
-
-      // so, x is the unit vector from the strand to the bended point.
-      // we still have to set its length
-      // Get the ratio between the in_strand length and the master object height
-      // If the master was flat (a grid), set an arbitrary value of 1. Else, the instances would stretch way too much (#1151)
-      stretch = m_boundingCylinder.m_height > 0.001f ? in_strand.m_length / m_boundingCylinder.m_height : 1.0f;
-      // scale the point's radius accordingly, so we don get FAT instances
-
-      // #1252. Scale (not set) the radius by the strand radius at this height. 
-      // I think it's more elegant to scale than to set, as long as it's documented
-      if (in_strand.m_radii.size() > 0)
+      // the task holding in_begin
+      size_t iTask = upper_bound(m_offsets.begin(), m_offsets.end(), in_begin) - m_offsets.begin() - 1;
+      for (unsigned int i = in_begin; i < in_end; )
       {
-         float strandRadius;
-         in_strand.GetRadiusByT(&strandRadius, mappedPoint.m_height);
-         stretch*= strandRadius;
+         const CStrandBendBuffers &b = m_buffers[iTask];
+         unsigned int last = min(in_end, m_offsets[iTask+1]);
+         for (unsigned int local = i - m_offsets[iTask]; i < last; i++, local++)
+         {
+            if (local < b.m_nbPoints)
+               b.m_instance->BendPointOnStrand(*b.m_strand, local, b.m_points[local]);
+            else
+               b.m_instance->BendNormalOnStrand(*b.m_strand, local - b.m_nbPoints, b.m_normals[local - b.m_nbPoints]);
+         }
+         iTask++;
       }
+   }
+};
+
 
-      x.SetLength(mappedPoint.m_radius * stretch);
+// Bend a set of strand instances. Each task's instance is bended along its strand, and the result
+// written into the in_defKey-th key of its vlist and nlist arrays.
+// The arrays are mapped and unmapped by the calling thread, while the vertices and normals are
+// bended in parallel.
+//
+// @param in_tasks      The tasks
+// @return void
+// 
+void BendStrandInstances(vector <CStrandBendTask> &in_tasks)
+{
+   if (in_tasks.empty())
+      return;
 
-      // and finally add it to the current strand position
-      pos+=x;
-      // give it to the arnold buffer
-      m_bendedPoints[i] = pos;
+   vector <CStrandBendBuffers> buffers(in_tasks.size());
+   vector <unsigned int> offsets(in_tasks.size() + 1);
+   unsigned int count(0);
+
+   for (size_t i=0; i<in_tasks.size(); i++)
+   {
+      CStrandBendTask &task = in_tasks[i];
+      CStrandBendBuffers &b = buffers[i];
+      b.m_instance = task.m_instance;
+      b.m_strand = task.m_strand;
+      b.m_nbPoints = b.m_nbNormals = 0;
+      b.m_points = b.m_normals = NULL;
+      if (task.m_vlist)
+      {
+         b.m_nbPoints = (unsigned int)task.m_instance->m_points.size();
+         b.m_points = (AtVector*)AiArrayMap(task.m_vlist) + task.m_defKey * AiArrayGetNumElements(task.m_vlist);
+      }
+      if (task.m_nlist)
+      {
+         b.m_nbNormals = (unsigned int)task.m_instance->m_normals.size();
+         b.m_normals = (AtVector*)AiArrayMap(task.m_nlist) + task.m_defKey * AiArrayGetNumElements(task.m_nlist);
+      }
+
+      offsets[i] = count;
+      count+= b.m_nbPoints + b.m_nbNormals;
    }
-   //normals
-   for (int i=0; i<(int)m_normals.size(); i++)
+   offsets[in_tasks.size()] = count;
+
+   CStrandBendBody body(buffers, offsets);
+   CWorkerPool::ParallelFor(count, body, 1024);
+
+   for (size_t i=0; i<in_tasks.size(); i++)
    {
-      m_boundingCylinder.GetRemappedPoint(&mappedPoint, m_pointAtNormals[i]);
-      index = in_strand.GetPositionByT(&pos, mappedPoint.m_height);
-
-      in_strand.GetSegmentDirection(&hy, index);
-      // in_strand.ComputeBendedXDirection(&hx, &hy, pos, index);
-      in_strand.ComputeBendedXDirectionByT(&hx, &hy, pos, mappedPoint.m_height);
-      hz.Cross(hx, hy); //got the full reference axes
-      hz.NormalizeInPlace();
-
-      // get the i-th normal
-      v = m_normals[i];
-
-      // now transform the normal (v) to the current strand segment coords sys (hx, hy, hz)
-      n.PutX(hx.GetX() * v.GetX() + hy.GetX() * v.GetY() + hz.GetX() * v.GetZ());
-      n.PutY(hx.GetY() * v.GetX() + hy.GetY() * v.GetY() + hz.GetY() * v.GetZ());
-      n.PutZ(hx.GetZ() * v.GetX() + hy.GetZ() * v.GetY() + hz.GetZ() * v.GetZ());
-      // give it to the arnold buffer
-      m_bendedNormals[i].Normalize(n);
+      if (in_tasks[i].m_vlist)
+         AiArrayUnmap(in_tasks[i].m_vlist);
+      if (in_tasks[i].m_nlist)
+         AiArrayUnmap(in_tasks[i].m_nlist);
    }
 }
 
 
+
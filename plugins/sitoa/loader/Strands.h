@@ -135,6 +135,7 @@ public:
 
    // vector<CVector3f> m_uvs; // list of uv per strand
    float                  m_length;
+   vector<float>          m_accLength; // the length of the strand from the root to each point, set by ComputeLength
    vector<CVector3f>      m_X;
    float                  m_weightMapValue;
    CVector3f              m_tangentMapValue;
@@ -149,7 +150,7 @@ public:
 
    CStrand(const CStrand& arg)
    : m_points(arg.m_points), m_radii(arg.m_radii), m_vel(arg.m_vel), m_orientation(arg.m_orientation), m_mbPoints(arg.m_mbPoints), 
-     m_length(arg.m_length), m_X(arg.m_X), m_weightMapValue(arg.m_weightMapValue), m_tangentMapValue(arg.m_tangentMapValue)
+     m_length(arg.m_length), m_accLength(arg.m_accLength), m_X(arg.m_X), m_weightMapValue(arg.m_weightMapValue), m_tangentMapValue(arg.m_tangentMapValue)
    {
       // uvs = arg.uvs;
 #if USE_SURFACE_NORMALS
@@ -165,6 +166,7 @@ public:
       m_orientation.clear();
       m_mbPoints.clear();
       // m_uvs.clear(); 
+      m_accLength.clear();
       m_X.clear();
    }
 
@@ -217,7 +219,7 @@ public:
    bool GetSegmentDirection(CVector3f *out_result, const int in_index);
    // Get the tangent of the in_index-th point
    bool GetSegmentTangent(CVector3f *out_result, const int in_index);
-   // Compute the length of the strand
+   // Compute the length of the strand, and the length from the root to each point
    void ComputeLength();
    // Return the normalized length-wise height of the in_index-th point
    float ComputeLengthRatio(int in_index);
@@ -280,13 +282,11 @@ public:
 
 
 
-// CStrandInstance class. A copy of the shape to be cloned, and its bended version
+// CStrandInstance class. A copy of the shape to be cloned. The bended version is written straight into the Arnold arrays
 //
 // @param points           the input points of the master object
-// @param bendedPoints     the points after bending around a strand
 // @param normals          the input normals of the master object
 // @param pointAtNormals   index of position of the point of the normal
-// @param bendedNormals    the normals after bending around a strand
 // @param boundingCylinder the bounding cylinder
 // @param masterObject     the xsi object
 //
@@ -295,10 +295,8 @@ class CStrandInstance
 private:
 public:
    vector<CVector3f>    m_points;
-   vector<CVector3f>    m_bendedPoints;
    vector<CVector3f>    m_normals;
    vector<unsigned int> m_pointAtNormals;
-   vector<CVector3f>    m_bendedNormals;
 
    CBoundingCylinder      m_boundingCylinder;
    X3DObject              m_masterObject;
@@ -307,8 +305,7 @@ public:
    {}
 
    CStrandInstance(const CStrandInstance& arg)
-      : m_points(arg.m_points), m_bendedPoints(arg.m_bendedPoints), m_normals(arg.m_normals), 
-        m_pointAtNormals(arg.m_pointAtNormals), m_bendedNormals(arg.m_bendedNormals), 
+      : m_points(arg.m_points), m_normals(arg.m_normals), m_pointAtNormals(arg.m_pointAtNormals), 
         m_boundingCylinder(arg.m_boundingCylinder), m_masterObject(arg.m_masterObject)
    {
    }
@@ -320,28 +317,45 @@ public:
    ~CStrandInstance()
    {
       m_points.clear();
-      m_bendedPoints.clear();
       m_normals.clear();
       m_pointAtNormals.clear();
-      m_bendedNormals.clear();
    }
 
    // Init by an arnol polymesh
    void Init(AtArray *in_vlist, AtArray *in_nlist, AtArray *in_vidxs, AtArray *in_nidxs, 
              const CTransformation in_masterObjTransform, const X3DObject in_masterObj);
 
-   // Return the vertices and normals TO an arnold shape
-   void Get(AtArray *io_vlist, AtArray *io_nlist, const unsigned int in_defKey);
    // Compute the bounding cylinder for this object
 	void ComputeBoundingCylinder();
    // Compute and store the bounding cylinder of an array of CStrandInstances
 	void ComputeModelBoundingCylinder(vector <CStrandInstance> in_strandInstances);
    // Remap the points to cylindrical coordinates
 	void RemapPointsToCylinder();
-   // Bend the vertices and normals along a strand.
-   void BendOnStrand(CStrand &in_strand);
+   // Bend the i-th vertex along a strand
+   void BendPointOnStrand(CStrand &in_strand, const unsigned int in_index, AtVector &out_point);
+   // Bend the i-th normal along a strand
+   void BendNormalOnStrand(CStrand &in_strand, const unsigned int in_index, AtVector &out_normal);
 };
 
 
+// A strand instance to be bended along a strand, and the arrays (and motion key) where to write the result
+class CStrandBendTask
+{
+public:
+   CStrandInstance *m_instance;
+   CStrand         *m_strand;
+   AtArray         *m_vlist;
+   AtArray         *m_nlist;
+   unsigned int     m_defKey;
+
+   CStrandBendTask(CStrandInstance *in_instance, CStrand *in_strand, AtArray *in_vlist, AtArray *in_nlist, const unsigned int in_defKey)
+      : m_instance(in_instance), m_strand(in_strand), m_vlist(in_vlist), m_nlist(in_nlist), m_defKey(in_defKey)
+   {}
+};
+
+// Bend a set of strand instances. The vertices and normals of all the tasks are bended in parallel
+void BendStrandInstances(vector <CStrandBendTask> &in_tasks);
+
+
 
 
@@ -0,0 +1,286 @@
+/************************************************************************************************************************************
+Copyright 2017 Autodesk, Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance with the License. 
+You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is distributed on an "AS IS" BASIS, 
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+See the License for the specific language governing permissions and limitations under the License.
+************************************************************************************************************************************/
+
+#include "loader/UserData.h"
+
+#include <cstring>
+
+// these are the categories:
+// #define AI_USERDEF_UNDEFINED  0  // Undefined, you should never encounter a parameter of this category
+// #define AI_USERDEF_CONSTANT   1  // User-defined: per-object parameter
+// #define AI_USERDEF_UNIFORM    2  // User-defined: per-face parameter
+// #define AI_USERDEF_VARYING    3  // User-defined: per-vertex parameter
+
+// Return true if two arrays hold the same data
+//
+// @param in_a     The first array
+// @param in_b     The second array
+// @return true if the arrays have the same type, size and content
+//
+bool AreArraysEqual(AtArray* in_a, AtArray* in_b)
+{
+   if (!in_a || !in_b)
+      return false;
+   if (in_a == in_b)
+      return true;
+
+   uint8_t type = AiArrayGetType(in_a);
+   uint32_t nbElements = AiArrayGetNumElements(in_a);
+   uint8_t nbKeys = AiArrayGetNumKeys(in_a);
+   if (type != AiArrayGetType(in_b) || nbElements != AiArrayGetNumElements(in_b) || nbKeys != AiArrayGetNumKeys(in_b))
+      return false;
+   // arrays of strings or pointers can't be compared by memory
+   if (type == AI_TYPE_STRING || type == AI_TYPE_POINTER || type == AI_TYPE_NODE || type == AI_TYPE_ARRAY)
+      return false;
+
+   size_t size = (size_t)nbElements * nbKeys * AiParamGetTypeSize(type);
+   bool result = memcmp(AiArrayMap(in_a), AiArrayMap(in_b), size) == 0;
+   AiArrayUnmap(in_a);
+   AiArrayUnmap(in_b);
+   return result;
+}
+
+
+// Return the size in bytes of the data of an array
+//
+// @param in_array     The array
+// @return the size
+//
+size_t GetArrayDataSize(AtArray* in_array)
+{
+   if (!in_array)
+      return 0;
+   return (size_t)AiArrayGetNumElements(in_array) * AiArrayGetNumKeys(in_array) * AiParamGetTypeSize(AiArrayGetType(in_array));
+}
+
+
+// Return true if the shape referenced by a ginstance already holds the same non constant user data
+// that the master node has. In such case, there is no need to copy the data, since Arnold looks it up
+// on the referenced shape if the instance does not have it
+//
+// @param in_node        The ginstance node, already referencing its shape
+// @param in_masterNode  The node the user data is copied from
+// @param in_attrName    The attribute name
+// @param in_declaration The declaration string of the attribute, for instance "varying FLOAT"
+// @param in_indexed     True if the attribute is indexed
+// @return the number of bytes the instance can share, or 0 if the data must be copied
+//
+size_t GetSharedUserDataSize(AtNode* in_node, AtNode* in_masterNode, const string &in_attrName, const string &in_declaration, bool in_indexed)
+{
+   AtNode* shapeNode = (AtNode*)AiNodeGetPtr(in_node, "node");
+   if (!shapeNode)
+      return 0;
+
+   const AtUserParamEntry *shapeEntry = AiNodeLookUpUserParameter(shapeNode, in_attrName.c_str());
+   if (!shapeEntry || GetUserParamaterDeclarationString(shapeEntry) != in_declaration)
+      return 0;
+
+   AtArray* masterArray = AiNodeGetArray(in_masterNode, in_attrName.c_str());
+   if (!AreArraysEqual(masterArray, AiNodeGetArray(shapeNode, in_attrName.c_str())))
+      return 0;
+
+   size_t result = GetArrayDataSize(masterArray);
+   if (in_indexed)
+   {
+      string indexesName = in_attrName + "idxs";
+      AtArray* masterIndexes = AiNodeGetArray(in_masterNode, indexesName.c_str());
+      if (!AreArraysEqual(masterIndexes, AiNodeGetArray(shapeNode, indexesName.c_str())))
+         return 0;
+      result+= GetArrayDataSize(masterIndexes);
+   }
+
+   return result;
+}
+
+
+// Return the number of bytes of a non constant user data that a ginstance can share with its shape, or 0.
+// The data of a master is compared with the shape's only for its first instance, the next ones
+// just get the result and the size back
+//
+// @param in_node        The ginstance node, already referencing its shape
+// @param in_masterNode  The node the user data is copied from
+// @param in_attrName    The attribute name
+// @param in_declaration The declaration string of the attribute, for instance "varying FLOAT"
+// @param in_indexed     True if the attribute is indexed
+// @return the number of bytes the instance can share, or 0 if the data must be copied
+//
+size_t CSharedUserData::GetSize(AtNode* in_node, AtNode* in_masterNode, const string &in_attrName, const string &in_declaration, bool in_indexed)
+{
+   pair <AtNode*, string> key(in_masterNode, in_attrName);
+   map <pair <AtNode*, string>, size_t>::iterator it = m_sizes.find(key);
+   if (it != m_sizes.end())
+      return it->second;
+
+   size_t size = GetSharedUserDataSize(in_node, in_masterNode, in_attrName, in_declaration, in_indexed);
+   m_sizes.insert(pair <pair <AtNode*, string>, size_t> (key, size));
+   return size;
+}
+
+
+// Copy the attributes from in_masterNode to in_node
+// in_node is a ginstance, already referencing its shape. in_masterNode is either a ginstance referencing 
+// the same shape, or a shape with the same geometry (see CPolymeshShareCache).
+// If io_sharedUserData is given, the uniform, varying and indexed data that the shape already holds
+// is not copied, and in_node reads it from the shape.
+// The constant data are always copied, since they can be overrides of the shape ones.
+//
+// @param in_node            The target node to which the attributes must be copied
+// @param in_masterNode      The input node where to copy the attributes from
+// @param io_sharedUserData  If not NULL, share the non constant data with the shape, if possible
+//
+void CloneNodeUserData(AtNode* in_node, AtNode* in_masterNode, CSharedUserData *io_sharedUserData)
+{
+   AtUserParamIterator *iter = AiNodeGetUserParamIterator(in_masterNode);
+   // iterate all the user attributes
+   while (!AiUserParamIteratorFinished(iter))
+   {
+      const AtUserParamEntry *upentry = AiUserParamIteratorGetNext(iter);
+      // attribute name
+      string attrName(AiUserParamGetName(upentry));
+      // get the declaration string of the attribute, for instance "uniform FLOAT"
+      string declarationString = GetUserParamaterDeclarationString(upentry);
+      if (declarationString == "") // something went wrong
+         continue;
+
+      int category = AiUserParamGetCategory(upentry);
+      if (io_sharedUserData && category > 1) // not constant. If the shape holds the same data, don't declare it at all
+      {
+         size_t size = io_sharedUserData->GetSize(in_node, in_masterNode, attrName, declarationString, category == 4);
+         if (size > 0)
+         {
+            io_sharedUserData->m_bytes+= size;
+            continue;
+         }
+      }
+
+      // declare the attribute on in_node
+      if (AiNodeDeclare(in_node, attrName.c_str(), declarationString.c_str()))
+      {
+         // constant attributes (just one value). Copy it
+         if (declarationString == "constant BOOL")
+            AiNodeSetBool(in_node, attrName.c_str(), AiNodeGetBool(in_masterNode, attrName.c_str()));
+         else if (declarationString == "constant INT")
+            AiNodeSetInt(in_node, attrName.c_str(), AiNodeGetInt(in_masterNode, attrName.c_str()));
+         else if (declarationString == "constant FLOAT")
+            AiNodeSetFlt(in_node, attrName.c_str(), AiNodeGetFlt(in_masterNode, attrName.c_str()));
+         else if (declarationString == "constant VECTOR")
+         {
+            AtVector v = AiNodeGetVec(in_masterNode, attrName.c_str());
+            AiNodeSetVec(in_node, attrName.c_str(), v.x, v.y, v.z);
+         }
+         else if (declarationString == "constant RGB")
+         {
+            AtRGB c = AiNodeGetRGB(in_masterNode, attrName.c_str());
+            AiNodeSetRGB(in_node, attrName.c_str(), c.r, c.g, c.b);
+         }
+         else if (declarationString == "constant RGBA")
+         {
+            AtRGBA c = AiNodeGetRGBA(in_masterNode, attrName.c_str());
+            AiNodeSetRGBA(in_node, attrName.c_str(), c.r, c.g, c.b, c.a);
+         }
+         else // constant array, or uniform or varying or indexed data: clone the array
+         {
+            AiNodeSetArray(in_node, attrName.c_str(), AiArrayCopy(AiNodeGetArray(in_masterNode, attrName.c_str())));
+            if (AiUserParamGetCategory(upentry) == 4) // indexed? Also copy the idxs array
+            {
+               string indexesName = attrName + "idxs";
+               AiNodeSetArray(in_node, indexesName.c_str(), AiArrayCopy(AiNodeGetArray(in_masterNode, indexesName.c_str())));
+            }
+         }
+      }
+   }
+   AiUserParamIteratorDestroy(iter);
+}
+
+
+// Return the declaration string for an attribute, pointed by in_upentry
+//
+// @param in_upentry  The user attribute
+// @return the declaration string (for instance "varying INT"), or "" in case of error 
+//
+string GetUserParamaterDeclarationString(const AtUserParamEntry *in_upentry)
+{
+   string result;
+   string categories[4] = {"constant", "uniform", "varying", "indexed"};
+
+   int attrCat = AiUserParamGetCategory(in_upentry);
+
+   if (attrCat < 1 || attrCat > 4)
+      return ""; // error
+   else
+      result = categories[attrCat-1];
+
+   int attrType = AiUserParamGetType(in_upentry);
+
+   switch (attrType)
+   {
+      case AI_TYPE_BOOLEAN:
+         result+= " BOOL";
+         break;
+      case AI_TYPE_INT:
+         result+= " INT";
+         break;
+      case AI_TYPE_FLOAT:
+         result+= " FLOAT";
+         break;
+      case AI_TYPE_VECTOR:
+         result+= " VECTOR";
+         break;
+      case AI_TYPE_RGB:
+         result+= " RGB";
+         break;
+      case AI_TYPE_RGBA:
+         result+= " RGBA";
+         break;
+      case AI_TYPE_VECTOR2:
+         result+= " VECTOR2";
+         break;
+      case AI_TYPE_ARRAY:
+         result+= " ARRAY";
+         break;
+      default: // unsupported attribute type
+         return "";
+   }
+
+   if (attrType == AI_TYPE_ARRAY)
+   {
+      attrType = AiUserParamGetArrayType(in_upentry);
+
+      switch (attrType)
+      {
+         case AI_TYPE_BOOLEAN:
+            result+= " BOOL";
+            break;
+         case AI_TYPE_INT:
+            result+= " INT";
+            break;
+         case AI_TYPE_FLOAT:
+            result+= " FLOAT";
+            break;
+         case AI_TYPE_VECTOR:
+            result+= " VECTOR";
+            break;
+         case AI_TYPE_RGB:
+            result+= " RGB";
+            break;
+         case AI_TYPE_RGBA:
+            result+= " RGBA";
+            break;
+         case AI_TYPE_VECTOR2:
+            result+= " VECTOR2";
+            break;
+         default: // unsupported attribute type
+            return "";
+      }
+   }
+
+   return result;
+}
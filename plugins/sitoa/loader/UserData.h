@@ -0,0 +1,50 @@
+/************************************************************************************************************************************
+Copyright 2017 Autodesk, Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance with the License. 
+You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is distributed on an "AS IS" BASIS, 
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+See the License for the specific language governing permissions and limitations under the License.
+************************************************************************************************************************************/
+
+#pragma once
+
+#include <ai_nodes.h>
+
+#include <map>
+#include <string>
+
+using namespace std;
+
+// The non constant user data of the master ginstances that their instances share with the shapes,
+// instead of copying it (see CloneNodeUserData).
+// All the instances of a master reference the same shape, so whether a master attribute can be shared
+// is computed once, and not again for each of the instances
+class CSharedUserData
+{
+private:
+   map <pair <AtNode*, string>, size_t> m_sizes; // by master node and attribute, the bytes that can be shared, or 0
+
+public:
+   size_t m_bytes; // the bytes shared instead of being copied, for the export log
+
+   CSharedUserData() : m_bytes(0)
+   {}
+
+   // Return the number of bytes of a non constant user data that a ginstance can share with its shape, or 0
+   size_t GetSize(AtNode* in_node, AtNode* in_masterNode, const string &in_attrName, const string &in_declaration, bool in_indexed);
+};
+
+
+// Return true if two arrays hold the same data
+bool AreArraysEqual(AtArray* in_a, AtArray* in_b);
+// Return the size in bytes of the data of an array
+size_t GetArrayDataSize(AtArray* in_array);
+// Return the number of bytes of a non constant user data that a ginstance can share with its shape, or 0
+size_t GetSharedUserDataSize(AtNode* in_node, AtNode* in_masterNode, const string &in_attrName, const string &in_declaration, bool in_indexed);
+// Copy the attributes from in_masterNode to in_node
+void CloneNodeUserData(AtNode* in_node, AtNode* in_masterNode, CSharedUserData *io_sharedUserData = NULL);
+// Return the declaration string for an attribute, pointed by in_upentry
+string GetUserParamaterDeclarationString(const AtUserParamEntry *in_upentry);
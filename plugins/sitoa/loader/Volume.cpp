@@ -143,7 +143,7 @@ CStatus LoadSingleVolume(const X3DObject &in_xsiObj, double in_frame, CRefArray
    {
       // Get the transform matrix
       AtMatrix matrix;
-      CUtilities().S2A(in_xsiObj.GetKinematics().GetGlobal().GetTransform(keyFramesTransform[ikey]).GetMatrix4(), matrix);
+      GetRenderInstance()->TransformCache().GetGlobalMatrix(in_xsiObj, keyFramesTransform[ikey], matrix);
       AiArraySetMtx(matrices, ikey, matrix);
    }
 
@@ -15,6 +15,9 @@ See the License for the specific language governing permissions and limitations
 
 #include <ai_nodes.h>
 
+#include <string>
+#include <unordered_map>
+
 
 struct AtNodeLookupKey
 {
@@ -43,6 +46,47 @@ typedef pair<AtNodeLookupKey, AtNode*> AtNodeLookupPair;
 typedef AtNodeLookupMap::iterator AtNodeLookupIt;
 
 
+// The hashed version of AtNodeLookupKey, used by CNodeMap.
+// The object name is replaced by the id it was given when interned by the map,
+// so that the key can be hashed and compared in constant time.
+struct AtNodeIdKey
+{
+   unsigned int m_nameId;
+   LONG         m_frame;
+
+   AtNodeIdKey() : m_nameId(0), m_frame(0)
+   {}
+
+   AtNodeIdKey(unsigned int in_nameId, double in_frame)
+   {
+      m_nameId = in_nameId;
+      m_frame = CTimeUtilities().FrameTimes1000(in_frame);
+   }
+
+   bool operator == (const AtNodeIdKey & other) const
+   {
+      return m_nameId == other.m_nameId && m_frame == other.m_frame;
+   }
+};
+
+
+struct AtNodeIdKeyHash
+{
+   size_t operator () (const AtNodeIdKey &in_key) const
+   {
+      // the frames of a map are a few, and close, so shift them above the ids
+      return (size_t)in_key.m_nameId ^ ((size_t)in_key.m_frame << 20) ^ ((size_t)in_key.m_frame >> 12);
+   }
+};
+
+
+typedef unordered_map<AtNodeIdKey, AtNode*, AtNodeIdKeyHash> AtNodeIdMap;
+typedef AtNodeIdMap::iterator AtNodeIdIt;
+// reverse index, from the node to its key(s)
+typedef unordered_multimap<AtNode*, AtNodeIdKey> AtNodeReverseMap;
+typedef AtNodeReverseMap::iterator AtNodeReverseIt;
+
+
 // This is the key for the shader map, which needs the shader's id as key.
 // Else, shared shaders are entered many times, if using the shader name as we do.
 // An alternative would be to use the name and, for a given shader, the name provided by 
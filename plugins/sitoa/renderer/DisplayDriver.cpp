@@ -68,9 +68,9 @@ bool CDisplayDriverData::IsBucketOutsideView(const int in_bucket_xo, const int i
    if (!m_overscan)
       return false;
 
-   return in_bucket_xo + in_bucket_size_x < 0  || // right-most corner is on the left edge of view
+   return in_bucket_xo + in_bucket_size_x <= 0 || // right-most corner is on the left edge of view
           in_bucket_xo > m_display_window.maxx || // left-most corner is on the right edge of view
-          in_bucket_yo + in_bucket_size_y < 0  || // top-most corner is below the bottom edge of view
+          in_bucket_yo + in_bucket_size_y <= 0 || // top-most corner is below the bottom edge of view
           in_bucket_yo > m_display_window.maxy;   // bottom-most corner is above the top edge of view
 }
 
@@ -95,22 +95,6 @@ bool CDisplayDriverData::IsBucketInsideView(const int in_bucket_xo, const int in
 }
 
 
-// Check if a pixel is inside the render view, ie not in the overscan frame
-//
-// @param in_x        the pixel's x
-// @param in_y        the pixel's y
-//
-// @return true if the pixel is part of the render view, alse false
-//
-bool CDisplayDriverData::IsPixelInsideView(const int in_x, const int in_y)
-{
-   if (!m_overscan)
-      return true;
-
-   return in_x >= 0 && in_x <= m_display_window.maxx && in_y >= 0 && in_y <= m_display_window.maxy;
-}
-
-
 // Compute the intersection between the renderview and a bucket
 //
 // @param in_bucket_xo         the bucket's min x
@@ -153,6 +137,27 @@ unsigned int CDisplayDriverData::BucketInViewSize(const int in_bucket_xo, const
 }
 
 
+// Return the buffer of a render thread, grown to hold at least in_size pixels.
+// Since each thread only accesses its own buffer, no locking is needed, and the 
+// buffer is allocated just a few times per render instead of once per bucket
+//
+// @param in_tid       the render thread id
+// @param in_size      the number of pixels needed
+//
+// @return the buffer, or NULL if in_tid is out of range
+//
+AtRGBA* CDisplayDriverData::GetThreadBuffer(const uint16_t in_tid, const unsigned int in_size)
+{
+   if (in_tid >= AI_MAX_THREADS)
+      return NULL;
+
+   vector <AtRGBA> &buffer = m_buffers[in_tid];
+   if (buffer.size() < in_size)
+      buffer.resize(in_size);
+   return buffer.data();
+}
+
+
 node_parameters {}
 
 node_initialize
@@ -184,9 +189,7 @@ driver_prepare_bucket {}
 driver_process_bucket
 {
    const void*   bucket_data;
-   int           i, j, pixel_type;
-   AtRGB         rgb;
-   AtRGBA        rgba;
+   int           pixel_type;
    const char*   aov_name;
 
    CDisplayDriverData *ddData = (CDisplayDriverData*)AiNodeGetLocalData(node);
@@ -227,82 +230,35 @@ driver_process_bucket
    unsigned int view_bucket_xo, view_bucket_yo, view_bucket_size_x, view_bucket_size_y;
    int view_bucket_size = ddData->BucketInViewSize(bucket_xo, bucket_yo, bucket_size_x, bucket_size_y,
                                                    view_bucket_xo, view_bucket_yo, view_bucket_size_x, view_bucket_size_y);
-   // buffer to be sent to Softimage
-   AtRGBA *buffer = new AtRGBA[view_bucket_size];
-
-   int buffer_index(0); // index for the Softimage buffer
-   int bucket_column, bucket_zero_column;
-
-   int bucket_max_x = bucket_xo + bucket_size_x;
-   int bucket_max_y = bucket_yo + bucket_size_y;
-
-   switch (pixel_type)
+   // buffer to be sent to Softimage, reused by this thread for the next buckets
+   vector <AtRGBA> localBuffer;
+   AtRGBA *buffer = ddData->GetThreadBuffer(tid, view_bucket_size);
+   if (!buffer)
    {
-      case AI_TYPE_RGBA:
-         for (j = bucket_yo; j < bucket_max_y; j++)
-         {
-            bucket_zero_column = (j - bucket_yo) * bucket_size_x;
-            for (i = bucket_xo; i < bucket_max_x; i++)
-            {
-               // if all is correct, buffer_index will never overtake view_bucket_size, 
-               // however let's protect the render view buffer. Also, this will avoid 
-               // (because eventually buffer_index == view_bucket_size) the check below
-               // for the remaining pixels, that should all be outside the view.
-               if (buffer_index >= view_bucket_size)
-                   break;
-               // skip pixels in the overscan frame
-               if (!ddData->IsPixelInsideView(i, j))
-                   continue;
-
-               bucket_column = i - bucket_xo; // always positive
-               buffer[buffer_index] = ((AtRGBA*)bucket_data)[bucket_zero_column + bucket_column];
-               buffer_index++;
-            }
-         }
-         break;
+      localBuffer.resize(view_bucket_size);
+      buffer = localBuffer.data();
+   }
 
-      case AI_TYPE_VECTOR:
-      case AI_TYPE_RGB:
-         for (j = bucket_yo; j < bucket_max_y; j++)
-         {
-            bucket_zero_column = (j - bucket_yo) * bucket_size_x;
-            for (i = bucket_xo; i < bucket_max_x; i++)
-            {
-               if (buffer_index >= view_bucket_size)
-                   break;
-               if (!ddData->IsPixelInsideView(i, j))
-                   continue;
-
-               bucket_column = i - bucket_xo;
-               rgb = ((AtRGB*)bucket_data)[bucket_zero_column + bucket_column];
-               buffer[buffer_index].r = rgb.r;
-               buffer[buffer_index].g = rgb.g;
-               buffer[buffer_index].b = rgb.b;
-               buffer[buffer_index].a = 1.0f;
-               buffer_index++;
-            }
-         }
-         break;
+   // copy the in-view rectangle row by row. The first pixel of the rectangle in the Arnold bucket is at
+   // (view_bucket_xo - bucket_xo, view_bucket_yo - bucket_yo)
+   int bucket_offset = (view_bucket_yo - bucket_yo) * bucket_size_x + (view_bucket_xo - bucket_xo);
+   AtRGBA *buffer_row = buffer;
 
-      case AI_TYPE_FLOAT:
-         rgba.a = 1.0f;
-         for (j = bucket_yo; j < bucket_max_y; j++)
-         {
-            bucket_zero_column = (j - bucket_yo) * bucket_size_x;
-            for (i = bucket_xo; i < bucket_max_x; i++)
-            {
-               if (buffer_index >= view_bucket_size)
-                   break;
-               if (!ddData->IsPixelInsideView(i, j))
-                   continue;
-
-               bucket_column = i - bucket_xo;
-               rgba.r = rgba.g = rgba.b = ((float*)bucket_data)[bucket_zero_column + bucket_column];
-               buffer[buffer_index] = rgba;
-               buffer_index++;
-            }
-         }
-         break;
+   for (unsigned int row = 0; row < view_bucket_size_y; row++, bucket_offset+= bucket_size_x, buffer_row+= view_bucket_size_x)
+   {
+      switch (pixel_type)
+      {
+         case AI_TYPE_RGBA:
+            memcpy(buffer_row, (const AtRGBA*)bucket_data + bucket_offset, view_bucket_size_x * sizeof(AtRGBA));
+            break;
+         case AI_TYPE_VECTOR:
+         case AI_TYPE_RGB:
+            CUtilities().ExpandRGBToRGBA((const AtRGB*)bucket_data + bucket_offset, buffer_row, view_bucket_size_x);
+            break;
+         case AI_TYPE_FLOAT:
+            CUtilities().ExpandFloatToRGBA((const float*)bucket_data + bucket_offset, buffer_row, view_bucket_size_x);
+            break;
+      }
    }
 
    if (!renderInstance->InterruptRenderSignal())
@@ -323,8 +279,6 @@ driver_process_bucket
        
       displayDriver->m_renderContext.NewFragment(fragment);
    }
-
-   delete[] buffer;
 }
 
 
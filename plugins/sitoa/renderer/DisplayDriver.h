@@ -13,7 +13,12 @@ See the License for the specific language governing permissions and limitations
 
 #include <xsi_renderercontext.h>
 
+#include <ai_threads.h>
+
+#include <vector>
+
 using namespace XSI;
+using namespace std;
 
 
 // This class to manage the rendering overscan vs the Softimage render view
@@ -24,6 +29,8 @@ private:
    bool    m_overscan;       // is overscan enabled ?
    AtBBox2 m_display_window; // the render view window, without overscan
    AtBBox2 m_data_window;    // can be negative if overscan enabled
+   // the buffers sent to Softimage, one per render thread, reused bucket after bucket
+   vector <AtRGBA> m_buffers[AI_MAX_THREADS];
 
 public:
    CDisplayDriverData() : m_overscan(false),
@@ -38,13 +45,13 @@ public:
    // Check if a bucket is completely inside the render view, ie with no intersection with the overscan frame
    bool IsBucketInsideView(const int in_bucket_xo, const int in_bucket_yo, 
                            const int in_bucket_size_x, const int in_bucket_size_y);
-   // Check if a pixel is inside the render view, ie not in the overscan frame
-   bool IsPixelInsideView(const int in_x, const int in_y);
    // Compute the intersection between the renderview and a bucket
    unsigned int BucketInViewSize(const int in_bucket_xo, const int in_bucket_yo, 
                                  const int in_bucket_size_x, const int in_bucket_size_y,
                                  unsigned int &out_bucket_xo, unsigned int &out_bucket_yo, 
                                  unsigned int &out_bucket_size_x, unsigned int &out_bucket_size_y);
+   // Return the buffer of a render thread, grown to hold at least in_size pixels
+   AtRGBA* GetThreadBuffer(const uint16_t in_tid, const unsigned int in_size);
 
    int m_progressivePasses;
 };
@@ -12,6 +12,7 @@ See the License for the specific language governing permissions and limitations
 #include "common/ParamsCommon.h"
 #include "common/ParamsLight.h"
 #include "common/Tools.h"
+#include "loader/Polymeshes.h"
 #include "loader/Properties.h"
 #include "renderer/IprCommon.h"
 #include "renderer/Renderer.h"
@@ -124,6 +125,32 @@ void UpdateShapeMatrix(X3DObject &in_xsiObj, double in_frame)
 }
 
 
+// Update the geometry (points, normals, clusters and uvs) of a polymesh in place, 
+// instead of destroying and reloading the whole scene
+//
+// @param in_xsiObj   the Softimage polymesh
+// @param in_frame    the frame time
+//
+// @return false if the mesh was not exported or if its topology changed, so that a scene rebuild is needed
+//
+bool UpdateShapeGeometry(const X3DObject &in_xsiObj, double in_frame)
+{
+   if (in_xsiObj.GetType() != siPolyMeshType)
+      return false;
+
+   double frame(in_frame);
+   // as for UpdateShapeMatrix, in flythrough mode the node was created at time flythrough_frame
+   if (GetRenderOptions()->m_ipr_rebuild_mode == eIprRebuildMode_Flythrough)
+      frame = GetRenderInstance()->GetFlythroughFrame();
+
+   AtNode* node = GetRenderInstance()->NodeMap().GetExportedNode(in_xsiObj, frame);
+   if (!node)
+      return false;
+
+   return UpdateSinglePolymeshGeometry(in_xsiObj, node, in_frame);
+}
+
+
 // Computes the matrix of an instanced object. See Instance.cpp comments when setting ginstanceName
 // 
 // @param in_nodeParentList   the array of strings associated with the ginstance name
@@ -135,7 +162,7 @@ void UpdateShapeMatrix(X3DObject &in_xsiObj, double in_frame)
 CMatrix4 GetTheNodeMatrix(CStringArray &in_nodeParentList, const X3DObject &in_xsiObj, double in_frame)
 {
    CMatrix4 resultMatrix, modelMasterMatrix, instancedModelMatrix;
-   CMatrix4 objMatrix = in_xsiObj.GetKinematics().GetGlobal().GetTransform(in_frame).GetMatrix4();
+   CMatrix4 objMatrix = GetRenderInstance()->TransformCache().GetGlobalTransform(in_xsiObj, in_frame).GetMatrix4();
    CRef ref;
    Model instanceModel, modelMaster;
    CString modelInstanceName;
@@ -154,12 +181,12 @@ CMatrix4 GetTheNodeMatrix(CStringArray &in_nodeParentList, const X3DObject &in_x
       Model instanceModel(ref);
       modelMaster = instanceModel.GetInstanceMaster();
       // get the model master matrix and invert it
-      modelMasterMatrix = modelMaster.GetKinematics().GetGlobal().GetTransform(in_frame).GetMatrix4();
+      modelMasterMatrix = GetRenderInstance()->TransformCache().GetGlobalTransform(modelMaster, in_frame).GetMatrix4();
       modelMasterMatrix.InvertInPlace();
       // by multiplying, we basically have the matrix of the object with respect to the model master
       objMatrix.MulInPlace(modelMasterMatrix);
       // get the matrix of the instanced model
-      instancedModelMatrix = instanceModel.GetKinematics().GetGlobal().GetTransform(in_frame).GetMatrix4();
+      instancedModelMatrix = GetRenderInstance()->TransformCache().GetGlobalTransform(instanceModel, in_frame).GetMatrix4();
       // multiply to get the absolute matrix of the instanced object
       resultMatrix.Mul(objMatrix, instancedModelMatrix);
       objMatrix = resultMatrix;
@@ -228,7 +255,7 @@ void UpdateNodeMatrix(AtNode* in_node, const X3DObject &in_xsiObj, double in_fra
       }
       else //plain matrix
       {
-         theMatrix = in_xsiObj.GetKinematics().GetGlobal().GetTransform(transfKeys[iKey]).GetMatrix4();
+         theMatrix = GetRenderInstance()->TransformCache().GetGlobalTransform(in_xsiObj, transfKeys[iKey]).GetMatrix4();
          // if this is a photometric_light, we must conform the spot axes to the lights' one
          if (AiNodeIs(in_node, ATSTRING::photometric_light))
             theMatrix = TransformToPhotometricLight(theMatrix);
@@ -22,6 +22,8 @@ using namespace XSI;
 void UpdateShapeMatrix(X3DObject &in_xsiObj, double in_frame);
 // Update the matrix of a node originated by a Softimage object or model
 void UpdateNodeMatrix(AtNode *in_node, const X3DObject &in_xsiObj, double in_frame);
+// Update the geometry of a polymesh in place, if its topology did not change
+bool UpdateShapeGeometry(const X3DObject &in_xsiObj, double in_frame);
 // Update the objects that depend on an Arnold Parameters property
 void UpdateParameters(const CustomProperty &in_cp, double in_frame);
 // Update an object that depends on an Arnold Parameters property
@@ -30,6 +30,7 @@ See the License for the specific language governing permissions and limitations
 #include "renderer/RenderMessages.h"
 #include "renderer/RenderTree.h"
 
+#include <xsi_kinematics.h>
 #include <xsi_project.h>
 #include <xsi_scene.h>
 
@@ -38,7 +39,64 @@ See the License for the specific language governing permissions and limitations
 
 void CNodeMap::Clear()
 {
+   AiCritSecEnter(&m_cs);
    m_map.clear();
+   m_nodes.clear();
+   m_nameIds.clear();
+   m_names.clear();
+   AiCritSecLeave(&m_cs);
+}
+
+
+// Return the id of a name, interning it if required
+//
+// @param in_name          the object name
+//
+// @return                 the name id
+//
+unsigned int CNodeMap::InternName(const CString &in_name)
+{
+   pair<unordered_map<wstring, unsigned int>::iterator, bool> ins = 
+      m_nameIds.insert(pair<wstring, unsigned int>(in_name.GetWideString(), (unsigned int)m_names.size()));
+   if (ins.second)
+      m_names.push_back(in_name);
+   return ins.first->second;
+}
+
+
+// Return the id of a name
+//
+// @param in_name          the object name
+// @param out_id           the returned name id
+//
+// @return                 false if the name was never interned, so no node can be associated with it
+//
+bool CNodeMap::GetNameId(const CString &in_name, unsigned int &out_id)
+{
+   unordered_map<wstring, unsigned int>::iterator it = m_nameIds.find(in_name.GetWideString());
+   if (it == m_nameIds.end())
+      return false;
+   out_id = it->second;
+   return true;
+}
+
+
+// Erase the reverse index entry for a given key and node
+//
+// @param in_node          the node
+// @param in_key           the key the node was pushed with
+//
+void CNodeMap::EraseReverseEntry(AtNode *in_node, const AtNodeIdKey &in_key)
+{
+   pair<AtNodeReverseIt, AtNodeReverseIt> range = m_nodes.equal_range(in_node);
+   for (AtNodeReverseIt it = range.first; it != range.second; it++)
+   {
+      if (it->second == in_key)
+      {
+         m_nodes.erase(it);
+         break;
+      }
+   }
 }
 
 
@@ -51,7 +109,12 @@ void CNodeMap::Clear()
 void CNodeMap::PushExportedNode(ProjectItem in_item, double in_frame, AtNode *in_node)
 {
    CString name = in_item.GetFullName();
-   m_map.insert(AtNodeLookupPair(AtNodeLookupKey(name, in_frame), in_node));
+   AiCritSecEnter(&m_cs);
+   AtNodeIdKey key(InternName(name), in_frame);
+   // as for the former std::map, an existing entry is not overwritten
+   if (m_map.insert(pair<AtNodeIdKey, AtNode*>(key, in_node)).second)
+      m_nodes.insert(pair<AtNode*, AtNodeIdKey>(in_node, key));
+   AiCritSecLeave(&m_cs);
 }
 
 
@@ -64,10 +127,17 @@ void CNodeMap::PushExportedNode(ProjectItem in_item, double in_frame, AtNode *in
 //
 AtNode* CNodeMap::GetExportedNode(CString &in_objectName, double in_frame)
 {
-   AtNodeLookupIt it = m_map.find(AtNodeLookupKey(in_objectName, in_frame));
-   if (it != m_map.end())
-      return it->second;
-   return NULL;
+   AtNode *node(NULL);
+   unsigned int nameId;
+   AiCritSecEnter(&m_cs);
+   if (GetNameId(in_objectName, nameId))
+   {
+      AtNodeIdIt it = m_map.find(AtNodeIdKey(nameId, in_frame));
+      if (it != m_map.end())
+         node = it->second;
+   }
+   AiCritSecLeave(&m_cs);
+   return node;
 }
 
 
@@ -92,9 +162,18 @@ AtNode* CNodeMap::GetExportedNode(ProjectItem in_item, double in_frame)
 //
 void CNodeMap::EraseExportedNode(CString &in_objectName, double in_frame)
 {
-   AtNodeLookupIt it = m_map.find(AtNodeLookupKey(in_objectName, in_frame));
-   if (it != m_map.end())
-      m_map.erase(it);
+   unsigned int nameId;
+   AiCritSecEnter(&m_cs);
+   if (GetNameId(in_objectName, nameId))
+   {
+      AtNodeIdIt it = m_map.find(AtNodeIdKey(nameId, in_frame));
+      if (it != m_map.end())
+      {
+         EraseReverseEntry(it->second, it->first);
+         m_map.erase(it);
+      }
+   }
+   AiCritSecLeave(&m_cs);
 }
 
 
@@ -104,14 +183,14 @@ void CNodeMap::EraseExportedNode(CString &in_objectName, double in_frame)
 //
 void CNodeMap::EraseExportedNode(AtNode *in_node)
 {
-   for (AtNodeLookupIt it=m_map.begin(); it!=m_map.end(); it++)
+   AiCritSecEnter(&m_cs);
+   AtNodeReverseIt it = m_nodes.find(in_node);
+   if (it != m_nodes.end())
    {
-      if (it->second == in_node)
-      {
-         m_map.erase(it);
-         return;
-      }
+      m_map.erase(it->second);
+      m_nodes.erase(it);
    }
+   AiCritSecLeave(&m_cs);
 }
 
 
@@ -119,10 +198,11 @@ void CNodeMap::EraseExportedNode(AtNode *in_node)
 //
 void CNodeMap::FlythroughUpdate()
 {
+   AiCritSecEnter(&m_cs);
    // loop the whole map and update the kine
-   for (AtNodeLookupIt it=m_map.begin(); it!=m_map.end(); it++)
+   for (AtNodeIdIt it=m_map.begin(); it!=m_map.end(); it++)
    {
-      CString softObjectName = it->first.m_objectName;
+      CString softObjectName = m_names[it->first.m_nameId];
       CRef ref;
       ref.Set(softObjectName);
       if (!ref.IsValid())
@@ -134,6 +214,7 @@ void CNodeMap::FlythroughUpdate()
 
       UpdateShapeMatrix(object, GetRenderInstance()->GetFrame());
    }
+   AiCritSecLeave(&m_cs);
 }
 
 
@@ -141,15 +222,54 @@ void CNodeMap::FlythroughUpdate()
 void CNodeMap::LogExportedNodes()
 {
    GetMessageQueue()->LogMsg(L"----- CNodeMap::LogExportedNodes -----");
-   for (AtNodeLookupIt it=m_map.begin(); it!=m_map.end(); it++)
+   AiCritSecEnter(&m_cs);
+   for (AtNodeIdIt it=m_map.begin(); it!=m_map.end(); it++)
    {
       CString nodeName = CNodeUtilities().GetName(it->second);
-      GetMessageQueue()->LogMsg(it->first.m_objectName + L" " + nodeName);
+      GetMessageQueue()->LogMsg(m_names[it->first.m_nameId] + L" " + nodeName);
    }
+   AiCritSecLeave(&m_cs);
    GetMessageQueue()->LogMsg(L"---------------");
 }
 
 
+// Get the global transformation of an object at a given time, evaluating it only the first time
+//
+// @param in_xsiObj        the object
+// @param in_time          the key time
+//
+// @return                 the transformation
+//
+const CTransformation& CTransformCache::GetGlobalTransform(const X3DObject &in_xsiObj, double in_time)
+{
+   pair <ULONG, double> key(CObjectUtilities().GetId(in_xsiObj), in_time);
+   map <pair <ULONG, double>, CTransformation>::iterator it = m_map.find(key);
+   if (it != m_map.end())
+      return it->second;
+
+   it = m_map.insert(pair <pair <ULONG, double>, CTransformation>(key, in_xsiObj.GetKinematics().GetGlobal().GetTransform(in_time))).first;
+   return it->second;
+}
+
+
+// Get the global matrix of an object at a given time
+//
+// @param in_xsiObj        the object
+// @param in_time          the key time
+// @param out_matrix       the returned matrix
+//
+void CTransformCache::GetGlobalMatrix(const X3DObject &in_xsiObj, double in_time, AtMatrix &out_matrix)
+{
+   CUtilities().S2A(GetGlobalTransform(in_xsiObj, in_time), out_matrix);
+}
+
+
+void CTransformCache::Clear()
+{
+   m_map.clear();
+}
+
+
 CRenderInstance::CRenderInstance()
 : m_interruptRender(false), 
   m_flythrough_frame(FRAME_NOT_INITIALIZED_VALUE),
@@ -551,16 +671,33 @@ CRef CRenderInstance::GetUpdateType(const CRef &in_ref, eUpdateType &out_updateT
       {
          // More incompatible cases with IPR
          // If we have detected a primitive change of a polymesh is because
-         // we have deformated it (moving its points)
+         // we have deformated it (moving its points).
+         // Only the primitive events can go the geometry update. The cluster and cluster property ones 
+         // (for instance a material or polygon cluster membership change) rebuild the scene
+         bool isPrimitiveEvent = in_ref.GetClassID() == siPrimitiveID;
          if (xsiObj.GetType() == siPolyMeshType) 
          {
-            // we have modified a polymesh primitive (for example, the length of a grid)
-            out_updateType = eUpdateType_IncompatibleIPR;
+            // we have modified a polymesh primitive (for example, the length of a grid).
+            // Try updating the mesh geometry, UpdateScene rebuilds the scene if the topology changed
+            if (isPrimitiveEvent)
+            {
+               xsiObj = SIObject(xsiObj.GetParent());
+               out_updateType = eUpdateType_ShapeGeometry;
+            }
+            else
+               out_updateType = eUpdateType_IncompatibleIPR;
          }
          else if (xsiObj.GetParent().GetClassID() == siPrimitiveID)
          {
             // this happens when moving a point or edge or polygon
-            out_updateType = eUpdateType_IncompatibleIPR;
+            X3DObject owner(SIObject(xsiObj.GetParent()).GetParent());
+            if (isPrimitiveEvent && owner.IsValid() && owner.GetType() == siPolyMeshType)
+            {
+               xsiObj = owner;
+               out_updateType = eUpdateType_ShapeGeometry;
+            }
+            else
+               out_updateType = eUpdateType_IncompatibleIPR;
          }
          else if (xsiObj.GetParent().GetClassID() == siHairPrimitiveID)
          {
@@ -617,17 +754,37 @@ CRef CRenderInstance::GetUpdateType(const CRef &in_ref, eUpdateType &out_updateT
 }
 
 
-CStatus CRenderInstance::UpdateScene(const CRef &in_ref, eUpdateType in_updateType)
+// Update the Arnold scene with the data of the object, or rebuild the scene if the update type is not compatible with IPR
+//
+// @param in_ref              The object to update
+// @param in_updateType       The update type
+// @param out_sceneRebuilt    Returns true if the scene was destroyed and loaded again
+//
+// @return the status of the update, or of LoadScene if the scene was rebuilt
+//
+CStatus CRenderInstance::UpdateScene(const CRef &in_ref, eUpdateType in_updateType, bool &out_sceneRebuilt)
 {
    CStatus status;
+   out_sceneRebuilt = false;
 
-   if (GetRenderOptions()->m_ipr_rebuild_mode == eIprRebuildMode_Manual)
-   if (in_updateType == eUpdateType_IncompatibleIPR)
+   bool manualRebuild = GetRenderOptions()->m_ipr_rebuild_mode == eIprRebuildMode_Manual;
+   if (manualRebuild && in_updateType == eUpdateType_IncompatibleIPR)
    {
       GetMessageQueue()->LogMsg(L"[sitoa] Incompatible IPR event detected (by " + in_ref.GetAsText() + L"). Not destroying the scene because in manual rebuild mode");
       return CStatus::OK;
    }
 
+   // set by the update types that can't be applied in place
+   bool rebuild = in_updateType == eUpdateType_IncompatibleIPR;
+
+   // any change (not only of the kinematics, think for instance of constraints or expressions) can move
+   // the objects, so let's re-evaluate the transformations
+   m_transformCache.Clear();
+   // same for the parameters, that are then read only once during the update
+   GetParameterCache().Enable(true);
+   // and for the .tx files, that could have been (re)generated in the meantime
+   CPathTranslator::ClearFileExistenceCache();
+
    switch (in_updateType)
    {
       case eUpdateType_Light:               
@@ -648,9 +805,7 @@ CStatus CRenderInstance::UpdateScene(const CRef &in_ref, eUpdateType in_updateTy
          UpdateWrappingSettings(in_ref, m_frame);                      
          break;
       case eUpdateType_IncompatibleIPR:    
-         DestroyScene(false);
-         status = LoadScene(m_renderOptionsProperty, L"Region", m_frame, m_frame, 1, false, false, L"", false);                       
-         break;
+         break; // rebuilt below
       case eUpdateType_ArnoldVisibility:   
          UpdateVisibility(in_ref, m_frame);                      
          break;
@@ -692,6 +847,20 @@ CStatus CRenderInstance::UpdateScene(const CRef &in_ref, eUpdateType in_updateTy
          break;
       }
 
+      case eUpdateType_ShapeGeometry:
+      {
+         // re-export just the points, normals, clusters and uvs of the mesh. 
+         // If not possible (for instance the topology changed), fall back to the full scene rebuild
+         if (!UpdateShapeGeometry(X3DObject(in_ref), m_frame))
+         {
+            if (manualRebuild)
+               GetMessageQueue()->LogMsg(L"[sitoa] Could not update the geometry of " + in_ref.GetAsText() + L". Not destroying the scene because in manual rebuild mode");
+            else
+               rebuild = true;
+         }
+         break;
+      }
+
       case eUpdateType_ObjectUnhidden:
       {
          X3DObject xsiObj(in_ref);
@@ -713,6 +882,71 @@ CStatus CRenderInstance::UpdateScene(const CRef &in_ref, eUpdateType in_updateTy
          break;
    }
 
+   if (rebuild)
+   {
+      // discard the values cached by a failed update, if any
+      GetParameterCache().Enable(true);
+      DestroyScene(false);
+      status = LoadScene(m_renderOptionsProperty, L"Region", m_frame, m_frame, 1, false, false, L"", false);
+      out_sceneRebuilt = true;
+   }
+
+   GetParameterCache().Enable(false);
+   return status;
+}
+
+
+// Queue an update for the region render, or apply it right away for the other render types.
+// The queued updates are applied by the next ProcessRegion, all together.
+//
+// @param in_ref          The object to update
+// @param in_updateType   The update type
+//
+void CRenderInstance::PushIprUpdate(const CRef &in_ref, eUpdateType in_updateType)
+{
+   if (m_renderType == L"Region")
+      m_iprUpdateQueue.Push(in_ref, in_updateType);
+   else
+   {
+      bool sceneRebuilt;
+      UpdateScene(in_ref, in_updateType, sceneRebuilt);
+   }
+}
+
+
+// Apply the updates queued by OnValueChange.
+// Called by ProcessRegion, with the scene data locked.
+//
+// @param out_sceneDestroyed   Returns true if one of the updates rebuilt the scene
+//
+// @return the status of the last update
+//
+CStatus CRenderInstance::ApplyIprUpdates(bool &out_sceneDestroyed)
+{
+   CStatus status;
+   out_sceneDestroyed = false;
+
+   // in manual rebuild mode, UpdateScene skips the incompatible updates, so the other ones must be applied
+   bool rebuild = GetRenderOptions()->m_ipr_rebuild_mode != eIprRebuildMode_Manual;
+   vector <CIprUpdate> updates;
+   m_iprUpdateQueue.Pop(updates, rebuild);
+   if (updates.empty())
+      return status;
+
+   for (vector <CIprUpdate>::iterator it = updates.begin(); it != updates.end(); it++)
+   {
+      status = UpdateScene(it->m_ref, it->m_updateType, out_sceneDestroyed);
+      // a rebuild (also the fallback of a geometry update) exported the whole scene, so the other updates are not needed
+      if (status != CStatus::OK || out_sceneDestroyed)
+         break;
+   }
+
+   m_iprUpdateQueue.AddApplied((unsigned int)updates.size());
+
+   unsigned int nbEvents, nbApplied;
+   m_iprUpdateQueue.GetCounters(nbEvents, nbApplied);
+   AiMsgDebug("[sitoa] IPR updates: %u events received, %u updates applied", nbEvents, nbApplied);
+
    return status;
 }
 
@@ -739,6 +973,11 @@ void CRenderInstance::DestroyScene(bool in_flushTextures)
       if (in_flushTextures)
          FlushTextures();
 
+      // drop the jobs of an aborted export, their nodes are about to be destroyed
+      m_exportJobQueue.Clear();
+      // and the pending IPR updates, the next load reads the whole scene anyway
+      m_iprUpdateQueue.Clear();
+
       AiEnd();
 
       SetInterruptRenderSignal(false);
@@ -751,6 +990,8 @@ void CRenderInstance::DestroyScene(bool in_flushTextures)
    m_lightMap.Clear();
    m_shaderMap.Clear();
    m_missingShaderMap.Clear();
+   m_transformCache.Clear();
+   m_polymeshShareCache.Clear();
 
    // clear all the search paths
    GetTexturesSearchPath().Clear();
@@ -823,7 +1064,7 @@ CStatus CRenderInstance::OnValueChange(CRef& in_ctxt)
    }
 
    if (displacementChange)
-      UpdateScene(cRef, eUpdateType_IncompatibleIPR);
+      PushIprUpdate(cRef, eUpdateType_IncompatibleIPR);
    else
    {
       // SelectiveInclusive case: We receive this change with an event of light primitive. Light Shader changes also
@@ -847,7 +1088,7 @@ CStatus CRenderInstance::OnValueChange(CRef& in_ctxt)
          )
       {
          CRef objRef = GetUpdateType(cRef, updateType);      
-         UpdateScene(objRef, updateType);
+         PushIprUpdate(objRef, updateType);
       }
    }
 
@@ -1388,18 +1629,41 @@ CStatus CRenderInstance::ProcessRegion()
    }   
    else
    {
+      // Wait for the value change events to settle, so that all the ones fired by a slider drag
+      // get applied together. Don't wait for longer than 10 times the delay, to keep the region responsive
+      if (!m_iprUpdateQueue.IsEmpty())
+      {
+         int delayOption = GetRenderOptions()->m_ipr_update_delay;
+         unsigned int delay = delayOption > 0 ? (unsigned int)delayOption : 0;
+         for (unsigned int waited = 0; waited < 10 * delay; waited+= 10)
+         {
+            if (m_iprUpdateQueue.GetMillisecondsSinceLastEvent() >= delay)
+               break;
+            if (InterruptRenderSignal())
+               return CStatus::Abort;
+            CTimeUtilities().SleepMilliseconds(10);
+         }
+      }
+
       m_renderContext.ProgressUpdate(L"Updating Scene", L"Updating Scene", 0);
       LockSceneData lock;
       if (lock.m_status != CStatus::OK)
          return CStatus::Abort;
 
+      // Apply the updates queued by OnValueChange
+      bool sceneDestroyed = false;
+      status = ApplyIprUpdates(sceneDestroyed);
+      if (status != CStatus::OK)
+         return status;
+
       // If OnObjectAdded was triggered, we find the added refs in m_objectsAdded
       // If so, we'll just create the new objects, and skip the dirty list
       CRefArray objectsAdded = m_objectsAdded.Get();
       if (objectsAdded.GetCount() > 0)
       {
          CRefArray lightArray, meshArray, hairArray, instanceModelArray;
-         for (LONG i=0; i<objectsAdded.GetCount(); i++)
+         // if the queued updates rebuilt the scene, the new objects were exported already
+         for (LONG i=0; i<objectsAdded.GetCount() && !sceneDestroyed; i++)
          {
             if (objectsAdded[i].GetClassID() == siLightID)
                lightArray.Add(objectsAdded[i]);
@@ -1454,8 +1718,6 @@ CStatus CRenderInstance::ProcessRegion()
             if (InterruptRenderSignal())
                return CStatus::Abort;
 
-            bool sceneDestroyed = false;
-
             // First, let's push the dirty refs into a set, so to avoid duplication
             // For example, when creating a light during ipr, the light is passed twice into the dirty ref list (sigh!)
             set <CRef> refSet;
@@ -1475,9 +1737,7 @@ CStatus CRenderInstance::ProcessRegion()
                   if (status == CStatus::OK && !sceneDestroyed)
                   if (updateType != eUpdateType_Undefined)
                   {
-                     status = UpdateScene(ref, updateType);
-                     if (updateType == eUpdateType_IncompatibleIPR)
-                        sceneDestroyed = true;
+                     status = UpdateScene(ref, updateType, sceneDestroyed);
                      // don't break for sceneDestroy, as we need to SetObjectClean
                   }
 
@@ -1665,6 +1925,27 @@ CShaderDefSet& CRenderInstance::ShaderDefSet()
    return m_shaderDefSet;
 }
 
+
+// export jobs queue accessor
+CExportJobQueue& CRenderInstance::ExportJobQueue()
+{
+   return m_exportJobQueue;
+}
+
+
+// transformations cache accessor
+CTransformCache& CRenderInstance::TransformCache()
+{
+   return m_transformCache;
+}
+
+
+// polymeshes share cache accessor
+CPolymeshShareCache& CRenderInstance::PolymeshShareCache()
+{
+   return m_polymeshShareCache;
+}
+
 // access the textures search path
 CSearchPath& CRenderInstance::GetTexturesSearchPath()
 {
@@ -1732,5 +2013,126 @@ void CObjectsAdded::Clear()
 }
 
 
+///////////////////////////////////////////
+// CIprUpdateQueue
+///////////////////////////////////////////
+
+// Push an update, merging it with the pending update of the same object and type, if any
+//
+// @param in_ref          The object to update
+// @param in_updateType   The update type
+//
+void CIprUpdateQueue::Push(const CRef &in_ref, eUpdateType in_updateType)
+{
+   AiCritSecEnter(&m_cs);
+
+   m_nbEvents++;
+   m_lastEventTime = chrono::steady_clock::now();
+
+   if (in_updateType != eUpdateType_Undefined)
+   {
+      pair <wstring, int> key(in_ref.GetAsText().GetWideString(), (int)in_updateType);
+      map <pair <wstring, int>, size_t>::iterator it = m_index.find(key);
+      if (it != m_index.end()) // the update will read the latest values anyway
+         m_updates[it->second].m_ref = in_ref;
+      else
+      {
+         m_index[key] = m_updates.size();
+         m_updates.push_back(CIprUpdate(in_ref, in_updateType));
+      }
+   }
+
+   AiCritSecLeave(&m_cs);
+}
+
+
+// Move the pending updates into out_updates, in the order they were first pushed, and empty the queue.
+// If a scene rebuild is pending and allowed, only the rebuild is returned, since it will read all the other changes.
+//
+// @param out_updates   The returned updates
+// @param in_rebuild    False if the scene is not rebuilt by the incompatible updates (manual rebuild mode)
+//
+void CIprUpdateQueue::Pop(vector <CIprUpdate> &out_updates, bool in_rebuild)
+{
+   AiCritSecEnter(&m_cs);
+
+   out_updates.clear();
+   for (vector <CIprUpdate>::iterator it = m_updates.begin(); it != m_updates.end(); it++)
+   {
+      if (in_rebuild && it->m_updateType == eUpdateType_IncompatibleIPR)
+      {
+         out_updates.clear();
+         out_updates.push_back(*it);
+         break;
+      }
+      out_updates.push_back(*it);
+   }
+
+   m_updates.clear();
+   m_index.clear();
+
+   AiCritSecLeave(&m_cs);
+}
+
+
+// Return true if there are no pending updates
+//
+bool CIprUpdateQueue::IsEmpty()
+{
+   AiCritSecEnter(&m_cs);
+   bool result = m_updates.empty();
+   AiCritSecLeave(&m_cs);
+   return result;
+}
+
+
+// Return the milliseconds elapsed since the last pushed event
+//
+unsigned int CIprUpdateQueue::GetMillisecondsSinceLastEvent()
+{
+   AiCritSecEnter(&m_cs);
+   chrono::steady_clock::duration elapsed = chrono::steady_clock::now() - m_lastEventTime;
+   AiCritSecLeave(&m_cs);
+   return (unsigned int)chrono::duration_cast<chrono::milliseconds>(elapsed).count();
+}
+
+
+// Count the updates applied
+//
+// @param in_nbApplied   The number of updates just applied
+//
+void CIprUpdateQueue::AddApplied(unsigned int in_nbApplied)
+{
+   AiCritSecEnter(&m_cs);
+   m_nbApplied+= in_nbApplied;
+   AiCritSecLeave(&m_cs);
+}
+
+
+// Get the number of events received and of updates applied so far
+//
+// @param out_nbEvents    The number of events received
+// @param out_nbApplied   The number of updates applied
+//
+void CIprUpdateQueue::GetCounters(unsigned int &out_nbEvents, unsigned int &out_nbApplied)
+{
+   AiCritSecEnter(&m_cs);
+   out_nbEvents = m_nbEvents;
+   out_nbApplied = m_nbApplied;
+   AiCritSecLeave(&m_cs);
+}
+
+
+// Drop the pending updates. The counters are kept
+//
+void CIprUpdateQueue::Clear()
+{
+   AiCritSecEnter(&m_cs);
+   m_updates.clear();
+   m_index.clear();
+   AiCritSecLeave(&m_cs);
+}
+
+
 
 
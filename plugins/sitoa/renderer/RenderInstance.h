@@ -12,9 +12,11 @@ See the License for the specific language governing permissions and limitations
 #pragma once
 
 #include "common/Group.h"
+#include "common/WorkerPool.h"
 #include "loader/ICE.h"
 #include "loader/Lights.h"
 #include "loader/PathTranslator.h"
+#include "loader/Polymeshes.h"
 #include "loader/ShaderDef.h"
 #include "renderer/AtNodeLookup.h"
 #include "renderer/DisplayDriver.h"
@@ -22,6 +24,10 @@ See the License for the specific language governing permissions and limitations
 
 #include <xsi_renderer.h>
 #include <xsi_renderercontext.h>
+#include <xsi_transformation.h>
+#include <xsi_x3dobject.h>
+
+#include <chrono>
 
 #define FRAME_NOT_INITIALIZED_VALUE -1234567.89
 
@@ -30,23 +36,37 @@ See the License for the specific language governing permissions and limitations
 // to name the corresponding Arnold node, because there can be more than one Arnold node
 // generated by the same xsi shader at a given frame time. So, we add the unique int
 // at the end of the shaders' name
+// The ids can be requested by the export workers, so access is serialized
 //
 class CUniqueIdGenerator
 {
 private:
    unsigned int m_id;
+   AtCritSec    m_cs;
 public:
    CUniqueIdGenerator() : m_id(0)
-   {}
+   {
+      AiCritSecInit(&m_cs);
+   }
+
+   ~CUniqueIdGenerator()
+   {
+      AiCritSecClose(&m_cs);
+   }
 
    void Reset()
    {
+      AiCritSecEnter(&m_cs);
       m_id = 0;
+      AiCritSecLeave(&m_cs);
    }
 
    unsigned int Get()
    {
-      return ++m_id;
+      AiCritSecEnter(&m_cs);
+      unsigned int id = ++m_id;
+      AiCritSecLeave(&m_cs);
+      return id;
    }
 };
 
@@ -69,19 +89,36 @@ public:
 
 
 // This class to cache all the exported nodes
+// The map can be accessed by the export workers, so all the methods are serialized.
+// The lock is recursive, because FlythroughUpdate ends up querying the map again
 //
 class CNodeMap
 {
 private:
-   AtNodeLookupMap  m_map;
+   // the interned object names. The id of a name is its index in m_names
+   unordered_map<wstring, unsigned int> m_nameIds;
+   vector <CString> m_names;
+   AtNodeIdMap      m_map;
+   AtNodeReverseMap m_nodes; // reverse index, for erasing by node
+   AtCritSec        m_cs;
+
+   // Return the id of a name, interning it if required
+   unsigned int InternName(const CString &in_name);
+   // Return the id of a name, or false if the name was never interned
+   bool GetNameId(const CString &in_name, unsigned int &out_id);
+   // Erase the reverse index entry for a given key and node
+   void EraseReverseEntry(AtNode *in_node, const AtNodeIdKey &in_key);
 
 public:
    CNodeMap()
-   {}
+   {
+      AiCritSecInitRecursive(&m_cs);
+   }
 
    ~CNodeMap()
    {
-      m_map.clear();
+      Clear();
+      AiCritSecClose(&m_cs);
    }
 
    // Push a node into the exported objects map
@@ -103,6 +140,117 @@ public:
 };
 
 
+// Cache of the global transformations of the objects, keyed by object id and key time.
+// The same transformations are asked by several loaders (for instance the instances ask for the
+// master and instance models for each master node), and evaluating them through the SDK is costly.
+// Since the SDK is called on a cache miss, the cache must only be used by the main thread.
+// It is cleared at each frame and by the IPR updates.
+//
+class CTransformCache
+{
+private:
+   map <pair <ULONG, double>, CTransformation> m_map;
+
+public:
+   CTransformCache()
+   {}
+
+   ~CTransformCache()
+   {
+      Clear();
+   }
+
+   // Get the global transformation of an object at a given time
+   const CTransformation& GetGlobalTransform(const X3DObject &in_xsiObj, double in_time);
+   // Get the global matrix of an object at a given time
+   void GetGlobalMatrix(const X3DObject &in_xsiObj, double in_time, AtMatrix &out_matrix);
+   // Clear the cache
+   void Clear();
+};
+
+
+// The types of the IPR updates
+enum eUpdateType
+{
+   eUpdateType_Undefined,
+   eUpdateType_Camera,
+   eUpdateType_Light,
+   eUpdateType_LightKinematics,
+   eUpdateType_Shader,
+   eUpdateType_ImageClip,
+   eUpdateType_RenderOptions,
+   eUpdateType_RenderOptionsTexture,
+   eUpdateType_IncompatibleIPR,
+   eUpdateType_ArnoldParameters,
+   eUpdateType_PassShaderStack,
+   eUpdateType_ArnoldVisibility,
+   eUpdateType_ArnoldSidedness,
+   eUpdateType_ArnoldMatte,
+   eUpdateType_Material,
+   eUpdateType_Group,
+   eUpdateType_ShapeKinematics,
+   eUpdateType_WrappingSettings,
+   eUpdateType_ObjectUnhidden,
+   eUpdateType_ShapeGeometry
+};
+
+
+// An IPR update: the object to update, and how
+class CIprUpdate
+{
+public:
+   CRef        m_ref;
+   eUpdateType m_updateType;
+
+   CIprUpdate(const CRef &in_ref, eUpdateType in_updateType) : m_ref(in_ref), m_updateType(in_updateType)
+   {}
+};
+
+
+// The queue of the updates requested by OnValueChange during the IPR.
+// Dragging a slider fires dozens of events per second, so the events don't update the scene, but push
+// their update here. The updates of the same object with the same type are merged, and the whole queue
+// is applied by the next region Process, so with a single interrupt and restart of the render.
+// The events are pushed by the main thread, and the queue is applied by the render thread.
+//
+class CIprUpdateQueue
+{
+private:
+   vector <CIprUpdate>               m_updates;
+   map <pair <wstring, int>, size_t> m_index;     // object name and update type -> index in m_updates
+   chrono::steady_clock::time_point  m_lastEventTime;
+   unsigned int                      m_nbEvents;  // the number of events received
+   unsigned int                      m_nbApplied; // the number of updates applied
+   AtCritSec                         m_cs;
+
+public:
+   CIprUpdateQueue() : m_nbEvents(0), m_nbApplied(0)
+   {
+      AiCritSecInit(&m_cs);
+   }
+
+   ~CIprUpdateQueue()
+   {
+      Clear();
+      AiCritSecClose(&m_cs);
+   }
+
+   // Push an update, merging it with the pending update of the same object and type, if any
+   void Push(const CRef &in_ref, eUpdateType in_updateType);
+   // Move the pending updates into out_updates, and empty the queue
+   void Pop(vector <CIprUpdate> &out_updates, bool in_rebuild);
+   // Return true if there are no pending updates
+   bool IsEmpty();
+   // Return the milliseconds elapsed since the last pushed event
+   unsigned int GetMillisecondsSinceLastEvent();
+   // Count the updates applied
+   void AddApplied(unsigned int in_nbApplied);
+   // Get the number of events received and of updates applied
+   void GetCounters(unsigned int &out_nbEvents, unsigned int &out_nbApplied);
+   // Drop the pending updates, for instance when the scene is destroyed
+   void Clear();
+};
+
 enum eRenderStatus
 {
     eRenderStatus_Uninitialized,
@@ -167,6 +315,12 @@ public:
    CShaderMap&        ShaderMap();
    CMissingShaderMap& MissingShaderMap();
    CShaderDefSet&     ShaderDefSet();
+   // handle to the queue of the export jobs
+   CExportJobQueue&   ExportJobQueue();
+   // handle to the cache of the objects' transformations
+   CTransformCache&   TransformCache();
+   // handle to the polymeshes that could share their geometry
+   CPolymeshShareCache& PolymeshShareCache();
 
    CSearchPath& GetTexturesSearchPath();
    CSearchPath& GetProceduralsSearchPath();
@@ -186,29 +340,6 @@ public:
 
 private:
 
-   enum eUpdateType
-   {
-      eUpdateType_Undefined,
-      eUpdateType_Camera,
-      eUpdateType_Light,
-      eUpdateType_LightKinematics,
-      eUpdateType_Shader,
-      eUpdateType_ImageClip,
-      eUpdateType_RenderOptions,
-      eUpdateType_RenderOptionsTexture,
-      eUpdateType_IncompatibleIPR,
-      eUpdateType_ArnoldParameters,
-      eUpdateType_PassShaderStack,
-      eUpdateType_ArnoldVisibility,
-      eUpdateType_ArnoldSidedness,
-      eUpdateType_ArnoldMatte,
-      eUpdateType_Material,
-      eUpdateType_Group,
-      eUpdateType_ShapeKinematics,
-      eUpdateType_WrappingSettings,
-      eUpdateType_ObjectUnhidden
-   };
-
    // Create the directories for all the output filenames of all the buffers
    bool OutputDirectoryExists();
 
@@ -217,7 +348,11 @@ private:
    // Detect what type of Update we have to do for the given Reference
    CRef GetUpdateType(const CRef &in_ref, eUpdateType &out_updateType);
    // Update Arnold Scene with the data of the object 
-   CStatus UpdateScene(const CRef &in_ref, eUpdateType in_updateType);
+   CStatus UpdateScene(const CRef &in_ref, eUpdateType in_updateType, bool &out_sceneRebuilt);
+   // Queue an update for the region render, or apply it right away for the other render types
+   void PushIprUpdate(const CRef &in_ref, eUpdateType in_updateType);
+   // Apply the updates queued by OnValueChange
+   CStatus ApplyIprUpdates(bool &out_sceneDestroyed);
    // Calculates the region we have to Render & updates them into Arnold parameters
    unsigned int UpdateRenderRegion(unsigned int in_width, unsigned int in_height);
 
@@ -265,6 +400,14 @@ private:
    CUniqueIdGenerator m_uniqueIdGenerator;
    // class for the auto shader definition
    CShaderDefSet      m_shaderDefSet;
+   // the jobs deferred by the loaders when the parallel export is enabled
+   CExportJobQueue    m_exportJobQueue;
+   // the updates queued by OnValueChange during the IPR
+   CIprUpdateQueue    m_iprUpdateQueue;
+   // the objects' transformations evaluated so far for the current frame
+   CTransformCache    m_transformCache;
+   // the polymeshes exported for the current frame, that could share their geometry
+   CPolymeshShareCache m_polymeshShareCache;
 
    int DoRender(const AtRenderMode in_mode = AI_RENDER_MODE_CAMERA);
 };
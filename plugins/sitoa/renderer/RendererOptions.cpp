@@ -52,6 +52,12 @@ void CRenderOptions::Read(const Property &in_cp)
    m_progressive_plus1     = (bool)ParAcc_GetValue(in_cp, L"progressive_plus1",     DBL_MAX);
    
    m_ipr_rebuild_mode   = (int)ParAcc_GetValue(in_cp,  L"ipr_rebuild_mode",      DBL_MAX);
+   m_ipr_update_delay   = (int)ParAcc_GetValue(in_cp,  L"ipr_update_delay",      DBL_MAX);
+
+   m_parallel_export    = (bool)ParAcc_GetValue(in_cp, L"parallel_export",       DBL_MAX);
+   m_share_instance_user_data = (bool)ParAcc_GetValue(in_cp, L"share_instance_user_data", DBL_MAX);
+   m_share_identical_polymeshes = (bool)ParAcc_GetValue(in_cp, L"share_identical_polymeshes", DBL_MAX);
+   m_ice_instancer      = (bool)ParAcc_GetValue(in_cp, L"ice_instancer",         DBL_MAX);
 
    m_skip_license_check    = (bool)ParAcc_GetValue(in_cp, L"skip_license_check",    DBL_MAX);
    m_abort_on_license_fail = (bool)ParAcc_GetValue(in_cp, L"abort_on_license_fail", DBL_MAX);
@@ -234,6 +240,7 @@ void CRenderOptions::Read(const Property &in_cp)
    m_save_procedural_paths = (bool)ParAcc_GetValue(in_cp, L"save_procedural_paths", DBL_MAX);
    m_use_path_translations = (bool)ParAcc_GetValue(in_cp, L"use_path_translations", DBL_MAX);
    m_open_procs = (bool)ParAcc_GetValue(in_cp, L"open_procs", DBL_MAX);
+   m_static_geometry_include = (bool)ParAcc_GetValue(in_cp, L"static_geometry_include", DBL_MAX);
    m_output_options = (bool)ParAcc_GetValue(in_cp, L"output_options", DBL_MAX);
    m_output_drivers_filters = (bool)ParAcc_GetValue(in_cp, L"output_drivers_filters", DBL_MAX);
    m_output_geometry = (bool)ParAcc_GetValue(in_cp, L"output_geometry", DBL_MAX);
@@ -339,6 +346,12 @@ SITOA_CALLBACK CommonRenderOptions_Define(CRef& in_ctxt)
    cpset.AddParameter(L"progressive_plus1",      CValue::siBool,   siPersistable, L"", L"",  true, CValue(), CValue(), CValue(), CValue(), p);
    
    cpset.AddParameter(L"ipr_rebuild_mode",       CValue::siInt4,   siPersistable, L"", L"",  eIprRebuildMode_Auto, eIprRebuildMode_Auto, eIprRebuildMode_Flythrough, eIprRebuildMode_Auto, eIprRebuildMode_Flythrough, p);
+   cpset.AddParameter(L"ipr_update_delay",       CValue::siInt4,   siPersistable, L"", L"",  50, 0, 1000, 0, 250, p);
+
+   cpset.AddParameter(L"parallel_export",        CValue::siBool,   siPersistable, L"", L"",  false, CValue(), CValue(), CValue(), CValue(), p);
+   cpset.AddParameter(L"share_instance_user_data", CValue::siBool, siPersistable, L"", L"",  false, CValue(), CValue(), CValue(), CValue(), p);
+   cpset.AddParameter(L"share_identical_polymeshes", CValue::siBool, siPersistable, L"", L"", false, CValue(), CValue(), CValue(), CValue(), p);
+   cpset.AddParameter(L"ice_instancer",          CValue::siBool,   siPersistable, L"", L"",  false, CValue(), CValue(), CValue(), CValue(), p);
    
    cpset.AddParameter(L"skip_license_check",     CValue::siBool,   siPersistable, L"", L"",  false, CValue(), CValue(), CValue(), CValue(), p);
    cpset.AddParameter(L"abort_on_license_fail",  CValue::siBool,   siPersistable, L"", L"",  false, CValue(), CValue(), CValue(), CValue(), p);    
@@ -532,6 +545,7 @@ SITOA_CALLBACK CommonRenderOptions_Define(CRef& in_ctxt)
    cpset.AddParameter(L"save_procedural_paths",  CValue::siBool,   siPersistable, L"", L"", true,           CValue(), CValue(), CValue(), CValue(), p);
    cpset.AddParameter(L"use_path_translations",  CValue::siBool,   siPersistable, L"", L"", false,          CValue(), CValue(), CValue(), CValue(), p);
    cpset.AddParameter(L"open_procs",             CValue::siBool,   siPersistable, L"", L"", false,          CValue(), CValue(), CValue(), CValue(), p);
+   cpset.AddParameter(L"static_geometry_include", CValue::siBool,  siPersistable, L"", L"", false,          CValue(), CValue(), CValue(), CValue(), p);
    cpset.AddParameter(L"output_options",         CValue::siBool,   siPersistable, L"", L"", true,           CValue(), CValue(), CValue(), CValue(), p);
    cpset.AddParameter(L"output_drivers_filters", CValue::siBool,   siPersistable, L"", L"", true,           CValue(), CValue(), CValue(), CValue(), p);
    cpset.AddParameter(L"output_geometry",        CValue::siBool,   siPersistable, L"", L"", true,           CValue(), CValue(), CValue(), CValue(), p);
@@ -695,6 +709,14 @@ SITOA_CALLBACK CommonRenderOptions_DefineLayout(CRef& in_ctxt)
       iprMode.Add(L"Fly-through"); iprMode.Add(eIprRebuildMode_Flythrough);
       item = layout.AddEnumControl(L"ipr_rebuild_mode", iprMode, L"Scene Rebuild Mode", siControlCombo);
       item.PutAttribute(siUINoLabel, true);
+      layout.AddItem(L"ipr_update_delay", L"Update Delay (ms)");
+   layout.EndGroup();
+
+   layout.AddGroup(L"Scene Export", true, 0);
+      layout.AddItem(L"parallel_export", L"Parallel Export");
+      layout.AddItem(L"share_instance_user_data", L"Share Instance User Data");
+      layout.AddItem(L"share_identical_polymeshes", L"Share Identical Polymeshes");
+      layout.AddItem(L"ice_instancer", L"ICE Shapes as Instancer");
    layout.EndGroup();
    
    layout.AddGroup(L"Licensing", true, 0);
@@ -1138,6 +1160,7 @@ SITOA_CALLBACK CommonRenderOptions_DefineLayout(CRef& in_ctxt)
          layout.AddItem(L"save_procedural_paths",   L"Absolute Procedural Paths");
          layout.AddItem(L"use_path_translations",   L"Translate Paths");
          layout.AddItem(L"open_procs", L"Expand Procedurals");
+         layout.AddItem(L"static_geometry_include", L"Static Geometry Include");
       layout.EndGroup();
       layout.AddGroup(L"Node Types");
          layout.AddItem(L"output_options", L"Options");
@@ -62,6 +62,12 @@ public:
    bool     m_progressive_plus1;
 
    int      m_ipr_rebuild_mode;
+   int      m_ipr_update_delay;
+
+   bool     m_parallel_export;
+   bool     m_share_instance_user_data;
+   bool     m_share_identical_polymeshes;
+   bool     m_ice_instancer;
 
    bool     m_skip_license_check;
    bool     m_abort_on_license_fail;
@@ -220,6 +226,7 @@ public:
    bool m_save_procedural_paths;
    bool m_use_path_translations;
    bool m_open_procs;
+   bool m_static_geometry_include;
    bool m_output_options;
    bool m_output_drivers_filters;
    bool m_output_geometry;
@@ -259,6 +266,12 @@ public:
       m_progressive_plus1(true),
       
       m_ipr_rebuild_mode(eIprRebuildMode_Auto),
+      m_ipr_update_delay(50),
+
+      m_parallel_export(false),
+      m_share_instance_user_data(false),
+      m_share_identical_polymeshes(false),
+      m_ice_instancer(false),
 
       m_skip_license_check(false),
       m_abort_on_license_fail(false),
@@ -412,6 +425,7 @@ public:
       m_save_procedural_paths(true),
       m_use_path_translations(false),
       m_open_procs(false),
+      m_static_geometry_include(false),
       // for the 6 following, default is true, but initialized to false for very old scenes
       m_output_options(false), 
       m_output_drivers_filters(false),
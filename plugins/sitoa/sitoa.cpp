@@ -162,6 +162,9 @@ SITOA_CALLBACK XSIUnloadPlugin(PluginRegistrar& in_reg)
       }
    #endif
 
+   // stop the export threads
+   CWorkerPool::Shutdown();
+
    Application().LogMessage(L"[sitoa] SItoA " + GetSItoAVersion() + L" has been unloaded.");
    return CStatus::OK;
 }
@@ -162,24 +162,219 @@ const char* ResolveSequenceAtFrame(const AtShaderGlobals *in_sg, const char *in_
 }
 
 
+// Lookup a picture sequence at a given frame, by the frame texture handle if available, else by the resolved filename
+//
+// @param sg               The shader globals
+// @param in_s             The input sequence
+// @param in_frame         The frame to resolve the sequence at
+// @param in_sequence      The sequence data
+// @param in_handles       The sequence frames texture handles
+// @param in_colorSpace    The texture color space
+// @param in_params        The texture lookup parameters
+//
+// @return the looked up color
+//
+AtRGBA LookupSequenceAtFrame(AtShaderGlobals *sg, const char *in_s, const int in_frame, const ImageSequence &in_sequence, 
+                             const CSequenceHandles &in_handles, const AtString &in_colorSpace, const AtTextureParams &in_params)
+{
+   AtTextureHandle* handle = in_handles.Get(sg, in_frame);
+   if (handle)
+      return AiTextureHandleAccess(sg, handle, in_params);
+
+   AtString filename(ResolveSequenceAtFrame(sg, in_s, in_frame, in_sequence));
+   if (filename.empty())
+      return AI_RGBA_ZERO;
+   return AiTextureAccess(sg, filename, in_colorSpace, in_params);
+}
+
+
+// Prepare the cache of the sequence handles. No handle is created here, since we don't know 
+// which frames will be looked up (the sequences can be thousands of frames long).
+//
+// @param in_filename      The sequence filename
+// @param in_sequence      The sequence data
+// @param in_colorSpace    The texture color space
+//
+void CSequenceHandles::Create(const char *in_filename, const ImageSequence &in_sequence, const AtString &in_colorSpace)
+{
+   Destroy();
+   if (!in_sequence.extension || in_sequence.end < in_sequence.start)
+      return;
+
+   m_cache = new CCache();
+   m_cache->m_filename = AtString(in_filename);
+   m_cache->m_sequence = in_sequence;
+   m_cache->m_colorSpace = in_colorSpace;
+   for (int i = 0; i < AI_MAX_THREADS; i++)
+   {
+      m_cache->m_windows[i].m_slots[0] = m_cache->m_windows[i].m_slots[1] = NULL;
+      m_cache->m_windows[i].m_next = 0;
+   }
+   AiCritSecInit(&m_cache->m_cs);
+}
+
+
+// Destroy the handles
+void CSequenceHandles::Destroy()
+{
+   if (!m_cache)
+      return;
+
+   // all the handles, in the LRU or just referenced by the thread windows
+   set <CFrameHandle*> frameHandles(m_cache->m_lru.begin(), m_cache->m_lru.end());
+   for (int i = 0; i < AI_MAX_THREADS; i++)
+   {
+      for (int j = 0; j < 2; j++)
+      {
+         if (m_cache->m_windows[i].m_slots[j])
+            frameHandles.insert(m_cache->m_windows[i].m_slots[j]);
+      }
+   }
+
+   for (set <CFrameHandle*>::iterator it = frameHandles.begin(); it != frameHandles.end(); it++)
+   {
+      AiTextureHandleDestroy((*it)->m_handle);
+      delete *it;
+   }
+
+   AiCritSecClose(&m_cache->m_cs);
+   delete m_cache;
+   m_cache = NULL;
+}
+
+
+// Return the handle of a frame, clamped to the sequence range as ResolveSequenceAtFrame does.
+// The handles referenced by the thread window are never destroyed, so they are returned without locking
+//
+// @param in_sg            The shader globals
+// @param in_frame         The frame
+//
+// @return the handle, or NULL if the cache was not created
+//
+AtTextureHandle* CSequenceHandles::Get(const AtShaderGlobals *in_sg, int in_frame) const
+{
+   if (!m_cache)
+      return NULL;
+
+   int frame = AiClamp(in_frame, m_cache->m_sequence.start, m_cache->m_sequence.end);
+   CThreadWindow &window = m_cache->m_windows[in_sg->tid];
+   for (int i = 0; i < 2; i++)
+   {
+      if (window.m_slots[i] && window.m_slots[i]->m_frame == frame)
+         return window.m_slots[i]->m_handle;
+   }
+
+   AiCritSecEnter(&m_cache->m_cs);
+   AtTextureHandle* handle = GetLocked(m_cache, window, frame);
+   AiCritSecLeave(&m_cache->m_cs);
+   return handle;
+}
+
+
+// Look up a frame in the LRU, or create its handle, and move it into the thread window, replacing
+// the oldest frame of the window. Called with the cache locked
+//
+// @param in_cache         The cache
+// @param io_window        The window of the calling thread
+// @param in_frame         The frame, already clamped to the sequence range
+//
+// @return the handle of the frame
+//
+AtTextureHandle* CSequenceHandles::GetLocked(CCache *in_cache, CThreadWindow &io_window, int in_frame)
+{
+   CFrameHandle* frameHandle;
+   unordered_map <int, list <CFrameHandle*>::iterator>::iterator it = in_cache->m_frames.find(in_frame);
+   if (it != in_cache->m_frames.end())
+   {
+      // move to the front of the LRU
+      frameHandle = *it->second;
+      in_cache->m_lru.splice(in_cache->m_lru.begin(), in_cache->m_lru, it->second);
+   }
+   else
+   {
+      const char* filename = ResolveSequenceAtFrame(NULL, in_cache->m_filename.c_str(), in_frame, in_cache->m_sequence);
+      frameHandle = new CFrameHandle();
+      frameHandle->m_frame = in_frame;
+      frameHandle->m_handle = AiTextureHandleCreate(filename, in_cache->m_colorSpace);
+      frameHandle->m_nbWindows = 0;
+      frameHandle->m_inLru = true;
+      AiFree((void*)filename);
+
+      in_cache->m_lru.push_front(frameHandle);
+      in_cache->m_frames[in_frame] = in_cache->m_lru.begin();
+
+      // evict the least recently used frames. The ones still in a thread window are destroyed by the window
+      while (in_cache->m_lru.size() > s_maxHandles)
+      {
+         CFrameHandle* evicted = in_cache->m_lru.back();
+         in_cache->m_lru.pop_back();
+         in_cache->m_frames.erase(evicted->m_frame);
+         evicted->m_inLru = false;
+         if (evicted->m_nbWindows == 0)
+         {
+            AiTextureHandleDestroy(evicted->m_handle);
+            delete evicted;
+         }
+      }
+   }
+
+   // replace the oldest frame of the window
+   CFrameHandle* &slot = io_window.m_slots[io_window.m_next];
+   if (slot)
+   {
+      slot->m_nbWindows--;
+      if (slot->m_nbWindows == 0 && !slot->m_inLru)
+      {
+         AiTextureHandleDestroy(slot->m_handle);
+         delete slot;
+      }
+   }
+   slot = frameHandle;
+   frameHandle->m_nbWindows++;
+   io_window.m_next = 1 - io_window.m_next;
+
+   return frameHandle->m_handle;
+}
+
+
 //////////////////////////////////////////////////
 // map_lookup* shaders
 //////////////////////////////////////////////////
 
+// Return the pointer to the user data associated with an object name
+//
+static MapLookupUserData *FindUserDataByOwnerName(const char *in_ownerName, MapLookupShaderData *in_data)
+{
+   if (!in_ownerName)
+      return NULL;
+
+   ObjectName_UserData_Map::iterator it = in_data->userData.find(string(in_ownerName));
+   return it != in_data->userData.end() ? &it->second : NULL;
+}
+
+
 // Return the pointer to the user data associated with the current rendering object (sg->Op)
+// The shapes named after the owners were resolved by SetUserData, so this is usually a pointer-keyed lookup only.
+// The other shapes (ginstances, or shapes created after the shader update, for instance by procedurals) 
+// are resolved by name the first time they are shaded by a thread, and then cached for that thread only,
+// so that no lock is needed.
 //
 MapLookupUserData *GetLookupUserData(const AtShaderGlobals *in_sg, MapLookupShaderData *in_data)
 {
-   MapLookupUserData* ud = NULL;
-   if (in_data->hasUserData)
-   {
-      // get the object name and find its user data store in the shader data map
-      string nodeName(GetShaderOwnerName(in_sg));
-      ObjectName_UserData_Map::iterator it = in_data->userData.find(nodeName);
-      if (it != in_data->userData.end())
-         ud = &it->second;
-   }
+   if (!in_data->hasUserData)
+      return NULL;
 
+   Owner_UserData_Map::const_iterator it = in_data->ownerUserData.find(in_sg->Op);
+   if (it != in_data->ownerUserData.end())
+      return it->second;
+
+   Owner_UserData_Map &lateOwnerUserData = in_data->lateOwnerUserData[in_sg->tid];
+   it = lateOwnerUserData.find(in_sg->Op);
+   if (it != lateOwnerUserData.end())
+      return it->second;
+
+   MapLookupUserData* ud = FindUserDataByOwnerName(GetShaderOwnerName(in_sg), in_data);
+   lateOwnerUserData.insert(pair<const AtNode*, MapLookupUserData*>(in_sg->Op, ud));
    return ud;
 }
 
@@ -215,6 +410,10 @@ void SetUserData(const AtNode *in_node, MapLookupShaderData *io_data, const char
    }
    AiUserParamIteratorDestroy(iter);
 
+   io_data->ownerUserData.clear();
+   for (int i = 0; i < AI_MAX_THREADS; i++)
+      io_data->lateOwnerUserData[i].clear();
+
    io_data->hasUserData = objNames.size() > 0;
    if (!io_data->hasUserData)
       return;
@@ -232,6 +431,15 @@ void SetUserData(const AtNode *in_node, MapLookupShaderData *io_data, const char
       // insert the user data in the map, using the object name as key
       io_data->userData.insert(ObjectName_UserData_Pair(*it, ud));
    }
+
+   // resolve the shapes named after the owners. The ginstances of the owners (whose name ends by 
+   // the owner name) and the shapes not existing yet are resolved by name when first shaded
+   for (ObjectName_UserData_Map::iterator it = io_data->userData.begin(); it != io_data->userData.end(); it++)
+   {
+      AtNode *shape = AiNodeLookUpByName(it->first.c_str());
+      if (shape && AiNodeEntryGetType(AiNodeGetNodeEntry(shape)) == AI_NODE_SHAPE && it->first == GetNodeOwnerName(shape))
+         io_data->ownerUserData.insert(pair<const AtNode*, MapLookupUserData*>(shape, &it->second));
+   }
 }
 
 // Destroy all the open texture handles stored in the shader data
@@ -304,10 +512,14 @@ void CClipData::GetData(const AtNode *in_node, const string &in_ownerName)
    {
       float dummyF = 0.5f;
       if (m_tokenFilename.IsValid())
+      {
+         m_tokenFilename.CreateTileHandles(m_colorSpace);
          filename = m_tokenFilename.Resolve(NULL, dummyF, dummyF);
+      }
       else
       {
          GetSequenceData(m_filename, m_imageSequence);
+         m_sequenceHandles.Create(m_filename, m_imageSequence, m_colorSpace);
          filename = ResolveSequenceAtFrame(NULL, m_filename, 0, m_imageSequence, true);
       }
    }
@@ -492,36 +704,22 @@ AtRGBA CClipData::LookupTextureMap(AtShaderGlobals *sg)
 
    if (m_needEvaluation) // Deprecated lookup, needed with variable texture name
    {
-      if (m_tokenFilename.IsValid())
-      {
-         // get the <udim>-ed filename, out of the current u,v
-         AtString filename(m_tokenFilename.Resolve(sg, sg->u, sg->v));
-         if (!filename.empty())
-            result = AiTextureAccess(sg, filename, m_colorSpace, tmap_params);
-      }
+      if (m_tokenFilename.IsValid()) // get the <udim>-ed texture, out of the current u,v
+         result = m_tokenFilename.Lookup(sg, m_colorSpace, tmap_params);
       else
       {
          int frame;
          float framef;
 
          if (AiUDataGetInt(m_timeSource, frame))
-         {
-            AtString filename(ResolveSequenceAtFrame(sg, m_filename, frame, m_imageSequence));
-            if (!filename.empty())
-               result = AiTextureAccess(sg, filename, m_colorSpace, tmap_params);
-         }
+            result = LookupSequenceAtFrame(sg, m_filename, frame, m_imageSequence, m_sequenceHandles, m_colorSpace, tmap_params);
          else if (AiUDataGetFlt(m_timeSource, framef))
          {
             frame = (int)floor(framef);
             framef-= floor(framef);
-            AtString filename0(ResolveSequenceAtFrame(sg, m_filename, frame, m_imageSequence));
-            AtString filename1(ResolveSequenceAtFrame(sg, m_filename, frame + 1, m_imageSequence));
-            if (!filename0.empty() && !filename1.empty())
-            {
-               AtRGBA c0 = AiTextureAccess(sg, filename0, m_colorSpace, tmap_params);
-               AtRGBA c1 = AiTextureAccess(sg, filename1, m_colorSpace, tmap_params);
-               result = AiLerp(framef, c0, c1);
-            }
+            AtRGBA c0 = LookupSequenceAtFrame(sg, m_filename, frame, m_imageSequence, m_sequenceHandles, m_colorSpace, tmap_params);
+            AtRGBA c1 = LookupSequenceAtFrame(sg, m_filename, frame + 1, m_imageSequence, m_sequenceHandles, m_colorSpace, tmap_params);
+            result = AiLerp(framef, c0, c1);
          }
       }
    }
@@ -552,5 +750,7 @@ void CClipData::DestroyTextureHandle()
 {
    if (m_textureHandle)
       AiTextureHandleDestroy(m_textureHandle);
+   m_sequenceHandles.Destroy();
+   m_tokenFilename.DestroyTileHandles();
 }
 
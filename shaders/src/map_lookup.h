@@ -14,7 +14,10 @@ See the License for the specific language governing permissions and limitations
 #include <ai.h>
 #include "color_utils.h"
 #include "shader_utils.h"
+#include <list>
 #include <map>
+#include <set>
+#include <unordered_map>
 #include <vector>
 
 using namespace std;
@@ -42,6 +45,61 @@ typedef struct
    size_t extensionLength;
 } ImageSequence;
 
+// The texture handles of an image sequence, created the first time each frame is looked up, 
+// so that the frames can be looked up without resolving their filename.
+// Only the last s_maxHandles frames looked up are kept (LRU), plus the 2 frames that each thread looked up last
+// (the ones blended by a float time source), that the thread finds without locking.
+// The cache is shared by the copies of the class, Destroy must be called explicitly
+class CSequenceHandles
+{
+private:
+   static const size_t s_maxHandles = 8;
+
+   // A frame handle. It's destroyed when out of the LRU and no thread window references it anymore
+   struct CFrameHandle
+   {
+      int              m_frame;
+      AtTextureHandle* m_handle;
+      int              m_nbWindows; // the number of thread windows referencing the handle
+      bool             m_inLru;
+   };
+
+   // The 2 frames last looked up by a thread
+   struct CThreadWindow
+   {
+      CFrameHandle* m_slots[2];
+      int           m_next; // the slot to be replaced
+   };
+
+   class CCache
+   {
+   public:
+      AtString                                     m_filename;
+      ImageSequence                                m_sequence;
+      AtString                                     m_colorSpace;
+      list <CFrameHandle*>                         m_lru; // most recently used first
+      unordered_map <int, list <CFrameHandle*>::iterator> m_frames;
+      CThreadWindow                                m_windows[AI_MAX_THREADS];
+      AtCritSec                                    m_cs;
+   };
+
+   CCache* m_cache;
+
+   // Look up a frame in the LRU, or create its handle, and move it into the thread window
+   static AtTextureHandle* GetLocked(CCache *in_cache, CThreadWindow &io_window, int in_frame);
+
+public:
+   CSequenceHandles() : m_cache(NULL)
+   {}
+
+   // Prepare the cache of the sequence handles
+   void Create(const char *in_filename, const ImageSequence &in_sequence, const AtString &in_colorSpace);
+   // Destroy the handles
+   void Destroy();
+   // Return the handle of a frame, clamped to the sequence range as ResolveSequenceAtFrame does, or NULL
+   AtTextureHandle* Get(const AtShaderGlobals *in_sg, int in_frame) const;
+};
+
 // This is taken from sib_image_clip, keeping just the necessary fields.
 class CClipData
 {
@@ -51,6 +109,7 @@ private:
    AtString          m_tspace_id;
    AtTextureHandle*  m_textureHandle;
    ImageSequence     m_imageSequence;
+   CSequenceHandles  m_sequenceHandles;
    CTokenFilename    m_tokenFilename;
    int               m_filter;
    float             m_gamma;
@@ -81,7 +140,8 @@ public:
 
    CClipData(const CClipData &in_arg) :
       m_filename(in_arg.m_filename), m_timeSource(in_arg.m_timeSource), m_tspace_id(in_arg.m_tspace_id),
-      m_textureHandle(in_arg.m_textureHandle), m_imageSequence(in_arg.m_imageSequence), m_tokenFilename(in_arg.m_tokenFilename),
+      m_textureHandle(in_arg.m_textureHandle), m_imageSequence(in_arg.m_imageSequence), m_sequenceHandles(in_arg.m_sequenceHandles), 
+      m_tokenFilename(in_arg.m_tokenFilename),
       m_filter(in_arg.m_filter), m_gamma(in_arg.m_gamma), 
       m_fstop(in_arg.m_fstop), m_hue(in_arg.m_hue), 
       m_saturation(in_arg.m_saturation), m_gain(in_arg.m_gain), m_brightness(in_arg.m_brightness),
@@ -112,13 +172,20 @@ typedef struct
 
 typedef pair<const string, MapLookupUserData> ObjectName_UserData_Pair;
 typedef map <const string, MapLookupUserData> ObjectName_UserData_Map;
+// the user data of each shape, resolved once, so that the evaluation doesn't look up the owner name
+typedef unordered_map <const AtNode*, MapLookupUserData*> Owner_UserData_Map;
 
-typedef struct 
+struct MapLookupShaderData
 {
    AtString                map;
    bool                    hasUserData;
    ObjectName_UserData_Map userData;
-} MapLookupShaderData;
+   Owner_UserData_Map      ownerUserData;                      // filled at update time, read only during the render
+   Owner_UserData_Map      lateOwnerUserData[AI_MAX_THREADS];  // per thread, filled on first touch, for the shapes not resolved at update time
+
+   MapLookupShaderData() : hasUserData(false)
+   {}
+};
 
 inline float fToLin(float in_value)
 {
@@ -132,9 +199,13 @@ AtRGBA TransformHSV(const AtRGBA &in_color, const float H, const float S, const
 bool GetSequenceData(const char *in_s, ImageSequence &out_sequence);
 // Resolve a picture sequence (for instance "seq.[1..10;3].png") at a given frame time.
 const char* ResolveSequenceAtFrame(const AtShaderGlobals *in_sg, const char *in_s, const int in_frame, const ImageSequence &in_sequence, bool in_atStartFrame=false);
+// Lookup a picture sequence at a given frame, by the frame texture handle if available, else by the resolved filename
+AtRGBA LookupSequenceAtFrame(AtShaderGlobals *sg, const char *in_s, const int in_frame, const ImageSequence &in_sequence, 
+                             const CSequenceHandles &in_handles, const AtString &in_colorSpace, const AtTextureParams &in_params);
 // Return the pointer to the user data associated with the current rendering object (sg->Op)
 MapLookupUserData *GetLookupUserData(const AtShaderGlobals *in_sg, MapLookupShaderData *in_data);
 // Get the user data associated with all the objects with instance values, and store them into map, keyed by the object's name.
+// Then resolve the user data of all the existing shapes
 void SetUserData(const AtNode *in_node, MapLookupShaderData *io_data, const char *in_mapSuffix);
 // Destroy all the open texture handles stored in the shader data
 void DestroyTextureHandles(MapLookupShaderData *in_data);
@@ -12,6 +12,14 @@ See the License for the specific language governing permissions and limitations
 #include <ai.h>
 #include "shader_utils.h"
 
+#include <algorithm>
+
+#ifdef _WINDOWS
+#include <io.h>
+#else
+#include <dirent.h>
+#endif
+
 
 void transform_1D( float &coord,
                    const float repeats,
@@ -272,28 +280,16 @@ static inline void AdjustTILELookup(const AtShaderGlobals *sg,
    }
 }
 
-// return the resolved <udim> or <tile> string depending on the input u,v, 
-// and the new u,v to be used to look up the resolved texture.
+// compute the tile row and column of the input u,v, and the new u,v to be used to look up the tile texture.
 //
 // @param in_sg         the shader globals, or NULL if called at update time
 // @param io_u          the input u coordinate
 // @param io_v          the input v coordinate
+// @param out_row       the returned tile row
+// @param out_col       the returned tile column
 //
-// @return the resolved filename (must be freed by the caller) else NULL
-//
-const char* CTokenFilename::Resolve(const AtShaderGlobals *in_sg, float &io_u, float &io_v)
+void CTokenFilename::GetTile(const AtShaderGlobals *in_sg, float &io_u, float &io_v, int &out_row, int &out_col) const
 {
-   if (!m_isValid)
-      return NULL;
-
-   uint32_t filenameLen = (uint32_t)strlen(m_filename);
-   // alloc the result strings, make it a little bigger than just the filename length
-   // For example a dummy<tile>.tx could expand to dummy_uXXXX_vYYYY.tx
-   // If during eval, allocate by AiShaderGlobalsQuickAlloc, and the caller must NOT free the returned buffer
-   char *out_name = in_sg ? (char*)AiShaderGlobalsQuickAlloc(in_sg, filenameLen + 10) : (char*)AiMalloc(filenameLen + 10);
-    // head: result == "dummy"
-   memcpy(out_name, m_filename, m_tagStart);
-
    int row, col;
    if (m_mode == UDIM)
    {
@@ -333,17 +329,6 @@ const char* CTokenFilename::Resolve(const AtShaderGlobals *in_sg, float &io_u, f
          float eps = m_dim / 65536.0f;
          AdjustUDIMLookup(in_sg, io_u, io_v, col, row, eps, m_dim);
       }
-
-      // tail: result = "dummy    .tx"
-      memcpy(out_name + m_tagStart + 4, m_filename + m_tagEnd, filenameLen + 1 - m_tagEnd);
-
-      unsigned int index = 1001 + col + (row * m_dim);
-      // these are the only chars that need to be overwritten.
-      // the head and tail of the resolved name is alread set at Init time
-      out_name[m_tagStart + 3] = '0' + index % 10; index /= 10;
-      out_name[m_tagStart + 2] = '0' + index % 10; index /= 10;
-      out_name[m_tagStart + 1] = '0' + index % 10; index /= 10;
-      out_name[m_tagStart + 0] = '0' + index % 10;
    }
    else // TILE
    {  
@@ -364,7 +349,48 @@ const char* CTokenFilename::Resolve(const AtShaderGlobals *in_sg, float &io_u, f
          float eps = 10.0f / 65536.0f;
          AdjustTILELookup(in_sg, io_u, io_v, col, row, eps);
       }
+   }
+
+   out_row = row;
+   out_col = col;
+}
+
+
+// return the filename of a given tile
+//
+// @param in_sg         the shader globals, or NULL if called at update time
+// @param in_row        the tile row
+// @param in_col        the tile column
+//
+// @return the resolved filename (must be freed by the caller if in_sg is NULL)
+//
+const char* CTokenFilename::GetTileName(const AtShaderGlobals *in_sg, int in_row, int in_col) const
+{
+   uint32_t filenameLen = (uint32_t)strlen(m_filename);
+   // alloc the result strings, make it a little bigger than just the filename length
+   // For example a dummy<tile>.tx could expand to dummy_uXXXX_vYYYY.tx
+   // If during eval, allocate by AiShaderGlobalsQuickAlloc, and the caller must NOT free the returned buffer
+   char *out_name = in_sg ? (char*)AiShaderGlobalsQuickAlloc(in_sg, filenameLen + 10) : (char*)AiMalloc(filenameLen + 10);
+    // head: result == "dummy"
+   memcpy(out_name, m_filename, m_tagStart);
+
+   int row(in_row), col(in_col);
 
+   if (m_mode == UDIM)
+   {  
+      // tail: result = "dummy    .tx"
+      memcpy(out_name + m_tagStart + 4, m_filename + m_tagEnd, filenameLen + 1 - m_tagEnd);
+
+      unsigned int index = 1001 + col + (row * m_dim);
+      // these are the only chars that need to be overwritten.
+      // the head and tail of the resolved name is alread set at Init time
+      out_name[m_tagStart + 3] = '0' + index % 10; index /= 10;
+      out_name[m_tagStart + 2] = '0' + index % 10; index /= 10;
+      out_name[m_tagStart + 1] = '0' + index % 10; index /= 10;
+      out_name[m_tagStart + 0] = '0' + index % 10;
+   }
+   else // TILE
+   {  
       // tail: result = "dummy      .tx"
       memcpy(out_name + m_tagStart + 6, m_filename + m_tagEnd, filenameLen + 1 - m_tagEnd);
 
@@ -408,6 +434,201 @@ const char* CTokenFilename::Resolve(const AtShaderGlobals *in_sg, float &io_u, f
 }
 
 
+// return the resolved <udim> or <tile> string depending on the input u,v, 
+// and the new u,v to be used to look up the resolved texture.
+//
+// @param in_sg         the shader globals, or NULL if called at update time
+// @param io_u          the input u coordinate
+// @param io_v          the input v coordinate
+//
+// @return the resolved filename (must be freed by the caller) else NULL
+//
+const char* CTokenFilename::Resolve(const AtShaderGlobals *in_sg, float &io_u, float &io_v)
+{
+   if (!m_isValid)
+      return NULL;
+
+   int row, col;
+   GetTile(in_sg, io_u, io_v, row, col);
+   return GetTileName(in_sg, row, col);
+}
+
+
+// List the files of a directory
+//
+// @param in_dir        the directory
+// @param out_files     the returned file names
+//
+// @return false if the directory could not be read
+//
+static bool ListDirectory(const string &in_dir, vector <string> &out_files)
+{
+#ifdef _WINDOWS
+   string pattern = in_dir + "\\*";
+   struct _finddata_t fileInfo;
+   intptr_t handle = _findfirst(pattern.c_str(), &fileInfo);
+   if (handle == -1)
+      return false;
+   do
+   {
+      if (!(fileInfo.attrib & _A_SUBDIR))
+         out_files.push_back(string(fileInfo.name));
+   }
+   while (_findnext(handle, &fileInfo) == 0);
+   _findclose(handle);
+#else
+   DIR *dir = opendir(in_dir.c_str());
+   if (!dir)
+      return false;
+   struct dirent *entry;
+   while ((entry = readdir(dir)) != NULL)
+      out_files.push_back(string(entry->d_name));
+   closedir(dir);
+#endif
+   return true;
+}
+
+
+// Parse the tile token of a filename matching the <udim> or <tile> filename 
+//
+// @param in_token      the token part of the filename, for instance "1012" or "_u2_v3"
+// @param out_row       the returned tile row
+// @param out_col       the returned tile column
+//
+// @return false if the token is not a valid tile
+//
+bool CTokenFilename::ParseTileToken(const string &in_token, int &out_row, int &out_col) const
+{
+   if (m_mode == UDIM)
+   {
+      if (in_token.size() != 4 || in_token.find_first_not_of("0123456789") != string::npos)
+         return false;
+      int index = atoi(in_token.c_str()) - 1001;
+      if (index < 0)
+         return false;
+      out_row = index / m_dim;
+      out_col = index % m_dim;
+      return true;
+   }
+
+   char tail;
+   return sscanf(in_token.c_str(), "_u%d_v%d%c", &out_row, &out_col, &tail) == 2 && out_row >= 1 && out_col >= 1;
+}
+
+
+// Scan the directory of the filename for the existing tiles, and create one texture handle for each of them.
+// To be called at update time. The tiles not found here (for instance because the filename is 
+// relative to the textures search path) are looked up by name by Lookup.
+//
+// @param in_colorSpace the color space of the textures
+//
+// @return the number of texture handles created
+//
+int CTokenFilename::CreateTileHandles(const AtString &in_colorSpace)
+{
+   DestroyTileHandles();
+   if (!m_isValid)
+      return 0;
+
+   string filename(m_filename);
+   size_t slash = filename.find_last_of("/\\");
+   // the token must be in the file name, not in the directory
+   if (slash != string::npos && slash >= (size_t)m_tagStart)
+      return 0;
+
+   string dir = slash == string::npos ? string(".") : filename.substr(0, slash);
+   size_t headStart = slash == string::npos ? 0 : slash + 1;
+   string head = filename.substr(headStart, m_tagStart - headStart);
+   string tail = filename.substr(m_tagEnd);
+
+   vector <string> files;
+   if (!ListDirectory(dir, files))
+      return 0;
+
+   vector <int> rows, cols;
+   int nbRows(0), nbCols(m_mode == UDIM ? m_dim : 0);
+   for (vector <string>::iterator it = files.begin(); it != files.end(); it++)
+   {
+      if (it->size() <= head.size() + tail.size())
+         continue;
+      if (it->compare(0, head.size(), head) != 0 || it->compare(it->size() - tail.size(), tail.size(), tail) != 0)
+         continue;
+
+      int row, col;
+      if (!ParseTileToken(it->substr(head.size(), it->size() - head.size() - tail.size()), row, col))
+         continue;
+
+      rows.push_back(row);
+      cols.push_back(col);
+      nbRows = max(nbRows, row + 1);
+      if (m_mode == TILE)
+         nbCols = max(nbCols, col + 1);
+   }
+
+   // don't build huge sparse tables
+   if (rows.empty() || nbRows * nbCols > 65536)
+      return 0;
+
+   m_tileHandles.assign(nbRows * nbCols, (AtTextureHandle*)NULL);
+   m_nbTileRows = nbRows;
+   m_nbTileCols = nbCols;
+
+   for (size_t i = 0; i < rows.size(); i++)
+   {
+      const char* tileName = GetTileName(NULL, rows[i], cols[i]);
+      m_tileHandles[rows[i] * m_nbTileCols + cols[i]] = AiTextureHandleCreate(tileName, in_colorSpace);
+      AiFree((void*)tileName);
+   }
+
+   return (int)rows.size();
+}
+
+
+// Destroy the tile texture handles
+void CTokenFilename::DestroyTileHandles()
+{
+   for (vector <AtTextureHandle*>::iterator it = m_tileHandles.begin(); it != m_tileHandles.end(); it++)
+   {
+      if (*it)
+         AiTextureHandleDestroy(*it);
+   }
+   m_tileHandles.clear();
+   m_nbTileRows = m_nbTileCols = 0;
+}
+
+
+// Lookup the texture at the input u,v. The tile texture handle is used if it was created at update time, 
+// else the texture is looked up by the resolved filename.
+//
+// @param sg            the shader globals. sg->u and sg->v are set to the u,v to be used to look up the tile
+// @param in_colorSpace the color space of the textures
+// @param in_params     the texture lookup parameters
+//
+// @return the looked up color
+//
+AtRGBA CTokenFilename::Lookup(AtShaderGlobals *sg, const AtString &in_colorSpace, const AtTextureParams &in_params)
+{
+   if (!m_isValid)
+      return AI_RGBA_ZERO;
+
+   int row, col;
+   GetTile(sg, sg->u, sg->v, row, col);
+
+   if (row >= 0 && row < m_nbTileRows && col >= 0 && col < m_nbTileCols)
+   {
+      AtTextureHandle* handle = m_tileHandles[row * m_nbTileCols + col];
+      if (handle)
+         return AiTextureHandleAccess(sg, handle, in_params);
+   }
+
+   // miss, go by name
+   AtString filename(GetTileName(sg, row, col));
+   if (filename.empty())
+      return AI_RGBA_ZERO;
+   return AiTextureAccess(sg, filename, in_colorSpace, in_params);
+}
+
+
 // log the class members, for debugging purposes
 void CTokenFilename::Log()
 {
@@ -427,10 +648,17 @@ void CTokenFilename::Log()
 // In SItoA we name the ginstance with spaces, being the last token of the string the master node.
 const char* GetShaderOwnerName(const AtShaderGlobals *in_sg)
 {
-   if (!in_sg->Op)
+   return GetNodeOwnerName(in_sg->Op);
+}
+
+
+// Return the name of the owner of the shaders assigned to a shape node, as GetShaderOwnerName does
+const char* GetNodeOwnerName(const AtNode *in_node)
+{
+   if (!in_node)
       return NULL;
 
-   const char* name = AiNodeGetName(in_sg->Op);
+   const char* name = AiNodeGetName(in_node);
    const char* p = name + strlen(name) - 1;
    while (p > name)
    {
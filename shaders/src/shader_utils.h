@@ -13,6 +13,7 @@ See the License for the specific language governing permissions and limitations
 #include <sstream>
 #include <cstdio>
 #include <cstring>
+#include <vector>
 
 using namespace std;
 
@@ -141,19 +142,31 @@ private:
    short int   m_dim;      // the number following the udim in cases such as <udim:100>. Default is 10
    uint8_t     m_mode;     // udim or tile ?
    bool        m_isValid;  // true if m_filename is a valid filename, else false
+   // the texture handles of the tiles found on disk at update time, indexed by row * m_nbTileCols + col.
+   // The handles are not owned by the copies of the class, DestroyTileHandles must be called explicitly
+   vector <AtTextureHandle*> m_tileHandles;
+   int         m_nbTileRows, m_nbTileCols;
+
+   // compute the tile row and column of the input u,v, and the new u,v to be used to look up the tile texture.
+   void GetTile(const AtShaderGlobals *in_sg, float &io_u, float &io_v, int &out_row, int &out_col) const;
+   // return the filename of a given tile
+   const char* GetTileName(const AtShaderGlobals *in_sg, int in_row, int in_col) const;
+   // parse the tile token of a filename matching the <udim> or <tile> filename 
+   bool ParseTileToken(const string &in_token, int &out_row, int &out_col) const;
 
 public:
    CTokenFilename() :
-      m_tagStart(0), m_tagEnd(0), m_dim(10), m_mode(NONE), m_isValid(false)
+      m_tagStart(0), m_tagEnd(0), m_dim(10), m_mode(NONE), m_isValid(false), m_nbTileRows(0), m_nbTileCols(0)
    {}
 
    CTokenFilename(const char* in_filename) : 
-      m_filename(in_filename), m_tagStart(0), m_tagEnd(0), m_dim(10), m_mode(NONE), m_isValid(false)
+      m_filename(in_filename), m_tagStart(0), m_tagEnd(0), m_dim(10), m_mode(NONE), m_isValid(false), m_nbTileRows(0), m_nbTileCols(0)
    {}
 
    CTokenFilename(const CTokenFilename &in_arg) : 
       m_filename(in_arg.m_filename), m_tagStart(in_arg.m_tagStart), m_tagEnd(in_arg.m_tagEnd),
-      m_dim(in_arg.m_dim), m_mode(in_arg.m_mode), m_isValid(in_arg.m_isValid)
+      m_dim(in_arg.m_dim), m_mode(in_arg.m_mode), m_isValid(in_arg.m_isValid),
+      m_tileHandles(in_arg.m_tileHandles), m_nbTileRows(in_arg.m_nbTileRows), m_nbTileCols(in_arg.m_nbTileCols)
    {}
 
    ~CTokenFilename() {}
@@ -165,6 +178,12 @@ public:
    // return the resolved <udim> or <tile> string depending on the input u,v, 
    // and the new u,v to be used to look up the resolved texture.
    const char* Resolve(const AtShaderGlobals *in_sg, float &io_u, float &io_v);
+   // scan the directory of the filename for the existing tiles, and create one texture handle for each of them.
+   int CreateTileHandles(const AtString &in_colorSpace);
+   // destroy the tile texture handles
+   void DestroyTileHandles();
+   // lookup the texture at the input u,v, by the tile texture handle if available, else by the resolved filename
+   AtRGBA Lookup(AtShaderGlobals *sg, const AtString &in_colorSpace, const AtTextureParams &in_params);
    // log the class members, for debugging purposes
    void Log();
 };
@@ -175,5 +194,6 @@ inline float MAP01F(float a)
 }
 
 const char* GetShaderOwnerName(const AtShaderGlobals *in_sg);
+const char* GetNodeOwnerName(const AtNode *in_node);
 
 
@@ -70,6 +70,7 @@ typedef struct
    AtString          timeSource;
    AtTextureHandle*  textureHandle;
    ImageSequence     imageSequence;
+   CSequenceHandles  sequenceHandles;  // the texture handles of the frames of imageSequence
    CTokenFilename    tokenFilename;    // to resolve the <udim> and <tile> tokens (#1325)
    float             gamma;
    float             fstop;
@@ -115,6 +116,8 @@ node_update
       AiTextureHandleDestroy(data->textureHandle);
       data->textureHandle = NULL;
    }
+   data->tokenFilename.DestroyTileHandles();
+   data->sequenceHandles.Destroy();
 
    data->tokenFilename.Init(data->filename);
    data->needEvaluation = data->tokenFilename.IsValid() || (!data->timeSource.empty());
@@ -141,10 +144,14 @@ node_update
       float dummyF = 0.5f;
 
       if (data->tokenFilename.IsValid())
+      {
+         data->tokenFilename.CreateTileHandles(data->color_space);
          filename = data->tokenFilename.Resolve(NULL, dummyF, dummyF);
+      }
       else
       {
          GetSequenceData(data->filename, data->imageSequence);
+         data->sequenceHandles.Create(data->filename, data->imageSequence, data->color_space);
          filename = ResolveSequenceAtFrame(NULL, data->filename, 0, data->imageSequence, true);
       }
 
@@ -201,6 +208,8 @@ node_finish
    ShaderData *data = (ShaderData*)AiNodeGetLocalData(node);
    if(data->textureHandle)
       AiTextureHandleDestroy(data->textureHandle);
+   data->tokenFilename.DestroyTileHandles();
+   data->sequenceHandles.Destroy();
    delete data;
 }
 
@@ -247,36 +256,22 @@ shader_evaluate
 
    if (data->needEvaluation) // Deprecated lookup, needed with variable texture name
    {
-      if (data->tokenFilename.IsValid())
-      {
-         // get the <udim>-ed filename, out of the current u,v
-         AtString filename(data->tokenFilename.Resolve(sg, sg->u, sg->v));
-         if (!filename.empty())
-            color = AiTextureAccess(sg, filename, data->color_space, data->tmap_params);
-      }
+      if (data->tokenFilename.IsValid()) // get the <udim>-ed texture, out of the current u,v
+         color = data->tokenFilename.Lookup(sg, data->color_space, data->tmap_params);
       else
       {
          int frame;
          float framef;
 
          if (AiUDataGetInt(data->timeSource, frame))
-         {
-            AtString filename(ResolveSequenceAtFrame(sg, data->filename, frame, data->imageSequence));
-            if (!filename.empty())
-               color = AiTextureAccess(sg, filename, data->color_space, data->tmap_params);
-         }
+            color = LookupSequenceAtFrame(sg, data->filename, frame, data->imageSequence, data->sequenceHandles, data->color_space, data->tmap_params);
          else if (AiUDataGetFlt(data->timeSource, framef))
          {
             frame = (int)floor(framef);
             framef-= floor(framef);
-            AtString filename0(ResolveSequenceAtFrame(sg, data->filename, frame, data->imageSequence));
-            AtString filename1(ResolveSequenceAtFrame(sg, data->filename, frame + 1, data->imageSequence));
-            if (!filename0.empty() && !filename1.empty())
-            {
-               AtRGBA c0 = AiTextureAccess(sg, filename0, data->color_space, data->tmap_params);
-               AtRGBA c1 = AiTextureAccess(sg, filename1, data->color_space, data->tmap_params);
-               color = AiLerp(framef, c0, c1);
-            }
+            AtRGBA c0 = LookupSequenceAtFrame(sg, data->filename, frame, data->imageSequence, data->sequenceHandles, data->color_space, data->tmap_params);
+            AtRGBA c1 = LookupSequenceAtFrame(sg, data->filename, frame + 1, data->imageSequence, data->sequenceHandles, data->color_space, data->tmap_params);
+            color = AiLerp(framef, c0, c1);
          }
       }
    }
@@ -0,0 +1,225 @@
+/************************************************************************************************************************************
+Copyright 2017 Autodesk, Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance with the License.
+You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and limitations under the License.
+************************************************************************************************************************************/
+
+// Power instances of a quad shaded by its varying user data, rendered by Arnold only.
+// The instances get their user data by CloneNodeUserData (loader/UserData.cpp), once copying it,
+// and once sharing it with the shape. The two renders must be identical.
+// - Master A holds the same data as the shape, so its two instances share it.
+// - Master B holds different data, so its instance must still copy it.
+
+#include "loader/UserData.h"
+
+#include <ai.h>
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace std;
+
+#define TEST_XRES 96
+#define TEST_YRES 32
+
+AI_DRIVER_NODE_EXPORT_METHODS(test_driver_mtd);
+
+// the pixels of the last render
+static vector <AtRGBA> s_pixels;
+
+node_parameters {}
+
+node_initialize
+{
+   AiDriverInitialize(node, false);
+}
+
+node_update {}
+
+driver_supports_pixel_type { return pixel_type == AI_TYPE_RGBA; }
+
+driver_extension { return NULL; }
+
+driver_open
+{
+   s_pixels.assign(TEST_XRES * TEST_YRES, AI_RGBA_ZERO);
+}
+
+driver_needs_bucket { return true; }
+
+driver_prepare_bucket {}
+
+driver_process_bucket
+{
+   const void* bucket_data;
+   int         pixel_type;
+   const char* aov_name;
+
+   if (!AiOutputIteratorGetNext(iterator, &aov_name, &pixel_type, &bucket_data))
+      return;
+
+   const AtRGBA* bucket = (const AtRGBA*)bucket_data;
+   for (int y = 0; y < bucket_size_y; y++)
+   for (int x = 0; x < bucket_size_x; x++)
+      s_pixels[(bucket_yo + y) * TEST_XRES + bucket_xo + x] = bucket[y * bucket_size_x + x];
+}
+
+driver_write_bucket {}
+
+driver_close {}
+
+node_finish {}
+
+
+// Create a master ginstance of the shape, holding its own copy of the "color" user data
+//
+// @param in_name    the node name
+// @param in_shape   the instanced shape
+// @param in_colors  the 4 vertex colors
+//
+// @return the master ginstance
+//
+AtNode* CreateMaster(const char* in_name, AtNode* in_shape, const AtRGB* in_colors)
+{
+   AtNode* master = AiNode("ginstance", in_name);
+   AiNodeSetPtr(master, "node", in_shape);
+   AiNodeSetByte(master, "visibility", 0);
+   AiNodeDeclare(master, "color", "varying RGB");
+   AiNodeSetArray(master, "color", AiArrayConvert(4, 1, AI_TYPE_RGB, in_colors));
+   return master;
+}
+
+
+// Create a power instance of a master, as LoadSingleInstance does
+//
+// @param in_name            the node name
+// @param in_master          the master ginstance
+// @param in_x               the instance position
+// @param io_sharedUserData  the shared user data, or NULL to copy it
+//
+void CreateInstance(const char* in_name, AtNode* in_master, float in_x, CSharedUserData *io_sharedUserData)
+{
+   AtNode* instance = AiNode("ginstance", in_name);
+   AiNodeSetPtr(instance, "node", AiNodeGetPtr(in_master, "node"));
+   CloneNodeUserData(instance, in_master, io_sharedUserData);
+   AiNodeSetMatrix(instance, "matrix", AiM4Translation(AtVector(in_x, 0.0f, 0.0f)));
+   AiNodeSetBool(instance, "inherit_xform", false);
+}
+
+
+// Render the instances
+//
+// @param in_share      share the user data with the shape
+// @param out_pixels    the rendered pixels
+// @param out_bytes     the shared bytes
+//
+// @return true if the render succeeded
+//
+bool Render(bool in_share, vector <AtRGBA> &out_pixels, size_t &out_bytes)
+{
+   AiBegin();
+   AiMsgSetConsoleFlags(AI_LOG_WARNINGS | AI_LOG_ERRORS);
+   AiNodeEntryInstall(AI_NODE_DRIVER, AI_TYPE_NONE, "test_driver", NULL, (AtNodeMethods*)test_driver_mtd, AI_VERSION);
+
+   AtNode* options = AiUniverseGetOptions();
+   AiNodeSetInt(options, "xres", TEST_XRES);
+   AiNodeSetInt(options, "yres", TEST_YRES);
+   AiNodeSetInt(options, "AA_samples", 1);
+   AiNodeSetBool(options, "skip_license_check", true);
+
+   AtNode* camera = AiNode("persp_camera", "camera");
+   AiNodeSetMatrix(camera, "matrix", AiM4Translation(AtVector(0.0f, 0.0f, 4.0f)));
+   AiNodeSetPtr(options, "camera", camera);
+
+   AiNode("closest_filter", "filter");
+   AiNode("test_driver", "driver");
+   AtArray* outputs = AiArrayAllocate(1, 1, AI_TYPE_STRING);
+   AiArraySetStr(outputs, 0, "RGBA RGBA filter driver");
+   AiNodeSetArray(options, "outputs", outputs);
+
+   // the flat shader shows the interpolated user data
+   AtNode* userData = AiNode("user_data_rgb", "user_data");
+   AiNodeSetStr(userData, "attribute", "color");
+   AtNode* shader = AiNode("flat", "shader");
+   AiNodeLink(userData, "color", shader);
+
+   // the quad, hidden, as the Softimage masters are
+   const AtVector vlist[4] = { AtVector(-0.5f, -0.5f, 0.0f), AtVector(0.5f, -0.5f, 0.0f), AtVector(0.5f, 0.5f, 0.0f), AtVector(-0.5f, 0.5f, 0.0f) };
+   const uint32_t vidxs[4] = { 0, 1, 2, 3 };
+   const uint32_t nsides[1] = { 4 };
+   const AtRGB shapeColors[4] = { AtRGB(1.0f, 0.0f, 0.0f), AtRGB(0.0f, 1.0f, 0.0f), AtRGB(0.0f, 0.0f, 1.0f), AtRGB(1.0f, 1.0f, 1.0f) };
+   const AtRGB otherColors[4] = { AtRGB(1.0f, 1.0f, 0.0f), AtRGB(1.0f, 1.0f, 0.0f), AtRGB(1.0f, 1.0f, 0.0f), AtRGB(1.0f, 1.0f, 0.0f) };
+
+   AtNode* shape = AiNode("polymesh", "quad");
+   AiNodeSetArray(shape, "vlist", AiArrayConvert(4, 1, AI_TYPE_VECTOR, vlist));
+   AiNodeSetArray(shape, "vidxs", AiArrayConvert(4, 1, AI_TYPE_UINT, vidxs));
+   AiNodeSetArray(shape, "nsides", AiArrayConvert(1, 1, AI_TYPE_UINT, nsides));
+   AiNodeSetArray(shape, "shader", AiArray(1, 1, AI_TYPE_NODE, shader));
+   AiNodeSetByte(shape, "visibility", 0);
+   AiNodeDeclare(shape, "color", "varying RGB");
+   AiNodeSetArray(shape, "color", AiArrayConvert(4, 1, AI_TYPE_RGB, shapeColors));
+
+   AtNode* masterA = CreateMaster("master_a", shape, shapeColors);
+   AtNode* masterB = CreateMaster("master_b", shape, otherColors);
+
+   CSharedUserData sharedUserData;
+   CSharedUserData* shared = in_share ? &sharedUserData : NULL;
+   CreateInstance("instance_a1", masterA, -1.1f, shared);
+   CreateInstance("instance_a2", masterA,  0.0f, shared);
+   CreateInstance("instance_b",  masterB,  1.1f, shared);
+
+   int result = AiRender(AI_RENDER_MODE_CAMERA);
+   out_pixels = s_pixels;
+   out_bytes = sharedUserData.m_bytes;
+
+   AiEnd();
+   return result == AI_SUCCESS;
+}
+
+
+int main(int argc, char** argv)
+{
+   vector <AtRGBA> copiedPixels, sharedPixels;
+   size_t copiedBytes, sharedBytes;
+
+   if (!Render(false, copiedPixels, copiedBytes) || !Render(true, sharedPixels, sharedBytes))
+   {
+      printf("FAILED: render error\n");
+      return 1;
+   }
+
+   // the two instances of master A share its data, the one of master B copies it
+   size_t expectedBytes = 2 * 4 * sizeof(AtRGB);
+   if (sharedBytes != expectedBytes)
+   {
+      printf("FAILED: %u bytes shared, %u expected\n", (unsigned int)sharedBytes, (unsigned int)expectedBytes);
+      return 1;
+   }
+
+   // the center of instance_b must show the yellow of master B, not the shape's colors
+   const AtRGBA center = copiedPixels[(TEST_YRES / 2) * TEST_XRES + TEST_XRES * 3 / 4];
+   if (fabs(center.r - 1.0f) > 0.01f || fabs(center.g - 1.0f) > 0.01f || fabs(center.b) > 0.01f)
+   {
+      printf("FAILED: the user data of master B is not rendered\n");
+      return 1;
+   }
+
+   for (size_t i = 0; i < copiedPixels.size(); i++)
+   {
+      const AtRGBA &c = copiedPixels[i], &s = sharedPixels[i];
+      if (c.r != s.r || c.g != s.g || c.b != s.b || c.a != s.a)
+      {
+         printf("FAILED: pixel (%d, %d) differs\n", (int)(i % TEST_XRES), (int)(i / TEST_XRES));
+         return 1;
+      }
+   }
+
+   printf("OK\n");
+   return 0;
+}
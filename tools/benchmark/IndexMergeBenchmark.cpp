@@ -0,0 +1,282 @@
+/************************************************************************************************************************************
+Copyright 2017 Autodesk, Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except in compliance with the License.
+You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and limitations under the License.
+************************************************************************************************************************************/
+
+// Benchmark of IndexMerge (loader/IndexMerge.cpp) over synthetic meshes.
+// Each case is merged by IndexMerge and by the full sort implementation it replaced, which is kept
+// below as the reference. The merged values and indices must be bit identical.
+//
+// Usage: IndexMergeBenchmark [max_corners]
+// Returns 1 if any case differs from the reference.
+
+#include "common/WorkerPool.h"
+#include "loader/IndexMerge.h"
+
+#include <ai.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+using namespace std;
+
+/////////////////////////////////////
+// The reference, the full sort IndexMerge
+/////////////////////////////////////
+
+inline int RefCompareFloatN(const void *ptr1, const void *ptr2, int float_size)
+{
+   int v = 0;
+   int *p1 = (int*)ptr1;
+   int *p2 = (int*)ptr2;
+
+   while (float_size-- > 0 && v == 0)
+      v = *(p1++) - *(p2++);
+
+   return v;
+}
+
+struct RefLessThan
+{
+   RefLessThan(int float_size) : float_size(float_size) {}
+
+   bool operator()(const IndexValue& i, const IndexValue& j)
+   {
+      if (i.vidx != j.vidx)
+         return i.vidx < j.vidx;
+      switch (float_size)
+      {
+         case 1:
+            return *(float*)i.value < *(float*)j.value;
+         case 2:
+            return *(uint64_t*)i.value < *(uint64_t*)j.value;
+         case 3:
+         {
+            uint64_t *di = (uint64_t*)i.value;
+            uint64_t *dj = (uint64_t*)j.value;
+            return *di == *dj ? *((float*)i.value + 2) < *((float*)j.value + 2) : *di < *dj;
+         }
+         case 4:
+         {
+            uint64_t *di = (uint64_t*)i.value;
+            uint64_t *dj = (uint64_t*)j.value;
+            return *di == *dj ? *(di + 1) < *(dj + 1) : *di < *dj;
+         }
+         default:
+            return RefCompareFloatN(i.value, j.value, float_size) < 0;
+      }
+   }
+
+   int float_size;
+};
+
+
+// The equality of the reference, float for 1 and 3 floats, bitwise else
+inline bool RefEqual(const void *ptr1, const void *ptr2, int float_size)
+{
+   switch (float_size)
+   {
+      case 1:
+         return *(float*)ptr1 == *(float*)ptr2;
+      case 2:
+         return *(uint64_t*)ptr1 == *(uint64_t*)ptr2;
+      case 3:
+         return *(uint64_t*)ptr1 == *(uint64_t*)ptr2 && *((float*)ptr1 + 2) == *((float*)ptr2 + 2);
+      case 4:
+         return *(uint64_t*)ptr1 == *(uint64_t*)ptr2 && *((uint64_t*)ptr1 + 1) == *((uint64_t*)ptr2 + 1);
+      default:
+         return RefCompareFloatN(ptr1, ptr2, float_size) == 0;
+   }
+}
+
+
+void RefIndexMerge(AtArray* vidxs, AtArray*& idxs, AtArray*& values, bool canonical)
+{
+   if (AiArrayGetNumElements(vidxs) != AiArrayGetNumElements(idxs))
+      return;
+   if (AiArrayGetNumElements(idxs) < 2 || AiArrayGetNumElements(values) < 2)
+      return;
+
+   const int type_size = AiParamGetTypeSize(AiArrayGetType(values));
+   if (type_size % 4)
+      return;
+   const int float_size = type_size / 4;
+
+   const uint32_t index_count = AiArrayGetNumElements(idxs);
+   IndexValue* index_values = (IndexValue*)AiMalloc(sizeof(IndexValue) * index_count);
+
+   if (canonical)
+      for (uint32_t i = 0; i < index_count; ++i)
+         index_values[i].set(i, INDEX_ARRAY(vidxs)[i], VALUE_AT(values, 0, i));
+   else
+      for (uint32_t i = 0; i < index_count; ++i)
+         index_values[i].set(i, INDEX_ARRAY(vidxs)[i], VALUE_AT(values, 0, INDEX_ARRAY(idxs)[i]));
+
+   std::sort(index_values, index_values + index_count, RefLessThan(float_size));
+
+   IndexValue* it_prev = index_values;
+   IndexValue* it = it_prev + 1;
+   uint32_t value_count = 1;
+   for (uint32_t i = 1; i < index_count; ++it, ++i)
+   {
+      if (it->vidx == it_prev->vidx && RefEqual(it->value, it_prev->value, float_size))
+         it->value_index = it_prev->value_index;
+      else
+      {
+         it->value_index = i;
+         it_prev = it;
+         ++value_count;
+      }
+   }
+
+   if (value_count == AiArrayGetNumElements(values))
+   {
+      AiFree(index_values);
+      return;
+   }
+
+   const uint32_t values_stride = arrayStride(values);
+   AtArray* merged_values = AiArrayAllocate(value_count, AiArrayGetNumKeys(values), AiArrayGetType(values));
+
+   for (uint32_t i = 0, value_index = 0; i < index_count; ++i)
+   {
+      if (i == index_values[i].value_index)
+      {
+         for (uint8_t k = 0; k < AiArrayGetNumKeys(values); ++k)
+            memcpy(VALUE_AT(merged_values, k, value_index), (uint8_t*)index_values[i].value + k * values_stride, type_size);
+         value_index++;
+      }
+      INDEX_ARRAY(idxs)[index_values[i].position] = value_index - 1;
+   }
+
+   AiFree(index_values);
+   AiArrayDestroy(values);
+   values = merged_values;
+}
+
+
+/////////////////////////////////////
+// The synthetic meshes
+/////////////////////////////////////
+
+// A mesh of in_nbCorners corners, about 4 per vertex. Each vertex has 1 or 2 distinct values
+// (a uv seam, a hard edge), so that about half of the corners merge
+class CSyntheticMesh
+{
+public:
+   AtArray *m_vidxs, *m_idxs, *m_values;
+
+   CSyntheticMesh(uint32_t in_nbCorners, uint8_t in_type, uint8_t in_nbKeys, unsigned int in_seed)
+   {
+      uint32_t nbVertices = in_nbCorners / 4 + 1;
+      int floatSize = AiParamGetTypeSize(in_type) / 4;
+      mt19937 rng(in_seed);
+
+      m_vidxs = AiArrayAllocate(in_nbCorners, 1, AI_TYPE_UINT);
+      m_idxs = AiArrayAllocate(in_nbCorners, 1, AI_TYPE_UINT);
+      m_values = AiArrayAllocate(in_nbCorners, in_nbKeys, in_type);
+
+      uint32_t* vidxs = (uint32_t*)AiArrayMap(m_vidxs);
+      uint32_t* idxs = (uint32_t*)AiArrayMap(m_idxs);
+      float* values = (float*)AiArrayMap(m_values);
+      for (uint32_t i = 0; i < in_nbCorners; i++)
+      {
+         vidxs[i] = rng() % nbVertices;
+         idxs[i] = i; // canonical
+         // the value only depends on the vertex and on the side of the seam
+         uint32_t side = rng() % 2;
+         for (uint8_t k = 0; k < in_nbKeys; k++)
+         {
+            // the later keys move, but keep the first key groups
+            float* value = values + ((size_t)k * in_nbCorners + i) * floatSize;
+            for (int f = 0; f < floatSize; f++)
+               value[f] = (float)((vidxs[i] * 7 + side * 3 + f) % 1024) * 0.001f + (float)k * (float)(rng() % 2);
+         }
+      }
+      AiArrayUnmap(m_vidxs);
+      AiArrayUnmap(m_idxs);
+      AiArrayUnmap(m_values);
+   }
+
+   ~CSyntheticMesh()
+   {
+      AiArrayDestroy(m_vidxs);
+      AiArrayDestroy(m_idxs);
+      AiArrayDestroy(m_values);
+   }
+};
+
+
+// Return true if the two arrays have the same type, size and bits
+bool SameArrays(const AtArray* in_a, const AtArray* in_b)
+{
+   if (AiArrayGetType(in_a) != AiArrayGetType(in_b) || AiArrayGetNumElements(in_a) != AiArrayGetNumElements(in_b) ||
+       AiArrayGetNumKeys(in_a) != AiArrayGetNumKeys(in_b))
+      return false;
+   size_t size = (size_t)arrayStride(in_a) * AiArrayGetNumKeys(in_a);
+   bool result = memcmp(AiArrayMapConst(in_a), AiArrayMapConst(in_b), size) == 0;
+   AiArrayUnmapConst(in_a);
+   AiArrayUnmapConst(in_b);
+   return result;
+}
+
+
+double ElapsedMs(chrono::high_resolution_clock::time_point in_start)
+{
+   return chrono::duration<double, milli>(chrono::high_resolution_clock::now() - in_start).count();
+}
+
+
+int main(int argc, char** argv)
+{
+   uint32_t maxCorners = argc > 1 ? (uint32_t)atoi(argv[1]) : 10000000;
+
+   AiBegin();
+   AiMsgSetConsoleFlags(AI_LOG_NONE);
+
+   const uint8_t types[] = { AI_TYPE_FLOAT, AI_TYPE_VECTOR2, AI_TYPE_VECTOR, AI_TYPE_RGBA };
+   const char* typeNames[] = { "FLOAT", "VECTOR2", "VECTOR", "RGBA" };
+   int nbFailed = 0;
+
+   printf("%10s %8s %5s %12s %12s %8s %s\n", "corners", "type", "keys", "ref (ms)", "merge (ms)", "speedup", "result");
+   for (uint32_t nbCorners = 1000; nbCorners <= maxCorners; nbCorners*= 10)
+   {
+      for (int t = 0; t < 4; t++)
+      {
+         for (uint8_t nbKeys = 1; nbKeys <= 2; nbKeys++)
+         {
+            CSyntheticMesh refMesh(nbCorners, types[t], nbKeys, nbCorners + t);
+            CSyntheticMesh mesh(nbCorners, types[t], nbKeys, nbCorners + t);
+
+            chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+            RefIndexMerge(refMesh.m_vidxs, refMesh.m_idxs, refMesh.m_values, true);
+            double refMs = ElapsedMs(start);
+
+            start = chrono::high_resolution_clock::now();
+            IndexMerge(mesh.m_vidxs, mesh.m_idxs, mesh.m_values, true);
+            double mergeMs = ElapsedMs(start);
+
+            bool same = SameArrays(refMesh.m_idxs, mesh.m_idxs) && SameArrays(refMesh.m_values, mesh.m_values);
+            if (!same)
+               nbFailed++;
+
+            printf("%10u %8s %5d %12.2f %12.2f %7.2fx %s\n", nbCorners, typeNames[t], (int)nbKeys, refMs, mergeMs,
+                   mergeMs > 0.0 ? refMs / mergeMs : 0.0, same ? "identical" : "DIFFERENT");
+         }
+      }
+   }
+
+   CWorkerPool::Shutdown();
+   AiEnd();
+   return nbFailed > 0 ? 1 : 0;
+}